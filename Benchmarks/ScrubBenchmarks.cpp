@@ -0,0 +1,329 @@
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Arrow.hpp>
+#include <Scrub/Base64.hpp>
+#include <Scrub/ColumnTable.hpp>
+#include <Scrub/MappedView.hpp>
+#include <Scrub/MessageCodec.hpp>
+#include <Scrub/XMLView.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace scrub;
+using namespace stick;
+
+//average milliseconds per call of _fn
+template<class F>
+static double measure(F _fn, Size _iterations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (Size i = 0; i < _iterations; ++i)
+        _fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / _iterations;
+}
+
+static void report(const char * _name, double _ms, Size _byteCount)
+{
+    std::printf("%-32s %10.3f ms %10.1f MB/s\n", _name, _ms, (_byteCount / (1024.0 * 1024.0)) / (_ms / 1000.0));
+}
+
+static String generateXML(Size _elementCount)
+{
+    String ret;
+    ret.append("<?xml version='1.0'?>\n<assets>\n");
+    for (Size i = 0; i < _elementCount; ++i)
+    {
+        String idx = toString(static_cast<UInt64>(i));
+        ret.append(AppendVariadicFlag(), "    <asset id='", idx, "' type='texture' path='textures/&quot;", idx, "&quot;.png'>\r\n",
+                   "        <!-- generated -->\r\n",
+                   "        <name>Asset &amp; ", idx, "</name>\r\n",
+                   "        <size>", idx, "</size>\r\n",
+                   "    </asset>\r\n");
+    }
+    ret.append("</assets>\n");
+    return ret;
+}
+
+static void benchmarkXMLParseOptions()
+{
+    String xml = generateXML(50000);
+    std::printf("parseXML, %.1f MB document\n", xml.length() / (1024.0 * 1024.0));
+
+    XMLParseOptions keepAll;
+    keepAll.bKeepComments = true;
+    keepAll.bKeepProcessingInstructions = true;
+
+    report("XMLParseOptions()", measure([&]() { parseXML(xml).ensure(); }, 10), xml.length());
+    report("XMLParseOptions::fast()", measure([&]() { parseXML(xml, XMLParseOptions::fast()).ensure(); }, 10), xml.length());
+    report("XMLParseOptions::minimal()", measure([&]() { parseXML(xml, XMLParseOptions::minimal()).ensure(); }, 10), xml.length());
+    report("comments and PIs", measure([&]() { parseXML(xml, keepAll).ensure(); }, 10), xml.length());
+
+    //views skip the conversion to Shrubs and show the cost of the options themselves
+    std::printf("parseXMLView\n");
+    report("XMLParseOptions()", measure([&]() { parseXMLView(xml).ensure(); }, 10), xml.length());
+    report("XMLParseOptions::fast()", measure([&]() { parseXMLView(xml, XMLParseOptions::fast()).ensure(); }, 10), xml.length());
+    report("XMLParseOptions::minimal()", measure([&]() { parseXMLView(xml, XMLParseOptions::minimal()).ensure(); }, 10), xml.length());
+    XMLView view = parseXMLView(xml).ensure();
+    report("count() of the root", measure([&]() { view.count(); }, 10), xml.length());
+}
+
+static String generateJSON(Size _elementCount)
+{
+    String ret;
+    ret.append("{\"assets\" : [\n");
+    for (Size i = 0; i < _elementCount; ++i)
+    {
+        String idx = toString(static_cast<UInt64>(i));
+        ret.append(AppendVariadicFlag(), "    {\"id\" : ", idx, ", \"type\" : \"texture\", \"path\" : \"textures/asset_", idx, ".png\", ",
+                   "\"description\" : \"A fairly long description of asset ", idx, " that does not need any escaping at all\", ",
+                   "\"note\" : \"line one\\nline \\\"two\\\"\"}", i + 1 < _elementCount ? ",\n" : "\n");
+    }
+    ret.append("]}\n");
+    return ret;
+}
+
+//clears the known clean marks so that every string has to be scanned
+static void markUnknown(Shrub & _shrub)
+{
+    _shrub.setKnownClean(false, false);
+    for (Shrub & child : _shrub)
+        markUnknown(child);
+}
+
+static void benchmarkJSONExport()
+{
+    Shrub tree = parseJSON(generateJSON(50000)).ensure();
+    Size byteCount = exportJSON(tree).ensure().length();
+    std::printf("exportJSON, %.1f MB document\n", byteCount / (1024.0 * 1024.0));
+
+    Shrub unknown = tree;
+    markUnknown(unknown);
+    report("known clean strings", measure([&]() { exportJSON(tree).ensure(); }, 10), byteCount);
+    report("scanned strings", measure([&]() { exportJSON(unknown).ensure(); }, 10), byteCount);
+    report("exportJSONCanonical", measure([&]() { exportJSONCanonical(tree).ensure(); }, 10), byteCount);
+    report("exportJSONParallel", measure([&]() { exportJSONParallel(tree).ensure(); }, 10), byteCount);
+
+    //one small edit between exports, the cache only writes the changed path again
+    Shrub cached = tree;
+    cached.setExportCaching(true);
+    Shrub & asset = cached.child("assets").ensure().begin()[25000];
+    Size edit = 0;
+    report("cached, one edit per export", measure([&]() { asset.set("id", edit++); exportJSON(cached).ensure(); }, 10), byteCount);
+}
+
+static void benchmarkBinary()
+{
+    String json = generateJSON(50000);
+    Shrub tree = parseJSON(json).ensure();
+    String bytes = exportBinary(tree).ensure();
+    std::printf("binary, %.1f MB JSON, %.1f MB binary\n", json.length() / (1024.0 * 1024.0), bytes.length() / (1024.0 * 1024.0));
+
+    report("parseJSON", measure([&]() { parseJSON(json).ensure(); }, 10), json.length());
+    report("parseBinary", measure([&]() { parseBinary(bytes).ensure(); }, 10), bytes.length());
+    report("exportBinary", measure([&]() { exportBinary(tree).ensure(); }, 10), bytes.length());
+
+    //the mapped form is used in place, opening it doesn't depend on its size
+    String mapped = exportMappedBinary(tree).ensure();
+    std::printf("mapped binary, %.1f MB\n", mapped.length() / (1024.0 * 1024.0));
+    report("exportMappedBinary", measure([&]() { exportMappedBinary(tree).ensure(); }, 10), mapped.length());
+    const char * binaryPath = "/tmp/ScrubBenchmark.shrb";
+    const char * mappedPath = "/tmp/ScrubBenchmark.shrm";
+    if (saveBinary(tree, binaryPath) || saveMappedBinary(tree, mappedPath))
+        return;
+    report("loadBinary and lookup", measure([&]() { loadBinary(binaryPath).ensure().child("assets").ensure(); }, 10), bytes.length());
+    report("loadMappedView and lookup", measure([&]() { loadMappedView(mappedPath).ensure().child("assets").ensure(); }, 10), mapped.length());
+    std::remove(binaryPath);
+    std::remove(mappedPath);
+}
+
+static void benchmarkMsgPack()
+{
+    String json = generateJSON(50000);
+    Shrub tree = parseJSON(json).ensure();
+    String bytes = exportMsgPack(tree).ensure();
+    std::printf("MessagePack, %.1f MB JSON, %.1f MB MessagePack\n", json.length() / (1024.0 * 1024.0), bytes.length() / (1024.0 * 1024.0));
+
+    report("parseJSON", measure([&]() { parseJSON(json).ensure(); }, 10), json.length());
+    report("parseMsgPack", measure([&]() { parseMsgPack(bytes).ensure(); }, 10), bytes.length());
+    report("exportJSON", measure([&]() { exportJSON(tree).ensure(); }, 10), json.length());
+    report("exportMsgPack", measure([&]() { exportMsgPack(tree).ensure(); }, 10), bytes.length());
+}
+
+static void benchmarkMessageCodec()
+{
+    //many small messages with the same keys, as a message bus sends them
+    const Size count = 10000;
+    DynamicArray<Shrub> messages;
+    messages.reserve(count);
+    for (Size i = 0; i < count; ++i)
+    {
+        String idx = toString(static_cast<UInt64>(i));
+        messages.append(parseJSON(String::concat("{\"id\" : ", idx, ", \"topic\" : \"prices\", \"symbol\" : \"SYM", idx,
+                                                 "\", \"quote\" : {\"bid\" : 1.5, \"ask\" : 1.75, \"size\" : ", idx, "}}")).ensure());
+    }
+
+    DynamicArray<String> json, encoded;
+    Size jsonBytes = 0, encodedBytes = 0;
+    MessageEncoder encoder;
+    for (const Shrub & msg : messages)
+    {
+        json.append(exportJSON(msg).ensure());
+        jsonBytes += json.last().length();
+        encoded.append(encoder.encode(msg).ensure());
+        encodedBytes += encoded.last().length();
+    }
+    std::printf("Message codec, %.1f bytes per JSON message, %.1f bytes per encoded message\n",
+                jsonBytes / static_cast<double>(count), encodedBytes / static_cast<double>(count));
+
+    report("parseJSON per message", measure([&]() { for (const String & str : json) parseJSON(str).ensure(); }, 10), jsonBytes);
+    report("MessageDecoder::decode", measure([&]()
+    {
+        MessageDecoder decoder;
+        for (const String & str : encoded)
+            decoder.decode(str).ensure();
+    }, 10), encodedBytes);
+    report("exportJSON per message", measure([&]() { for (const Shrub & msg : messages) exportJSON(msg).ensure(); }, 10), jsonBytes);
+    String buffer;
+    report("MessageEncoder::encode", measure([&]()
+    {
+        MessageEncoder streamEncoder;
+        for (const Shrub & msg : messages)
+        {
+            buffer.clear();
+            streamEncoder.encode(msg, buffer);
+        }
+    }, 10), encodedBytes);
+}
+
+static void benchmarkTypedArrays()
+{
+    //vertex data, a few meshes with large arrays of positions
+    String json = "{\"meshes\" : [";
+    for (Size mesh = 0; mesh < 10; ++mesh)
+    {
+        json.append(mesh ? ", {\"positions\" : [" : "{\"positions\" : [");
+        for (Size i = 0; i < 100000; ++i)
+        {
+            char buffer[32];
+            int length = std::snprintf(buffer, sizeof(buffer), i ? ", %.4f" : "%.4f", (i % 1000) * 0.0731 - 20.0);
+            json.append(buffer, length);
+        }
+        json.append("]}");
+    }
+    json.append("]}");
+
+    JSONParseOptions options;
+    options.bPackNumberArrays = true;
+    Shrub tree = parseJSON(json).ensure();
+    Shrub packed = parseJSON(json, options).ensure();
+    std::printf("Typed arrays, %.1f MB JSON, 1M numbers\n", json.length() / (1024.0 * 1024.0));
+
+    report("parseJSON", measure([&]() { parseJSON(json).ensure(); }, 5), json.length());
+    report("parseJSON packed", measure([&]() { parseJSON(json, options).ensure(); }, 5), json.length());
+    report("exportJSON", measure([&]() { exportJSON(tree).ensure(); }, 5), json.length());
+    report("exportJSON packed", measure([&]() { exportJSON(packed).ensure(); }, 5), json.length());
+
+    double sum = 0;
+    report("sum children", measure([&]()
+    {
+        for (const Shrub & mesh : *tree.child("meshes"))
+        {
+            for (const Shrub & value : *mesh.child("positions"))
+                sum += std::strtod(value.valueString().cString(), nullptr);
+        }
+    }, 5), json.length());
+    report("sum typedArray", measure([&]()
+    {
+        for (const Shrub & mesh : *packed.child("meshes"))
+        {
+            for (Float64 value : mesh.child("positions")->typedArray<Float64>())
+                sum += value;
+        }
+    }, 5), json.length());
+    std::printf("(%f)\n", sum);
+}
+
+static void benchmarkBlobs()
+{
+    //a config with an embedded 8 MB payload
+    String bytes;
+    bytes.resize(8 * 1024 * 1024);
+    UInt32 state = 1;
+    for (Size i = 0; i < bytes.length(); ++i)
+    {
+        state = state * 1664525 + 1013904223;
+        bytes[i] = static_cast<char>(state >> 24);
+    }
+    Shrub tree("", ValueHint::JSONObject);
+    tree.append(Shrub("payload"));
+    tree.child("payload")->setBlob(bytes.cString(), bytes.length());
+    String encoded = encodeBase64(bytes.cString(), bytes.length()).ensure();
+    String json = exportJSON(tree).ensure();
+    std::printf("Blobs, %.1f MB payload\n", bytes.length() / (1024.0 * 1024.0));
+
+    report("encodeBase64", measure([&]() { encodeBase64(bytes.cString(), bytes.length()).ensure(); }, 10), bytes.length());
+    report("decodeBase64", measure([&]() { decodeBase64(encoded.cString(), encoded.length()).ensure(); }, 10), bytes.length());
+    report("exportJSON blob", measure([&]() { exportJSON(tree).ensure(); }, 10), bytes.length());
+    report("parseJSON + decodeBlob", measure([&]()
+    {
+        Shrub parsed = parseJSON(json).ensure();
+        parsed.child("payload")->decodeBlob();
+    }, 10), bytes.length());
+}
+
+static void benchmarkColumns()
+{
+    //order lines with a handful of fields each
+    String json = "{\"items\" : [";
+    for (Size i = 0; i < 200000; ++i)
+    {
+        char buffer[160];
+        int length = std::snprintf(buffer, sizeof(buffer), "%s{\"id\" : %d, \"sku\" : \"S%05d\", \"price\" : %.2f, \"qty\" : %d, \"discounted\" : %s}",
+                                   i ? ", " : "", static_cast<int>(i), static_cast<int>(i % 50000), (i % 997) * 0.37, static_cast<int>(i % 13), i % 3 ? "false" : "true");
+        json.append(buffer, length);
+    }
+    json.append("]}");
+    Shrub tree = parseJSON(json).ensure();
+    const Shrub & items = *tree.child("items");
+    ColumnTable table = extractColumns(items).ensure();
+    std::printf("Columns, %.1f MB JSON, 200k objects\n", json.length() / (1024.0 * 1024.0));
+
+    double sum = 0;
+    report("child per field", measure([&]()
+    {
+        for (const Shrub & item : items)
+            sum += std::strtod((*item.child("price")).valueString().cString(), nullptr) * std::strtod((*item.child("qty")).valueString().cString(), nullptr);
+    }, 5), json.length());
+    report("extractColumns", measure([&]() { extractColumns(items).ensure(); }, 5), json.length());
+    report("exportArrow", measure([&]()
+    {
+        ArrowSchema schema;
+        ArrowArray array;
+        exportArrow(items, &schema, &array);
+        array.release(&array);
+        schema.release(&schema);
+    }, 5), json.length());
+    report("column loop", measure([&]()
+    {
+        Span<const Float64> prices = table.findColumn("price")->float64Values();
+        Span<const Int64> quantities = table.findColumn("qty")->int64Values();
+        for (Size i = 0; i < prices.count(); ++i)
+            sum += prices[i] * quantities[i];
+    }, 5), json.length());
+    std::printf("(%f)\n", sum);
+}
+
+int main(int _argc, const char * _args[])
+{
+    benchmarkXMLParseOptions();
+    benchmarkJSONExport();
+    benchmarkBinary();
+    benchmarkMsgPack();
+    benchmarkMessageCodec();
+    benchmarkTypedArrays();
+    benchmarkBlobs();
+    benchmarkColumns();
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <Scrub/Arrow.hpp>
+
+#include <atomic>
+#include <new> //for placement new
+
+namespace scrub
+{
+    using namespace stick;
+
+    namespace detail
+    {
+        //owns the table and the child structs of an export. The schema, the array and each of their
+        //children hold a reference, as consumers may move children out and release them separately.
+        struct ArrowExport
+        {
+            ArrowExport(ColumnTable && _table) :
+                table(std::move(_table)),
+                schemas(table.allocator()),
+                schemaPointers(table.allocator()),
+                arrays(table.allocator()),
+                arrayPointers(table.allocator()),
+                buffers(table.allocator()),
+                referenceCount(0)
+            {
+
+            }
+
+            ColumnTable table;
+            DynamicArray<ArrowSchema> schemas;
+            DynamicArray<ArrowSchema *> schemaPointers;
+            DynamicArray<ArrowArray> arrays;
+            DynamicArray<ArrowArray *> arrayPointers;
+            //three per column followed by the validity of the struct
+            DynamicArray<const void *> buffers;
+            std::atomic<Size> referenceCount;
+        };
+
+        static void releaseExport(ArrowExport * _export)
+        {
+            if (--_export->referenceCount == 0)
+            {
+                Allocator & alloc = _export->table.allocator();
+                _export->~ArrowExport();
+                alloc.deallocate({_export, sizeof(ArrowExport)});
+            }
+        }
+
+        static void releaseSchema(ArrowSchema * _schema)
+        {
+            for (int64_t i = 0; i < _schema->n_children; ++i)
+            {
+                //children that were moved out have been marked released
+                if (_schema->children[i]->release)
+                    _schema->children[i]->release(_schema->children[i]);
+            }
+            ArrowExport * owner = static_cast<ArrowExport *>(_schema->private_data);
+            _schema->release = nullptr;
+            releaseExport(owner);
+        }
+
+        static void releaseArray(ArrowArray * _array)
+        {
+            for (int64_t i = 0; i < _array->n_children; ++i)
+            {
+                if (_array->children[i]->release)
+                    _array->children[i]->release(_array->children[i]);
+            }
+            ArrowExport * owner = static_cast<ArrowExport *>(_array->private_data);
+            _array->release = nullptr;
+            releaseExport(owner);
+        }
+
+        static const char * arrowFormat(ColumnType _type)
+        {
+            switch (_type)
+            {
+                case ColumnType::Bool:
+                    return "b";
+                case ColumnType::Int64:
+                    return "l";
+                case ColumnType::Float64:
+                    return "g";
+                case ColumnType::String:
+                    return "U";
+                case ColumnType::Binary:
+                    return "Z";
+                default:
+                    return "n";
+            }
+        }
+
+        //consumers may not expect null for buffers other than the validity, even if they are empty
+        static const Int64 s_emptyBuffer[1] = {0};
+
+        static const void * bufferPointer(const void * _ptr)
+        {
+            return _ptr ? _ptr : s_emptyBuffer;
+        }
+    }
+
+    Error exportArrow(ColumnTable && _table, ArrowSchema * _outSchema, ArrowArray * _outArray)
+    {
+        Allocator & alloc = _table.allocator();
+        auto block = alloc.allocate(sizeof(detail::ArrowExport), alignof(detail::ArrowExport));
+        if (!block.ptr)
+            return Error(ec::BadAlloc, "Failed to allocate the Arrow export", STICK_FILE, STICK_LINE);
+        detail::ArrowExport * owner = new (block.ptr) detail::ArrowExport(std::move(_table));
+
+        const ColumnTable & table = owner->table;
+        Size columnCount = table.columnCount();
+        owner->schemas.resize(columnCount);
+        owner->arrays.resize(columnCount);
+        owner->buffers.resize(columnCount * 3 + 1, nullptr);
+        for (Size i = 0; i < columnCount; ++i)
+        {
+            const Column & column = table.column(i);
+            const void ** buffers = owner->buffers.ptr() + i * 3;
+            buffers[0] = column.nullCount() ? column.validity().ptr() : nullptr;
+            int64_t bufferCount = 2;
+            switch (column.type())
+            {
+                case ColumnType::Bool:
+                    buffers[1] = detail::bufferPointer(column.boolBits().ptr());
+                    break;
+                case ColumnType::Int64:
+                    buffers[1] = detail::bufferPointer(column.int64Values().ptr());
+                    break;
+                case ColumnType::Float64:
+                    buffers[1] = detail::bufferPointer(column.float64Values().ptr());
+                    break;
+                case ColumnType::String:
+                case ColumnType::Binary:
+                    buffers[1] = detail::bufferPointer(column.offsets().ptr());
+                    buffers[2] = detail::bufferPointer(column.characters().ptr());
+                    bufferCount = 3;
+                    break;
+                default:
+                    //the null layout has no buffers at all
+                    buffers[0] = nullptr;
+                    bufferCount = 0;
+                    break;
+            }
+
+            ArrowSchema & schema = owner->schemas[i];
+            schema.format = detail::arrowFormat(column.type());
+            schema.name = column.name().cString();
+            schema.metadata = nullptr;
+            schema.flags = ARROW_FLAG_NULLABLE;
+            schema.n_children = 0;
+            schema.children = nullptr;
+            schema.dictionary = nullptr;
+            schema.release = detail::releaseSchema;
+            schema.private_data = owner;
+
+            ArrowArray & array = owner->arrays[i];
+            array.length = static_cast<int64_t>(column.count());
+            array.null_count = static_cast<int64_t>(column.nullCount());
+            array.offset = 0;
+            array.n_buffers = bufferCount;
+            array.n_children = 0;
+            array.buffers = buffers;
+            array.children = nullptr;
+            array.dictionary = nullptr;
+            array.release = detail::releaseArray;
+            array.private_data = owner;
+        }
+
+        for (Size i = 0; i < columnCount; ++i)
+        {
+            owner->schemaPointers.append(&owner->schemas[i]);
+            owner->arrayPointers.append(&owner->arrays[i]);
+        }
+
+        _outSchema->format = "+s";
+        _outSchema->name = "";
+        _outSchema->metadata = nullptr;
+        _outSchema->flags = 0;
+        _outSchema->n_children = static_cast<int64_t>(columnCount);
+        _outSchema->children = owner->schemaPointers.ptr();
+        _outSchema->dictionary = nullptr;
+        _outSchema->release = detail::releaseSchema;
+        _outSchema->private_data = owner;
+
+        _outArray->length = static_cast<int64_t>(table.rowCount());
+        _outArray->null_count = 0;
+        _outArray->offset = 0;
+        _outArray->n_buffers = 1;
+        _outArray->n_children = static_cast<int64_t>(columnCount);
+        _outArray->buffers = owner->buffers.ptr() + columnCount * 3;
+        _outArray->children = owner->arrayPointers.ptr();
+        _outArray->dictionary = nullptr;
+        _outArray->release = detail::releaseArray;
+        _outArray->private_data = owner;
+
+        //the two top level structs and their children
+        owner->referenceCount = 2 + columnCount * 2;
+        return Error();
+    }
+
+    Error exportArrow(const Shrub & _array, ArrowSchema * _outSchema, ArrowArray * _outArray, Allocator & _alloc)
+    {
+        auto result = extractColumns(_array, _alloc);
+        if (!result)
+            return result.error();
+        return exportArrow(std::move(result.get()), _outSchema, _outArray);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef SCRUB_ARROW_HPP
+#define SCRUB_ARROW_HPP
+
+#include <Scrub/ColumnTable.hpp>
+
+#include <cstdint>
+
+//the structs of the Apache Arrow C data interface, as its specification defines them so that they
+//can be handed to any consumer without depending on Arrow.
+extern "C"
+{
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+    struct ArrowSchema
+    {
+        const char * format;
+        const char * name;
+        const char * metadata;
+        int64_t flags;
+        int64_t n_children;
+        struct ArrowSchema ** children;
+        struct ArrowSchema * dictionary;
+        void (*release)(struct ArrowSchema *);
+        void * private_data;
+    };
+
+    struct ArrowArray
+    {
+        int64_t length;
+        int64_t null_count;
+        int64_t offset;
+        int64_t n_buffers;
+        int64_t n_children;
+        const void ** buffers;
+        struct ArrowArray ** children;
+        struct ArrowArray * dictionary;
+        void (*release)(struct ArrowArray *);
+        void * private_data;
+    };
+
+#endif //ARROW_C_DATA_INTERFACE
+}
+
+namespace scrub
+{
+    //Exports _table as a struct array with a nullable child per column: Bool columns are "b",
+    //Int64 "l", Float64 "g", String "U" (large utf8), Binary "Z" (large binary) and Null "n". The
+    //children point into the column buffers, _table is moved into the export and freed once the
+    //schema, the array and all children that were moved out of them are released.
+    STICK_API stick::Error exportArrow(ColumnTable && _table, ArrowSchema * _outSchema, ArrowArray * _outArray);
+
+    //extracts the columns of an array of objects (see extractColumns) and exports them.
+    STICK_API stick::Error exportArrow(const Shrub & _array, ArrowSchema * _outSchema, ArrowArray * _outArray, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_ARROW_HPP
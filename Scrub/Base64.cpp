@@ -0,0 +1,222 @@
+#include <Scrub/Base64.hpp>
+
+//the SSSE3 paths are compiled for x86 regardless of the build flags and chosen at runtime
+#if !defined(SCRUB_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SCRUB_BASE64_SSSE3
+#define SCRUB_TARGET_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#endif
+
+namespace scrub
+{
+    using namespace stick;
+
+    static const char s_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    //the 6 bit value of every character, -1 for the ones outside the alphabet
+    struct DecodeTable
+    {
+        DecodeTable()
+        {
+            for (Size i = 0; i < 256; ++i)
+                values[i] = -1;
+            for (Size i = 0; i < 64; ++i)
+                values[static_cast<UInt8>(s_alphabet[i])] = static_cast<Int8>(i);
+        }
+
+        Int8 values[256];
+    };
+
+    static const DecodeTable s_decodeTable;
+
+#ifdef SCRUB_BASE64_SSSE3
+    static bool hasSSSE3()
+    {
+        static const bool s_bSupported = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+        return s_bSupported;
+    }
+
+    //the 16 characters of the first 12 bytes of _in (Wojciech Muła's algorithm)
+    SCRUB_TARGET_SSSE3 static __m128i encodeBlock(__m128i _in)
+    {
+        //every 32 bit lane gets the 3 bytes it encodes, then the four 6 bit groups are moved into bytes
+        __m128i in = _mm_shuffle_epi8(_in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t0, t1);
+
+        //maps each range of the alphabet to the offset that turns its values into characters
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+        return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+    }
+
+    //decodes 16 characters into the first 12 bytes of _out, false if any of them is outside the alphabet
+    SCRUB_TARGET_SSSE3 static bool decodeBlock(__m128i _in, __m128i & _out)
+    {
+        //the nibbles classify the characters, a character is valid if its classes don't overlap
+        const __m128i lowClasses = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i highClasses = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i slash = _mm_set1_epi8(0x2F);
+
+        __m128i high = _mm_and_si128(_mm_srli_epi32(_in, 4), slash);
+        __m128i low = _mm_and_si128(_in, slash);
+        __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lowClasses, low), _mm_shuffle_epi8(highClasses, high));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(classes, _mm_setzero_si128())))
+            return false;
+
+        //'/' shares its high nibble with '+' and gets its own offset
+        __m128i values = _mm_add_epi8(_in, _mm_shuffle_epi8(offsets, _mm_add_epi8(_mm_cmpeq_epi8(_in, slash), high)));
+
+        //packs the four 6 bit values of every 32 bit lane into 3 bytes
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i lanes = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _out = _mm_shuffle_epi8(lanes, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        return true;
+    }
+
+    //encodes 12 bytes at a time and returns how many, the loads read 16
+    SCRUB_TARGET_SSSE3 static Size encodeBlocks(const UInt8 * _in, Size _byteCount, char * _out)
+    {
+        Size i = 0;
+        for (; i + 16 <= _byteCount; i += 12, _out += 16)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(_out), encodeBlock(_mm_loadu_si128(reinterpret_cast<const __m128i *>(_in + i))));
+        return i;
+    }
+
+    //decodes 16 characters at a time up to the first one outside the alphabet and returns how many
+    SCRUB_TARGET_SSSE3 static Size decodeBlocks(const UInt8 * _in, Size _length, char * _out)
+    {
+        Size i = 0;
+        //the stores write 16 bytes, 24 characters left mean there are at least 18 to go
+        for (; i + 24 <= _length; i += 16, _out += 12)
+        {
+            __m128i block;
+            if (!decodeBlock(_mm_loadu_si128(reinterpret_cast<const __m128i *>(_in + i)), block))
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(_out), block);
+        }
+        return i;
+    }
+#endif
+
+    Size encodeBase64(const char * _data, Size _byteCount, char * _out)
+    {
+        const UInt8 * in = reinterpret_cast<const UInt8 *>(_data);
+        char * out = _out;
+        Size i = 0;
+#ifdef SCRUB_BASE64_SSSE3
+        if (hasSSSE3())
+        {
+            i = encodeBlocks(in, _byteCount, out);
+            out += i / 3 * 4;
+        }
+#endif
+        for (; i + 3 <= _byteCount; i += 3, out += 4)
+        {
+            UInt32 group = static_cast<UInt32>(in[i]) << 16 | static_cast<UInt32>(in[i + 1]) << 8 | in[i + 2];
+            out[0] = s_alphabet[group >> 18];
+            out[1] = s_alphabet[(group >> 12) & 0x3F];
+            out[2] = s_alphabet[(group >> 6) & 0x3F];
+            out[3] = s_alphabet[group & 0x3F];
+        }
+
+        if (i < _byteCount)
+        {
+            UInt32 group = static_cast<UInt32>(in[i]) << 16 | (i + 1 < _byteCount ? static_cast<UInt32>(in[i + 1]) << 8 : 0);
+            out[0] = s_alphabet[group >> 18];
+            out[1] = s_alphabet[(group >> 12) & 0x3F];
+            out[2] = i + 1 < _byteCount ? s_alphabet[(group >> 6) & 0x3F] : '=';
+            out[3] = '=';
+            out += 4;
+        }
+        return out - _out;
+    }
+
+    TextResult encodeBase64(const char * _data, Size _byteCount, Allocator & _alloc)
+    {
+        String ret(_alloc);
+        ret.resize(base64EncodedLength(_byteCount));
+        encodeBase64(_data, _byteCount, ret.length() ? &ret[0] : nullptr);
+        return ret;
+    }
+
+    static bool isWhitespace(char _c)
+    {
+        return _c == ' ' || _c == '\t' || _c == '\n' || _c == '\r' || _c == '\f' || _c == '\v';
+    }
+
+    //decodes _text without whitespace into _out, false if it isn't valid base64
+    static bool decodeCompact(const char * _text, Size _length, String & _out)
+    {
+        Size padding = 0;
+        while (padding < 2 && padding < _length && _text[_length - 1 - padding] == '=')
+            ++padding;
+        Size length = _length - padding;
+        //padding only ever completes the last group and a single character doesn't encode a byte
+        if ((padding && _length % 4) || length % 4 == 1)
+            return false;
+
+        Size byteCount = length / 4 * 3 + (length % 4 ? length % 4 - 1 : 0);
+        _out.resize(byteCount);
+        if (!byteCount)
+            return true;
+
+        const UInt8 * in = reinterpret_cast<const UInt8 *>(_text);
+        char * out = &_out[0];
+        Size i = 0;
+#ifdef SCRUB_BASE64_SSSE3
+        if (hasSSSE3())
+        {
+            i = decodeBlocks(in, length, out);
+            out += i / 4 * 3;
+        }
+#endif
+        const Int8 * table = s_decodeTable.values;
+        for (; i + 4 <= length; i += 4, out += 3)
+        {
+            Int32 a = table[in[i]], b = table[in[i + 1]], c = table[in[i + 2]], d = table[in[i + 3]];
+            if ((a | b | c | d) < 0)
+                return false;
+            UInt32 group = static_cast<UInt32>(a) << 18 | static_cast<UInt32>(b) << 12 | static_cast<UInt32>(c) << 6 | static_cast<UInt32>(d);
+            out[0] = static_cast<char>(group >> 16);
+            out[1] = static_cast<char>(group >> 8);
+            out[2] = static_cast<char>(group);
+        }
+
+        if (i < length)
+        {
+            Int32 a = table[in[i]], b = table[in[i + 1]], c = i + 2 < length ? table[in[i + 2]] : 0;
+            if ((a | b | c) < 0)
+                return false;
+            UInt32 group = static_cast<UInt32>(a) << 18 | static_cast<UInt32>(b) << 12 | static_cast<UInt32>(c) << 6;
+            out[0] = static_cast<char>(group >> 16);
+            if (i + 2 < length)
+                out[1] = static_cast<char>(group >> 8);
+        }
+        return true;
+    }
+
+    TextResult decodeBase64(const char * _text, Size _length, Allocator & _alloc)
+    {
+        String ret(_alloc);
+        if (decodeCompact(_text, _length, ret))
+            return ret;
+
+        //line breaks and indentation are the only reason for valid input to fail the fast path
+        String compact(_alloc);
+        compact.reserve(_length);
+        for (Size i = 0; i < _length; ++i)
+        {
+            if (!isWhitespace(_text[i]))
+                compact.append(_text[i]);
+        }
+        if (compact.length() == _length || !decodeCompact(compact.cString(), compact.length(), ret))
+            return Error(ec::ParseFailed, "Failed to decode base64: invalid character or length", STICK_FILE, STICK_LINE);
+        return ret;
+    }
+}
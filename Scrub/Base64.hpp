@@ -0,0 +1,41 @@
+#ifndef SCRUB_BASE64_HPP
+#define SCRUB_BASE64_HPP
+
+#include <Stick/Result.hpp>
+#include <Stick/String.hpp>
+
+namespace scrub
+{
+    //Base64 with the standard alphabet and padding (RFC 4648). Uses SSSE3 on x86 processors that
+    //support it and lookup tables otherwise, or always with SCRUB_NO_SIMD defined.
+
+    //the number of characters encodeBase64 writes for _byteCount bytes
+    inline stick::Size base64EncodedLength(stick::Size _byteCount)
+    {
+        return (_byteCount + 2) / 3 * 4;
+    }
+
+    //writes base64EncodedLength(_byteCount) characters to _out and returns that count.
+    STICK_API stick::Size encodeBase64(const char * _data, stick::Size _byteCount, char * _out);
+
+    STICK_API stick::TextResult encodeBase64(const char * _data, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+
+    //appends the encoding of _data to _out (anything with append(const char *, Size)) in chunks,
+    //so it needs no temporary copy of the whole text.
+    template<class W>
+    void writeBase64(W & _out, const char * _data, stick::Size _byteCount)
+    {
+        char buffer[1024];
+        const stick::Size chunkSize = sizeof(buffer) / 4 * 3;
+        for (stick::Size i = 0; i < _byteCount; i += chunkSize)
+        {
+            stick::Size count = _byteCount - i < chunkSize ? _byteCount - i : chunkSize;
+            _out.append(buffer, encodeBase64(_data + i, count, buffer));
+        }
+    }
+
+    //the bytes encoded in _text. ASCII whitespace is skipped, the padding is optional.
+    STICK_API stick::TextResult decodeBase64(const char * _text, stick::Size _length, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_BASE64_HPP
@@ -0,0 +1,270 @@
+#ifndef SCRUB_BINARY_BINARYNODES_HPP
+#define SCRUB_BINARY_BINARYNODES_HPP
+
+#include <Scrub/Binary/BinarySerializer.hpp>
+#include <Scrub/Binary/KeyDictionary.hpp>
+
+//reading and writing the nodes of the streamed binary layout, shared by exportBinary and the
+//message codec.
+namespace scrub
+{
+    namespace binary
+    {
+        //key index, flags, value length and child count take at least a byte each
+        static const Size s_minNodeSize = 4;
+
+        struct NodeRange
+        {
+            const Shrub * next;
+            const Shrub * end;
+        };
+
+        //calls _fn for every node in pre-order, without recursion. The elements of packed arrays
+        //are passed to _element with their array and index instead, so they are written as the
+        //children they would unpack into without unpacking them.
+        template<class F, class E>
+        inline void forEachNode(const Shrub & _root, F _fn, E _element)
+        {
+            DynamicArray<NodeRange> stack(const_cast<Allocator &>(_root.allocator()));
+            auto visit = [&](const Shrub & _node)
+            {
+                _fn(_node);
+                if (_node.arrayType() != ArrayType::None)
+                {
+                    for (Size i = 0; i < _node.count(); ++i)
+                        _element(_node, i);
+                }
+                else if (_node.count())
+                {
+                    stack.append({&*_node.begin(), &*_node.begin() + _node.count()});
+                }
+            };
+
+            visit(_root);
+            while (stack.count())
+            {
+                NodeRange & top = stack.last();
+                if (top.next == top.end)
+                {
+                    stack.resize(stack.count() - 1);
+                    continue;
+                }
+                visit(*top.next++);
+            }
+        }
+
+        //the key id of every node in pre-order, elements of packed arrays are unnamed
+        inline void collectKeyIds(const Shrub & _root, KeyDictionary & _dictionary, DynamicArray<UInt32> & _outIds)
+        {
+            Maybe<UInt32> unnamed;
+            forEachNode(_root, [&](const Shrub & _node) { _outIds.append(_dictionary.add(_node.name())); },
+                        [&](const Shrub &, Size)
+            {
+                if (!unnamed)
+                    unnamed = _dictionary.add(String(_dictionary.allocator()));
+                _outIds.append(*unnamed);
+            });
+        }
+
+        template<class W>
+        inline void writeVarint(W & _out, UInt64 _value)
+        {
+            char bytes[10];
+            Size count = 0;
+            while (_value >= 0x80)
+            {
+                bytes[count++] = static_cast<char>((_value & 0x7F) | 0x80);
+                _value >>= 7;
+            }
+            bytes[count++] = static_cast<char>(_value);
+            _out.append(bytes, count);
+        }
+
+        template<class W>
+        inline void writeKeys(W & _out, const KeyDictionary & _dictionary, Size _first)
+        {
+            writeVarint(_out, _dictionary.count() - _first);
+            for (Size i = _first; i < _dictionary.count(); ++i)
+            {
+                const String & key = _dictionary.key(static_cast<UInt32>(i));
+                writeVarint(_out, key.length());
+                _out.append(key);
+            }
+        }
+
+        //the nodes in pre-order, _keyIds holds the key id of each
+        template<class W>
+        inline void writeNodes(W & _out, const Shrub & _root, const DynamicArray<UInt32> & _keyIds)
+        {
+            Size i = 0;
+            forEachNode(_root, [&](const Shrub & _node)
+            {
+                writeVarint(_out, _keyIds[i++]);
+                UInt8 flags = static_cast<UInt8>(_node.valueHint()) | (_node.isNameKnownClean() ? s_nameKnownClean : 0) |
+                              (_node.isValueKnownClean() ? s_valueKnownClean : 0);
+                _out.append(static_cast<char>(flags));
+                writeVarint(_out, _node.valueString().length());
+                _out.append(_node.valueString());
+                writeVarint(_out, _node.count());
+            },
+            [&](const Shrub & _array, Size _index)
+            {
+                writeVarint(_out, _keyIds[i++]);
+                _out.append(static_cast<char>(static_cast<UInt8>(packedElementHint(_array.arrayType())) | s_nameKnownClean | s_valueKnownClean));
+                char buffer[32];
+                Size length = _array.formatTypedElement(_index, buffer);
+                writeVarint(_out, length);
+                _out.append(buffer, length);
+                writeVarint(_out, 0);
+            });
+        }
+
+        class BinaryReader
+        {
+        public:
+
+            BinaryReader(const char * _data, Size _byteCount) :
+                m_it(_data),
+                m_end(_data + _byteCount)
+            {
+
+            }
+
+            bool readVarint(UInt64 & _out)
+            {
+                _out = 0;
+                for (UInt32 shift = 0; shift < 64 && m_it != m_end; shift += 7)
+                {
+                    UInt8 byte = static_cast<UInt8>(*m_it++);
+                    _out |= static_cast<UInt64>(byte & 0x7F) << shift;
+                    if (!(byte & 0x80))
+                        return true;
+                }
+                return false;
+            }
+
+            //a varint that is at most _max
+            bool readCount(Size _max, Size & _out)
+            {
+                UInt64 value;
+                if (!readVarint(value) || value > _max)
+                    return false;
+                _out = static_cast<Size>(value);
+                return true;
+            }
+
+            bool readBytes(const char *& _out, Size _byteCount)
+            {
+                if (_byteCount > remaining())
+                    return false;
+                _out = m_it;
+                m_it += _byteCount;
+                return true;
+            }
+
+            bool readByte(UInt8 & _out)
+            {
+                if (m_it == m_end)
+                    return false;
+                _out = static_cast<UInt8>(*m_it++);
+                return true;
+            }
+
+            Size remaining() const
+            {
+                return m_end - m_it;
+            }
+
+        private:
+
+            const char * m_it;
+            const char * m_end;
+        };
+
+        inline Error binaryError(const char * _what)
+        {
+            return Error(ec::ParseFailed, String::concat("Failed to parse binary Shrub: ", _what), STICK_FILE, STICK_LINE);
+        }
+
+        //reads everything of a node but its children, _childCount is how many follow
+        inline bool readNode(BinaryReader & _reader, const DynamicArray<String> & _keys, Shrub & _node, Size & _childCount)
+        {
+            Size key, valueLength;
+            UInt8 flags;
+            const char * value;
+            if (!_keys.count() || !_reader.readCount(_keys.count() - 1, key) || !_reader.readByte(flags) ||
+                (flags & s_hintMask) > static_cast<UInt8>(ValueHint::Binary) ||
+                !_reader.readCount(_reader.remaining(), valueLength) || !_reader.readBytes(value, valueLength) ||
+                !_reader.readCount(_reader.remaining() / s_minNodeSize, _childCount))
+                return false;
+
+            Allocator & alloc = _node.allocator();
+            _node.setName(_keys[key]);
+            _node.setValue(String(value, valueLength, alloc));
+            _node.setValueHint(static_cast<ValueHint>(flags & s_hintMask));
+            _node.setKnownClean(flags & s_nameKnownClean, flags & s_valueKnownClean);
+            return true;
+        }
+
+        struct ParseFrame
+        {
+            Shrub * node;
+            Size remaining;
+        };
+
+        //appends the keys that follow to _keys
+        inline bool readKeys(BinaryReader & _reader, DynamicArray<String> & _keys)
+        {
+            Size keyCount;
+            if (!_reader.readCount(_reader.remaining(), keyCount))
+                return false;
+            _keys.reserve(_keys.count() + keyCount);
+            for (Size i = 0; i < keyCount; ++i)
+            {
+                Size length;
+                const char * key;
+                if (!_reader.readCount(_reader.remaining(), length) || !_reader.readBytes(key, length))
+                    return false;
+                _keys.append(String(key, length, _keys.allocator()));
+            }
+            return true;
+        }
+
+        inline Error readTree(BinaryReader & _reader, const DynamicArray<String> & _keys, Shrub & _root)
+        {
+            //children are only appended to the node on top of the stack, so growing its children never
+            //moves a node that is still on the stack. The child counts come from untrusted data and
+            //nested nodes could each claim the rest of the input, so nothing is reserved up front.
+            Allocator & alloc = _root.allocator();
+            Size childCount;
+            if (!readNode(_reader, _keys, _root, childCount))
+                return binaryError("invalid node");
+
+            DynamicArray<ParseFrame> stack(alloc);
+            if (childCount)
+                stack.append({&_root, childCount});
+            while (stack.count())
+            {
+                ParseFrame & top = stack.last();
+                if (!top.remaining)
+                {
+                    stack.resize(stack.count() - 1);
+                    continue;
+                }
+
+                --top.remaining;
+                Shrub & child = top.node->append(Shrub(alloc));
+                if (!readNode(_reader, _keys, child, childCount))
+                    return binaryError("invalid node");
+                if (childCount)
+                    stack.append({&child, childCount});
+            }
+
+            if (_reader.remaining())
+                return binaryError("unexpected data after the root node");
+            return Error();
+        }
+    }
+}
+
+#endif //SCRUB_BINARY_BINARYNODES_HPP
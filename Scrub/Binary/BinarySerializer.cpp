@@ -0,0 +1,240 @@
+#include <Scrub/Binary/BinaryNodes.hpp>
+#include <Scrub/Sink.hpp>
+
+#include <algorithm>
+
+namespace scrub
+{
+    namespace binary
+    {
+        static const char s_magic[4] = {'S', 'H', 'R', 'B'};
+        static const UInt8 s_version = 1;
+
+        template<class W>
+        static void writeBinary(const Shrub & _root, W & _out)
+        {
+            //the first pass collects the dictionary and remembers every node's key, the second writes
+            Allocator & alloc = const_cast<Allocator &>(_root.allocator());
+            KeyDictionary dictionary(alloc);
+            DynamicArray<UInt32> keyIds(alloc);
+            collectKeyIds(_root, dictionary, keyIds);
+
+            _out.append(s_magic, 4);
+            _out.append(static_cast<char>(s_version));
+            writeKeys(_out, dictionary, 0);
+            writeNodes(_out, _root, keyIds);
+        }
+
+        Error exportBinary(const Shrub & _shrub, Sink & _sink, Size _bufferSize)
+        {
+            BufferedSink out(_sink, _bufferSize, const_cast<Allocator &>(_shrub.allocator()));
+            writeBinary(_shrub, out);
+            return out.flush();
+        }
+
+        TextResult exportBinary(const Shrub & _shrub)
+        {
+            String ret(const_cast<Allocator &>(_shrub.allocator()));
+            StringWriter out(ret);
+            writeBinary(_shrub, out);
+            return ret;
+        }
+
+        template<class W, class T>
+        static void appendRaw(W & _out, const T & _value)
+        {
+            _out.append(reinterpret_cast<const char *>(&_value), sizeof(T));
+        }
+
+        static UInt64 mappedStringSize(const String & _str)
+        {
+            return sizeof(UInt32) + _str.length() + 1;
+        }
+
+        template<class W>
+        static void writeMappedString(W & _out, const String & _str)
+        {
+            appendRaw(_out, static_cast<UInt32>(_str.length()));
+            _out.append(_str);
+            _out.append('\0');
+        }
+
+        //a node of the mapped layout, either a Shrub or the element at index of a packed array
+        struct MappedEntry
+        {
+            const Shrub * node;
+            Size element;
+        };
+
+        static const Size s_noElement = static_cast<Size>(-1);
+
+        //the value of _entry, packed elements are formatted into _buffer
+        static StringSpan entryValue(const MappedEntry & _entry, char (&_buffer)[32])
+        {
+            if (_entry.element == s_noElement)
+                return StringSpan(_entry.node->valueString().cString(), _entry.node->valueString().length());
+            return StringSpan(_buffer, _entry.node->formatTypedElement(_entry.element, _buffer));
+        }
+
+        //equal names keep their order, so that lookups find the first one like Shrub::child
+        template<class W>
+        static void writeSortedChildren(W & _out, const Shrub & _parent, DynamicArray<UInt32> & _indices)
+        {
+            _indices.resize(_parent.count());
+            for (Size i = 0; i < _indices.count(); ++i)
+                _indices[i] = static_cast<UInt32>(i);
+            //packed elements are all unnamed and already in order
+            if (_parent.arrayType() == ArrayType::None)
+            {
+                const Shrub * children = &*_parent.begin();
+                std::stable_sort(_indices.begin(), _indices.end(), [children](UInt32 _a, UInt32 _b)
+                {
+                    const String & a = children[_a].name();
+                    const String & b = children[_b].name();
+                    return compareNames(a.cString(), a.length(), b.cString(), b.length()) < 0;
+                });
+            }
+            _out.append(reinterpret_cast<const char *>(&_indices[0]), _indices.count() * sizeof(UInt32));
+        }
+
+        template<class W>
+        static void writeMappedBinary(const Shrub & _root, W & _out)
+        {
+            //every offset follows from the breadth first order and the string sizes, so the data
+            //is written front to back after one pass to collect them.
+            Allocator & alloc = const_cast<Allocator &>(_root.allocator());
+            DynamicArray<MappedEntry> order(alloc);
+            order.append({&_root, s_noElement});
+            for (Size i = 0; i < order.count(); ++i)
+            {
+                if (order[i].element != s_noElement)
+                    continue;
+                const Shrub & node = *order[i].node;
+                if (node.arrayType() != ArrayType::None)
+                {
+                    for (Size j = 0; j < node.count(); ++j)
+                        order.append({&node, j});
+                }
+                else
+                {
+                    for (const Shrub & child : node)
+                        order.append({&child, s_noElement});
+                }
+            }
+
+            KeyDictionary dictionary(alloc);
+            String unnamed(alloc);
+            DynamicArray<UInt32> keyIndices(alloc);
+            keyIndices.reserve(order.count());
+            for (const MappedEntry & entry : order)
+                keyIndices.append(dictionary.add(entry.element == s_noElement ? entry.node->name() : unnamed));
+
+            //every node but the root has one entry in a child table
+            UInt64 tables = sizeof(detail::MappedHeader) + order.count() * sizeof(detail::MappedNode);
+            UInt64 offset = tables + (order.count() - 1) * sizeof(UInt32);
+            DynamicArray<UInt64> keyOffsets(alloc);
+            keyOffsets.reserve(dictionary.keys().count());
+            for (const String & key : dictionary.keys())
+            {
+                keyOffsets.append(offset);
+                offset += mappedStringSize(key);
+            }
+            UInt64 values = offset;
+            char buffer[32];
+            for (const MappedEntry & entry : order)
+                offset += sizeof(UInt32) + entryValue(entry, buffer).count() + 1;
+
+            detail::MappedHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, s_mappedMagic, 4);
+            header.version = s_mappedVersion;
+            header.byteCount = offset;
+            header.nodeCount = order.count();
+            header.root = sizeof(detail::MappedHeader);
+            appendRaw(_out, header);
+
+            UInt64 nextChild = header.root + sizeof(detail::MappedNode);
+            UInt64 table = tables;
+            for (Size i = 0; i < order.count(); ++i)
+            {
+                const MappedEntry & entry = order[i];
+                detail::MappedNode node;
+                std::memset(&node, 0, sizeof(node));
+                node.name = keyOffsets[keyIndices[i]];
+                node.value = values;
+                if (entry.element == s_noElement)
+                {
+                    const Shrub & src = *entry.node;
+                    node.childCount = static_cast<UInt32>(src.count());
+                    node.flags = static_cast<UInt8>(src.valueHint()) | (src.isNameKnownClean() ? s_nameKnownClean : 0) |
+                                 (src.isValueKnownClean() ? s_valueKnownClean : 0);
+                }
+                else
+                {
+                    node.flags = static_cast<UInt8>(packedElementHint(entry.node->arrayType())) | s_nameKnownClean | s_valueKnownClean;
+                }
+                if (node.childCount)
+                {
+                    node.children = nextChild;
+                    node.sortedChildren = table;
+                    nextChild += node.childCount * sizeof(detail::MappedNode);
+                    table += node.childCount * sizeof(UInt32);
+                }
+                appendRaw(_out, node);
+                values += sizeof(UInt32) + entryValue(entry, buffer).count() + 1;
+            }
+
+            DynamicArray<UInt32> indices(alloc);
+            for (const MappedEntry & entry : order)
+            {
+                if (entry.element == s_noElement && entry.node->count())
+                    writeSortedChildren(_out, *entry.node, indices);
+            }
+            for (const String & key : dictionary.keys())
+                writeMappedString(_out, key);
+            for (const MappedEntry & entry : order)
+            {
+                StringSpan value = entryValue(entry, buffer);
+                appendRaw(_out, static_cast<UInt32>(value.count()));
+                _out.append(value.ptr(), value.count());
+                _out.append('\0');
+            }
+        }
+
+        Error exportMappedBinary(const Shrub & _shrub, Sink & _sink, Size _bufferSize)
+        {
+            BufferedSink out(_sink, _bufferSize, const_cast<Allocator &>(_shrub.allocator()));
+            writeMappedBinary(_shrub, out);
+            return out.flush();
+        }
+
+        TextResult exportMappedBinary(const Shrub & _shrub)
+        {
+            String ret(const_cast<Allocator &>(_shrub.allocator()));
+            StringWriter out(ret);
+            writeMappedBinary(_shrub, out);
+            return ret;
+        }
+
+        ShrubResult parseBinary(const char * _data, Size _byteCount, Allocator & _alloc)
+        {
+            BinaryReader reader(_data, _byteCount);
+            const char * magic;
+            UInt8 version;
+            if (!reader.readBytes(magic, 4) || std::memcmp(magic, s_magic, 4) != 0)
+                return binaryError("not a binary Shrub");
+            if (!reader.readByte(version) || version != s_version)
+                return binaryError("unsupported version");
+
+            DynamicArray<String> keys(_alloc);
+            if (!readKeys(reader, keys) || !keys.count())
+                return binaryError("invalid key dictionary");
+
+            Shrub ret(_alloc);
+            Error err = readTree(reader, keys, ret);
+            if (err)
+                return err;
+            return ret;
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef SCRUB_BINARY_BINARYSERIALIZER_HPP
+#define SCRUB_BINARY_BINARYSERIALIZER_HPP
+
+#include <Scrub/Shrub.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace scrub
+{
+    namespace detail
+    {
+        //The mapped layout is read in place, so everything is at a fixed position and in the byte
+        //order of the host that wrote it (the version doesn't match otherwise). The header is followed
+        //by all nodes in breadth first order, which puts the children of every node next to each other,
+        //then the name sorted child tables and last the strings. Names are stored once. A string is a
+        //UInt32 length, the bytes and a terminating zero. Offsets are relative to the start of the data.
+        struct MappedHeader
+        {
+            char magic[4];
+            stick::UInt32 version;
+            stick::UInt64 byteCount;
+            stick::UInt64 nodeCount;
+            stick::UInt64 root;
+        };
+
+        struct MappedNode
+        {
+            stick::UInt64 name;
+            stick::UInt64 value;
+            //offset of the first child
+            stick::UInt64 children;
+            //offset of childCount UInt32 child indices, sorted by name
+            stick::UInt64 sortedChildren;
+            stick::UInt32 childCount;
+            //same as in the streamed layout
+            stick::UInt8 flags;
+            stick::UInt8 padding[3];
+        };
+    }
+
+    namespace binary
+    {
+        using namespace stick;
+
+        //Layout: the magic "SHRB" and a version byte, the key dictionary (a count followed by length
+        //prefixed names) and the nodes in pre-order. A node is the dictionary index of its name, a byte
+        //with the ValueHint in the low bits and the known clean marks in the top two, the length
+        //prefixed value and the number of children that follow it. All counts and lengths are LEB128
+        //varints.
+        STICK_LOCAL Error exportBinary(const Shrub & _shrub, Sink & _sink, Size _bufferSize = 64 * 1024);
+        STICK_LOCAL TextResult exportBinary(const Shrub & _shrub);
+        STICK_LOCAL ShrubResult parseBinary(const char * _data, Size _byteCount, Allocator & _alloc);
+        STICK_LOCAL Error exportMappedBinary(const Shrub & _shrub, Sink & _sink, Size _bufferSize = 64 * 1024);
+        STICK_LOCAL TextResult exportMappedBinary(const Shrub & _shrub);
+
+        static const char s_mappedMagic[4] = {'S', 'H', 'R', 'M'};
+        static const UInt32 s_mappedVersion = 1;
+        static const UInt8 s_hintMask = 0x3F;
+        static const UInt8 s_nameKnownClean = 0x40;
+        static const UInt8 s_valueKnownClean = 0x80;
+
+        //the hint of the children that the elements of a packed array unpack into
+        inline ValueHint packedElementHint(ArrayType _type)
+        {
+            return _type == ArrayType::Float32 || _type == ArrayType::Float64 ? ValueHint::JSONDouble : ValueHint::JSONInt;
+        }
+
+        //orders the mapped child tables, by bytes and shorter first on a common prefix
+        inline int compareNames(const char * _a, Size _aLength, const char * _b, Size _bLength)
+        {
+            int ret = std::memcmp(_a, _b, _aLength < _bLength ? _aLength : _bLength);
+            if (ret)
+                return ret;
+            return _aLength < _bLength ? -1 : (_aLength > _bLength ? 1 : 0);
+        }
+
+        //the powers of ten that are exact doubles and can scale a value with up to 15 decimals
+        static const Float64 s_powersOfTen[16] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+        //writes the null terminated text of _mantissa / 10^_decimals
+        inline Size formatDecimal(bool _bNegative, UInt64 _mantissa, int _decimals, char (&_buffer)[32])
+        {
+            char digits[24];
+            int count = 0;
+            do
+            {
+                digits[count++] = static_cast<char>('0' + _mantissa % 10);
+                _mantissa /= 10;
+            }
+            while (_mantissa);
+            //leading zeros for the integer part and the decimals
+            while (count <= _decimals)
+                digits[count++] = '0';
+
+            Size length = 0;
+            if (_bNegative)
+                _buffer[length++] = '-';
+            while (count)
+            {
+                if (count == _decimals)
+                    _buffer[length++] = '.';
+                _buffer[length++] = digits[--count];
+            }
+            _buffer[length] = '\0';
+            return length;
+        }
+
+        //writes the shortest text that reads back as _value (at most _maxPrecision digits) to
+        //_buffer and returns its length. Used by the formats that store floats in binary.
+        template<class T>
+        inline Size formatFloat(T _value, int _maxPrecision, char (&_buffer)[32])
+        {
+            //Most values have a few decimals. The fewest that read back as _value are found without
+            //printing and parsing: both the division and parsing the text round the same exact quotient.
+            Float64 magnitude = _value < 0 ? -static_cast<Float64>(_value) : static_cast<Float64>(_value);
+            if (magnitude >= 1e-4 && magnitude < 1e15)
+            {
+                for (int decimals = 0; decimals < 16; ++decimals)
+                {
+                    Float64 mantissa = std::floor(magnitude * s_powersOfTen[decimals] + 0.5);
+                    //integers above 2^53 aren't exact
+                    if (mantissa >= 9007199254740992.0)
+                        break;
+                    if (static_cast<T>(mantissa / s_powersOfTen[decimals]) == static_cast<T>(magnitude))
+                        return formatDecimal(_value < 0, static_cast<UInt64>(mantissa), decimals, _buffer);
+                }
+            }
+
+            int length = 0;
+            for (int precision = _maxPrecision - 2; precision <= _maxPrecision; ++precision)
+            {
+                length = std::snprintf(_buffer, sizeof(_buffer), "%.*g", precision, static_cast<Float64>(_value));
+                if (static_cast<T>(std::strtod(_buffer, nullptr)) == _value)
+                    break;
+            }
+            return length;
+        }
+    }
+}
+
+#endif //SCRUB_BINARY_BINARYSERIALIZER_HPP
@@ -0,0 +1,88 @@
+#include <Scrub/Binary/KeyDictionary.hpp>
+
+namespace scrub
+{
+    using namespace stick;
+
+    //FNV-1a
+    static Size hashKey(const String & _key)
+    {
+        UInt64 ret = 14695981039346656037ULL;
+        for (Size i = 0; i < _key.length(); ++i)
+            ret = (ret ^ static_cast<unsigned char>(_key[i])) * 1099511628211ULL;
+        return static_cast<Size>(ret);
+    }
+
+    KeyDictionary::KeyDictionary(Allocator & _alloc) :
+        m_keys(_alloc),
+        m_slots(_alloc)
+    {
+        m_slots.resize(64, 0);
+    }
+
+    //the slot of _key or the empty one it goes to
+    Size KeyDictionary::slot(const String & _key) const
+    {
+        Size mask = m_slots.count() - 1;
+        Size ret = hashKey(_key) & mask;
+        while (m_slots[ret] && !(m_keys[m_slots[ret] - 1] == _key))
+            ret = (ret + 1) & mask;
+        return ret;
+    }
+
+    UInt32 KeyDictionary::add(const String & _key)
+    {
+        Size s = slot(_key);
+        if (m_slots[s])
+            return m_slots[s] - 1;
+
+        m_keys.append(_key);
+        m_slots[s] = static_cast<UInt32>(m_keys.count());
+        //at most half full keeps the probe sequences short
+        if (m_keys.count() * 2 > m_slots.count())
+            grow();
+        return static_cast<UInt32>(m_keys.count() - 1);
+    }
+
+    Maybe<UInt32> KeyDictionary::find(const String & _key) const
+    {
+        Size s = slot(_key);
+        if (m_slots[s])
+            return m_slots[s] - 1;
+        return Maybe<UInt32>();
+    }
+
+    const String & KeyDictionary::key(UInt32 _id) const
+    {
+        return m_keys[_id];
+    }
+
+    const DynamicArray<String> & KeyDictionary::keys() const
+    {
+        return m_keys;
+    }
+
+    Size KeyDictionary::count() const
+    {
+        return m_keys.count();
+    }
+
+    Allocator & KeyDictionary::allocator() const
+    {
+        return m_keys.allocator();
+    }
+
+    void KeyDictionary::grow()
+    {
+        Size size = m_slots.count() * 2;
+        m_slots.clear();
+        m_slots.resize(size, 0);
+        for (Size i = 0; i < m_keys.count(); ++i)
+        {
+            Size s = hashKey(m_keys[i]) & (size - 1);
+            while (m_slots[s])
+                s = (s + 1) & (size - 1);
+            m_slots[s] = static_cast<UInt32>(i + 1);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef SCRUB_BINARY_KEYDICTIONARY_HPP
+#define SCRUB_BINARY_KEYDICTIONARY_HPP
+
+#include <Scrub/Shrub.hpp>
+
+namespace scrub
+{
+    //assigns consecutive ids to names in the order they are added. Used by the binary formats
+    //and shared by the two ends of a message stream.
+    class STICK_API KeyDictionary
+    {
+    public:
+
+        KeyDictionary(stick::Allocator & _alloc = stick::defaultAllocator());
+
+        //the id of _key, it is added if it is new.
+        stick::UInt32 add(const stick::String & _key);
+
+        stick::Maybe<stick::UInt32> find(const stick::String & _key) const;
+
+        const stick::String & key(stick::UInt32 _id) const;
+
+        const stick::DynamicArray<stick::String> & keys() const;
+
+        stick::Size count() const;
+
+        stick::Allocator & allocator() const;
+
+    private:
+
+        stick::Size slot(const stick::String & _key) const;
+
+        void grow();
+
+
+        stick::DynamicArray<stick::String> m_keys;
+        //id + 1 of the key in each slot, 0 for empty ones
+        stick::DynamicArray<stick::UInt32> m_slots;
+    };
+}
+
+#endif //SCRUB_BINARY_KEYDICTIONARY_HPP
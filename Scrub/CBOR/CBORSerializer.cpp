@@ -0,0 +1,845 @@
+#include <Scrub/CBOR/CBORSerializer.hpp>
+#include <Scrub/CBORReader.hpp>
+#include <Scrub/Binary/BinarySerializer.hpp>
+#include <Scrub/JSON/JSONSerializer.hpp>
+#include <Scrub/Sink.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+namespace scrub
+{
+    namespace cbor
+    {
+        enum MajorType
+        {
+            Unsigned = 0,
+            Negative = 1,
+            Bytes = 2,
+            Text = 3,
+            Array = 4,
+            Map = 5,
+            Tag = 6,
+            Simple = 7
+        };
+
+        static const UInt8 s_indefinite = 31;
+        static const UInt8 s_break = 0xFF;
+
+        //the initial byte and the argument in the fewest bytes possible
+        template<class W>
+        static void writeHead(W & _out, UInt8 _major, UInt64 _argument)
+        {
+            char bytes[9];
+            if (_argument < 24)
+            {
+                _out.append(static_cast<char>(_major << 5 | _argument));
+                return;
+            }
+
+            Size byteCount = _argument <= 0xFF ? 1 : (_argument <= 0xFFFF ? 2 : (_argument <= 0xFFFFFFFF ? 4 : 8));
+            UInt8 info = byteCount == 1 ? 24 : (byteCount == 2 ? 25 : (byteCount == 4 ? 26 : 27));
+            bytes[0] = static_cast<char>(_major << 5 | info);
+            for (Size i = 0; i < byteCount; ++i)
+                bytes[1 + i] = static_cast<char>(_argument >> (8 * (byteCount - 1 - i)));
+            _out.append(bytes, byteCount + 1);
+        }
+
+        template<class W>
+        static bool writeIntString(W & _out, const String & _value)
+        {
+            const char * str = _value.cString();
+            char * end;
+            errno = 0;
+            if (str[0] == '-')
+            {
+                long long i = std::strtoll(str, &end, 10);
+                if (errno || end != str + _value.length())
+                    return false;
+                if (i < 0)
+                    writeHead(_out, Negative, static_cast<UInt64>(-(i + 1)));
+                else
+                    writeHead(_out, Unsigned, 0);
+                return true;
+            }
+
+            unsigned long long u = std::strtoull(str, &end, 10);
+            if (errno || end != str + _value.length())
+                return false;
+            writeHead(_out, Unsigned, u);
+            return true;
+        }
+
+        //single precision if that loses nothing, double otherwise
+        template<class W>
+        static bool writeDoubleString(W & _out, const String & _value)
+        {
+            char * end;
+            Float64 d = std::strtod(_value.cString(), &end);
+            if (end != _value.cString() + _value.length())
+                return false;
+
+            char bytes[9];
+            Float32 f = static_cast<Float32>(d);
+            if (static_cast<Float64>(f) == d)
+            {
+                UInt32 bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                bytes[0] = static_cast<char>(Simple << 5 | 26);
+                for (Size i = 0; i < 4; ++i)
+                    bytes[1 + i] = static_cast<char>(bits >> (8 * (3 - i)));
+                _out.append(bytes, 5);
+                return true;
+            }
+
+            UInt64 bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            bytes[0] = static_cast<char>(Simple << 5 | 27);
+            for (Size i = 0; i < 8; ++i)
+                bytes[1 + i] = static_cast<char>(bits >> (8 * (7 - i)));
+            _out.append(bytes, 9);
+            return true;
+        }
+
+        //same rules as exportMsgPack
+        template<class W>
+        static void writeScalar(W & _out, const Shrub & _node)
+        {
+            const String & value = _node.valueString();
+            ValueHint hint = _node.valueHint();
+            if (hint == ValueHint::JSONInt && value.length())
+            {
+                if (writeIntString(_out, value) || writeDoubleString(_out, value))
+                    return;
+            }
+            else if (hint == ValueHint::JSONDouble && value.length())
+            {
+                if (writeDoubleString(_out, value))
+                    return;
+            }
+            else if (hint == ValueHint::JSONBool)
+            {
+                bool bTrue = value == "true" || value == "1";
+                if (bTrue || value == "false" || value == "0")
+                {
+                    _out.append(static_cast<char>(bTrue ? 0xF5 : 0xF4));
+                    return;
+                }
+            }
+            else if (hint == ValueHint::None && !value.length())
+            {
+                _out.append(static_cast<char>(0xF6));
+                return;
+            }
+
+            writeHead(_out, hint == ValueHint::Binary ? Bytes : Text, value.length());
+            _out.append(value);
+        }
+
+        struct ExportFrame
+        {
+            const Shrub * next;
+            const Shrub * end;
+            bool bMap;
+        };
+
+        static bool isLittleEndianHost()
+        {
+            UInt16 value = 1;
+            char first;
+            std::memcpy(&first, &value, 1);
+            return first == 1;
+        }
+
+        //the little endian typed array tags (RFC 8746) of the packed element types
+        static UInt64 typedArrayTag(ArrayType _type)
+        {
+            switch (_type)
+            {
+                case ArrayType::Float32:
+                    return 85;
+                case ArrayType::Float64:
+                    return 86;
+                case ArrayType::Int32:
+                    return 78;
+                default:
+                    return 79;
+            }
+        }
+
+        template<class T, class W>
+        static void writeLittleEndian(W & _out, Span<const T> _values)
+        {
+            if (isLittleEndianHost())
+            {
+                _out.append(reinterpret_cast<const char *>(_values.ptr()), _values.byteCount());
+                return;
+            }
+
+            for (const T & value : _values)
+            {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                std::reverse(bytes, bytes + sizeof(T));
+                _out.append(bytes, sizeof(T));
+            }
+        }
+
+        //packed arrays stay packed as typed arrays
+        template<class W>
+        static void writeTypedArray(W & _out, const Shrub & _node)
+        {
+            writeHead(_out, Tag, typedArrayTag(_node.arrayType()));
+            if (_node.arrayType() == ArrayType::Float32)
+            {
+                writeHead(_out, Bytes, _node.typedArray<Float32>().byteCount());
+                writeLittleEndian(_out, _node.typedArray<Float32>());
+            }
+            else if (_node.arrayType() == ArrayType::Float64)
+            {
+                writeHead(_out, Bytes, _node.typedArray<Float64>().byteCount());
+                writeLittleEndian(_out, _node.typedArray<Float64>());
+            }
+            else if (_node.arrayType() == ArrayType::Int32)
+            {
+                writeHead(_out, Bytes, _node.typedArray<Int32>().byteCount());
+                writeLittleEndian(_out, _node.typedArray<Int32>());
+            }
+            else
+            {
+                writeHead(_out, Bytes, _node.typedArray<Int64>().byteCount());
+                writeLittleEndian(_out, _node.typedArray<Int64>());
+            }
+        }
+
+        template<class W>
+        static void writeNode(W & _out, const Shrub & _node, DynamicArray<ExportFrame> & _stack)
+        {
+            if (_node.arrayType() != ArrayType::None)
+            {
+                writeTypedArray(_out, _node);
+                return;
+            }
+
+            json::ContainerKind kind = json::containerKind(_node);
+            if (kind == json::ContainerKind::None)
+            {
+                writeScalar(_out, _node);
+                return;
+            }
+
+            //the sizes are known, so containers always have a definite length
+            bool bMap = kind == json::ContainerKind::Object;
+            writeHead(_out, bMap ? Map : Array, _node.count());
+            if (_node.count())
+                _stack.append({&*_node.begin(), &*_node.begin() + _node.count(), bMap});
+        }
+
+        template<class W>
+        static void writeCBOR(const Shrub & _root, W & _out)
+        {
+            DynamicArray<ExportFrame> stack(const_cast<Allocator &>(_root.allocator()));
+            writeNode(_out, _root, stack);
+            while (stack.count())
+            {
+                ExportFrame & top = stack.last();
+                if (top.next == top.end)
+                {
+                    stack.resize(stack.count() - 1);
+                    continue;
+                }
+
+                const Shrub & node = *top.next++;
+                if (top.bMap)
+                {
+                    writeHead(_out, Text, node.name().length());
+                    _out.append(node.name());
+                }
+                writeNode(_out, node, stack);
+            }
+        }
+
+        Error exportCBOR(const Shrub & _shrub, Sink & _sink, Size _bufferSize)
+        {
+            BufferedSink out(_sink, _bufferSize, const_cast<Allocator &>(_shrub.allocator()));
+            writeCBOR(_shrub, out);
+            return out.flush();
+        }
+
+        TextResult exportCBOR(const Shrub & _shrub)
+        {
+            String ret(const_cast<Allocator &>(_shrub.allocator()));
+            StringWriter out(ret);
+            writeCBOR(_shrub, out);
+            return ret;
+        }
+
+        class ByteReader
+        {
+        public:
+
+            ByteReader(const char * _data, Size _byteCount) :
+                m_it(_data),
+                m_end(_data + _byteCount)
+            {
+
+            }
+
+            bool peekByte(UInt8 & _out) const
+            {
+                if (m_it == m_end)
+                    return false;
+                _out = static_cast<UInt8>(*m_it);
+                return true;
+            }
+
+            bool readByte(UInt8 & _out)
+            {
+                if (!peekByte(_out))
+                    return false;
+                ++m_it;
+                return true;
+            }
+
+            bool readBigEndian(Size _byteCount, UInt64 & _out)
+            {
+                if (_byteCount > remaining())
+                    return false;
+                _out = 0;
+                for (Size i = 0; i < _byteCount; ++i)
+                    _out = (_out << 8) | static_cast<UInt8>(*m_it++);
+                return true;
+            }
+
+            bool readBytes(const char *& _out, UInt64 _byteCount)
+            {
+                if (_byteCount > remaining())
+                    return false;
+                _out = m_it;
+                m_it += _byteCount;
+                return true;
+            }
+
+            Size remaining() const
+            {
+                return m_end - m_it;
+            }
+
+        private:
+
+            const char * m_it;
+            const char * m_end;
+        };
+
+        struct Head
+        {
+            UInt8 major;
+            UInt8 info;
+            //the argument, undefined for indefinite lengths
+            UInt64 argument;
+        };
+
+        static bool readHead(ByteReader & _reader, Head & _out)
+        {
+            UInt8 initial;
+            if (!_reader.readByte(initial))
+                return false;
+            _out.major = initial >> 5;
+            _out.info = initial & 0x1F;
+            _out.argument = _out.info;
+            if (_out.info < 24 || _out.info == s_indefinite)
+                return true;
+            if (_out.info > 27)
+                return false;
+            return _reader.readBigEndian(Size(1) << (_out.info - 24), _out.argument);
+        }
+
+        static Float64 halfToDouble(UInt16 _half)
+        {
+            Int32 exponent = (_half >> 10) & 0x1F;
+            Float64 mantissa = _half & 0x3FF;
+            Float64 ret;
+            if (exponent == 0)
+                ret = std::ldexp(mantissa, -24);
+            else if (exponent == 31)
+                ret = mantissa == 0 ? INFINITY : NAN;
+            else
+                ret = std::ldexp(mantissa + 1024, exponent - 25);
+            return _half & 0x8000 ? -ret : ret;
+        }
+
+        //the text of numbers and non string keys is formatted here
+        struct Scratch
+        {
+            Scratch(Allocator & _alloc) :
+                string(_alloc)
+            {
+
+            }
+
+            char number[32];
+            String string;
+        };
+
+        static StringSpan formatUnsigned(Scratch & _scratch, UInt64 _value)
+        {
+            int length = std::snprintf(_scratch.number, sizeof(_scratch.number), "%llu", static_cast<unsigned long long>(_value));
+            return StringSpan(_scratch.number, length);
+        }
+
+        //-1 - _value, which can be below the range of Int64
+        static StringSpan formatNegative(Scratch & _scratch, UInt64 _value)
+        {
+            int length;
+            if (_value == static_cast<UInt64>(-1))
+                length = std::snprintf(_scratch.number, sizeof(_scratch.number), "-18446744073709551616");
+            else
+                length = std::snprintf(_scratch.number, sizeof(_scratch.number), "-%llu", static_cast<unsigned long long>(_value + 1));
+            return StringSpan(_scratch.number, length);
+        }
+
+        template<class T>
+        static StringSpan formatFloat(Scratch & _scratch, T _value, int _maxPrecision)
+        {
+            return StringSpan(_scratch.number, binary::formatFloat(_value, _maxPrecision, _scratch.number));
+        }
+
+        //the bytes of a text or byte string. Definite ones point into the data, the chunks of
+        //indefinite ones are joined in the scratch string.
+        static bool readString(ByteReader & _reader, const Head & _head, Scratch & _scratch, StringSpan & _out)
+        {
+            const char * data;
+            if (_head.info != s_indefinite)
+            {
+                if (!_reader.readBytes(data, _head.argument))
+                    return false;
+                _out = StringSpan(data, _head.argument);
+                return true;
+            }
+
+            _scratch.string.clear();
+            while (true)
+            {
+                UInt8 next;
+                Head chunk;
+                if (!_reader.peekByte(next))
+                    return false;
+                if (next == s_break)
+                {
+                    _reader.readByte(next);
+                    break;
+                }
+                //chunks are definite strings of the same type
+                if (!readHead(_reader, chunk) || chunk.major != _head.major || chunk.info == s_indefinite ||
+                    !_reader.readBytes(data, chunk.argument))
+                    return false;
+                _scratch.string.append(data, chunk.argument);
+            }
+            _out = StringSpan(_scratch.string.cString(), _scratch.string.length());
+            return true;
+        }
+
+        //RFC 8746 tags 64 to 87 (without the reserved 76) describe the element type of a byte string:
+        //float or integer, signed, little endian and the size as a power of two.
+        static bool isTypedArrayTag(UInt64 _tag)
+        {
+            return _tag >= 64 && _tag <= 87 && _tag != 76;
+        }
+
+        class ShrubBuilder;
+
+        //parseCBOR keeps the typed arrays that a Shrub can hold packed, other handlers get the numbers one by one
+        template<class H>
+        static bool readPackedArray(H &, UInt64, const char *, Size)
+        {
+            return false;
+        }
+
+        static bool readPackedArray(ShrubBuilder & _builder, UInt64 _tag, const char * _data, Size _byteCount);
+
+        template<class H>
+        static bool readTypedArray(ByteReader & _reader, UInt64 _tag, Scratch & _scratch, H & _handler)
+        {
+            Head head;
+            const char * data;
+            if (!readHead(_reader, head) || head.major != Bytes || head.info == s_indefinite || !_reader.readBytes(data, head.argument))
+                return false;
+
+            bool bFloat = _tag & 16;
+            bool bSigned = _tag & 8;
+            bool bLittleEndian = _tag & 4;
+            //128 bit floats (83 and 87) don't fit a double
+            if (bFloat && (_tag & 3) == 3)
+                return false;
+            //uint8 (64) and its clamped variant (68) don't have a byte order
+            Size size = _tag == 68 ? 1 : Size(1) << (bFloat ? (_tag & 3) + 1 : _tag & 3);
+            if (head.argument % size)
+                return false;
+            if (readPackedArray(_handler, _tag, data, head.argument))
+                return true;
+
+            _handler.beginArray();
+            for (const char * it = data; it != data + head.argument; it += size)
+            {
+                UInt64 bits = 0;
+                for (Size i = 0; i < size; ++i)
+                {
+                    UInt8 byte = static_cast<UInt8>(it[bLittleEndian ? size - 1 - i : i]);
+                    bits = (bits << 8) | byte;
+                }
+
+                if (bFloat)
+                {
+                    if (size == 2)
+                    {
+                        _handler.value(formatFloat(_scratch, halfToDouble(static_cast<UInt16>(bits)), 17), ValueHint::JSONDouble);
+                    }
+                    else if (size == 4)
+                    {
+                        Float32 f;
+                        UInt32 bits32 = static_cast<UInt32>(bits);
+                        std::memcpy(&f, &bits32, sizeof(f));
+                        _handler.value(formatFloat(_scratch, f, 9), ValueHint::JSONDouble);
+                    }
+                    else
+                    {
+                        Float64 d;
+                        std::memcpy(&d, &bits, sizeof(d));
+                        _handler.value(formatFloat(_scratch, d, 17), ValueHint::JSONDouble);
+                    }
+                }
+                else if (bSigned && (bits >> (size * 8 - 1)) & 1)
+                {
+                    //sign extend, the magnitude is that of the complement
+                    Size shift = 64 - size * 8;
+                    Int64 value = static_cast<Int64>(bits << shift) >> shift;
+                    _handler.value(formatNegative(_scratch, static_cast<UInt64>(-(value + 1))), ValueHint::JSONInt);
+                }
+                else
+                {
+                    _handler.value(formatUnsigned(_scratch, bits), ValueHint::JSONInt);
+                }
+            }
+            _handler.endContainer();
+            return true;
+        }
+
+        struct DecodeFrame
+        {
+            UInt64 remaining;
+            bool bMap;
+            bool bIndefinite;
+        };
+
+        //reads the next data item. Containers are only begun and pushed on _stack.
+        template<class H>
+        static bool readItem(ByteReader & _reader, Scratch & _scratch, DynamicArray<DecodeFrame> & _stack, H & _handler)
+        {
+            Head head;
+            if (!readHead(_reader, head))
+                return false;
+
+            //tags annotate the item that follows, only typed arrays change how it is read
+            while (head.major == Tag)
+            {
+                if (head.info == s_indefinite)
+                    return false;
+                if (isTypedArrayTag(head.argument))
+                    return readTypedArray(_reader, head.argument, _scratch, _handler);
+                if (!readHead(_reader, head))
+                    return false;
+            }
+
+            StringSpan str;
+            switch (head.major)
+            {
+                case Unsigned:
+                case Negative:
+                    if (head.info == s_indefinite)
+                        return false;
+                    _handler.value(head.major == Unsigned ? formatUnsigned(_scratch, head.argument) : formatNegative(_scratch, head.argument), ValueHint::JSONInt);
+                    return true;
+                case Bytes:
+                case Text:
+                    if (!readString(_reader, head, _scratch, str))
+                        return false;
+                    _handler.value(str, head.major == Bytes ? ValueHint::Binary : ValueHint::JSONString);
+                    return true;
+                case Array:
+                case Map:
+                {
+                    bool bMap = head.major == Map;
+                    bool bIndefinite = head.info == s_indefinite;
+                    //every element takes at least a byte
+                    if (!bIndefinite && head.argument > _reader.remaining() / (bMap ? 2 : 1))
+                        return false;
+                    if (bMap)
+                        _handler.beginMap();
+                    else
+                        _handler.beginArray();
+                    _stack.append({head.argument, bMap, bIndefinite});
+                    return true;
+                }
+                default:
+                    break;
+            }
+
+            switch (head.info)
+            {
+                case 20:
+                case 21:
+                    _handler.value(head.info == 21 ? StringSpan("true", 4) : StringSpan("false", 5), ValueHint::JSONBool);
+                    return true;
+                //null, undefined and the unassigned simple values
+                case 22:
+                case 23:
+                case 24:
+                    _handler.value(StringSpan("", 0), ValueHint::None);
+                    return true;
+                case 25:
+                    _handler.value(formatFloat(_scratch, halfToDouble(static_cast<UInt16>(head.argument)), 17), ValueHint::JSONDouble);
+                    return true;
+                case 26:
+                {
+                    Float32 f;
+                    UInt32 bits = static_cast<UInt32>(head.argument);
+                    std::memcpy(&f, &bits, sizeof(f));
+                    _handler.value(formatFloat(_scratch, f, 9), ValueHint::JSONDouble);
+                    return true;
+                }
+                case 27:
+                {
+                    Float64 d;
+                    std::memcpy(&d, &head.argument, sizeof(d));
+                    _handler.value(formatFloat(_scratch, d, 17), ValueHint::JSONDouble);
+                    return true;
+                }
+                default:
+                    //break outside of an indefinite container
+                    if (head.info < 20)
+                    {
+                        _handler.value(StringSpan("", 0), ValueHint::None);
+                        return true;
+                    }
+                    return false;
+            }
+        }
+
+        //map keys become names, strings are the common case and other scalars use their text
+        class KeyHandler
+        {
+        public:
+
+            KeyHandler() :
+                bValid(false)
+            {
+
+            }
+
+            void beginMap()
+            {
+                bValid = false;
+            }
+
+            void beginArray()
+            {
+                bValid = false;
+            }
+
+            void endContainer()
+            {
+                bValid = false;
+            }
+
+            void key(StringSpan)
+            {
+            }
+
+            void value(StringSpan _value, ValueHint)
+            {
+                name = _value;
+                bValid = true;
+            }
+
+            StringSpan name;
+            bool bValid;
+        };
+
+        static Error cborError(const char * _what)
+        {
+            return Error(ec::ParseFailed, String::concat("Failed to parse CBOR: ", _what), STICK_FILE, STICK_LINE);
+        }
+
+        template<class H>
+        static Error decodeCBOR(const char * _data, Size _byteCount, H & _handler, Allocator & _alloc)
+        {
+            ByteReader reader(_data, _byteCount);
+            Scratch scratch(_alloc);
+            DynamicArray<DecodeFrame> stack(_alloc);
+            DynamicArray<DecodeFrame> keyStack(_alloc);
+            if (!readItem(reader, scratch, stack, _handler))
+                return cborError("invalid data item");
+
+            while (stack.count())
+            {
+                DecodeFrame & top = stack.last();
+                UInt8 next;
+                bool bEnd = top.bIndefinite ? reader.peekByte(next) && next == s_break : !top.remaining;
+                if (bEnd)
+                {
+                    if (top.bIndefinite)
+                        reader.readByte(next);
+                    stack.resize(stack.count() - 1);
+                    _handler.endContainer();
+                    continue;
+                }
+
+                --top.remaining;
+                if (top.bMap)
+                {
+                    KeyHandler keyHandler;
+                    if (!readItem(reader, scratch, keyStack, keyHandler) || !keyHandler.bValid || keyStack.count())
+                        return cborError("invalid map key");
+                    _handler.key(keyHandler.name);
+                }
+                if (!readItem(reader, scratch, stack, _handler))
+                    return cborError("invalid data item");
+            }
+
+            if (reader.remaining())
+                return cborError("unexpected data after the root item");
+            return Error();
+        }
+
+        //builds the Shrub for parseCBOR
+        class ShrubBuilder
+        {
+        public:
+
+            ShrubBuilder(Allocator & _alloc) :
+                root(_alloc),
+                m_stack(_alloc),
+                m_pending(nullptr),
+                m_bStarted(false)
+            {
+
+            }
+
+            void beginMap()
+            {
+                begin(ValueHint::JSONObject);
+            }
+
+            void beginArray()
+            {
+                begin(ValueHint::JSONArray);
+            }
+
+            void endContainer()
+            {
+                m_stack.resize(m_stack.count() - 1);
+            }
+
+            void key(StringSpan _key)
+            {
+                Shrub & child = m_stack.last()->append(Shrub(root.allocator()));
+                child.setName(String(_key.ptr(), _key.count(), root.allocator()));
+                m_pending = &child;
+            }
+
+            void value(StringSpan _value, ValueHint _hint)
+            {
+                Shrub & node = next();
+                node.setValue(String(_value.ptr(), _value.count(), root.allocator()));
+                node.setValueHint(_hint);
+            }
+
+            template<class T>
+            void typedArray(const char * _data, Size _count, bool _bLittleEndian)
+            {
+                DynamicArray<T> values(root.allocator());
+                values.resize(_count);
+                std::memcpy(values.ptr(), _data, _count * sizeof(T));
+                if (_bLittleEndian != isLittleEndianHost())
+                {
+                    for (T & value : values)
+                    {
+                        char * bytes = reinterpret_cast<char *>(&value);
+                        std::reverse(bytes, bytes + sizeof(T));
+                    }
+                }
+                next().setTypedArray(values.ptr(), _count);
+            }
+
+            Shrub root;
+
+        private:
+
+            //only the deepest container grows, so the pointers to its ancestors stay valid
+            Shrub & next()
+            {
+                if (!m_bStarted)
+                {
+                    m_bStarted = true;
+                    return root;
+                }
+                if (m_pending)
+                {
+                    Shrub & ret = *m_pending;
+                    m_pending = nullptr;
+                    return ret;
+                }
+                return m_stack.last()->append(Shrub(root.allocator()));
+            }
+
+            void begin(ValueHint _hint)
+            {
+                Shrub & node = next();
+                node.setValueHint(_hint);
+                m_stack.append(&node);
+            }
+
+            DynamicArray<Shrub *> m_stack;
+            Shrub * m_pending;
+            bool m_bStarted;
+        };
+
+        static bool readPackedArray(ShrubBuilder & _builder, UInt64 _tag, const char * _data, Size _byteCount)
+        {
+            //the signed 32 and 64 bit integers and the 32 and 64 bit floats in either byte order
+            bool bLittleEndian = _tag & 4;
+            switch (_tag & ~UInt64(4))
+            {
+                case 74:
+                    _builder.typedArray<Int32>(_data, _byteCount / 4, bLittleEndian);
+                    return true;
+                case 75:
+                    _builder.typedArray<Int64>(_data, _byteCount / 8, bLittleEndian);
+                    return true;
+                case 81:
+                    _builder.typedArray<Float32>(_data, _byteCount / 4, bLittleEndian);
+                    return true;
+                case 82:
+                    _builder.typedArray<Float64>(_data, _byteCount / 8, bLittleEndian);
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        ShrubResult parseCBOR(const char * _data, Size _byteCount, Allocator & _alloc)
+        {
+            ShrubBuilder builder(_alloc);
+            Error err = decodeCBOR(_data, _byteCount, builder, _alloc);
+            if (err)
+                return err;
+            return std::move(builder.root);
+        }
+
+        Error readCBOR(const char * _data, Size _byteCount, CBORHandler & _handler, Allocator & _alloc)
+        {
+            return decodeCBOR(_data, _byteCount, _handler, _alloc);
+        }
+    }
+}
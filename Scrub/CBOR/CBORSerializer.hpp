@@ -0,0 +1,21 @@
+#ifndef SCRUB_CBOR_CBORSERIALIZER_HPP
+#define SCRUB_CBOR_CBORSERIALIZER_HPP
+
+#include <Scrub/Shrub.hpp>
+
+namespace scrub
+{
+    class CBORHandler;
+
+    namespace cbor
+    {
+        using namespace stick;
+
+        STICK_LOCAL Error exportCBOR(const Shrub & _shrub, Sink & _sink, Size _bufferSize = 64 * 1024);
+        STICK_LOCAL TextResult exportCBOR(const Shrub & _shrub);
+        STICK_LOCAL ShrubResult parseCBOR(const char * _data, Size _byteCount, Allocator & _alloc);
+        STICK_LOCAL Error readCBOR(const char * _data, Size _byteCount, CBORHandler & _handler, Allocator & _alloc);
+    }
+}
+
+#endif //SCRUB_CBOR_CBORSERIALIZER_HPP
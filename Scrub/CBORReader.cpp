@@ -0,0 +1,17 @@
+#include <Scrub/CBORReader.hpp>
+#include <Scrub/CBOR/CBORSerializer.hpp>
+
+namespace scrub
+{
+    using namespace stick;
+
+    CBORHandler::~CBORHandler()
+    {
+
+    }
+
+    Error readCBOR(const char * _data, Size _byteCount, CBORHandler & _handler, Allocator & _alloc)
+    {
+        return cbor::readCBOR(_data, _byteCount, _handler, _alloc);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef SCRUB_CBORREADER_HPP
+#define SCRUB_CBORREADER_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+#include <Stick/Error.hpp>
+
+namespace scrub
+{
+    //receives the items of a CBOR document from readCBOR. Definite length text and byte strings
+    //point straight into the caller's buffer and stay valid as long as it does. Numbers, keys that
+    //aren't strings and indefinite length strings are converted into a scratch buffer that is only
+    //valid for the duration of the call.
+    class STICK_API CBORHandler
+    {
+    public:
+
+        virtual ~CBORHandler();
+
+        virtual void beginMap() = 0;
+
+        virtual void beginArray() = 0;
+
+        virtual void endContainer() = 0;
+
+        //precedes every value in a map.
+        virtual void key(StringSpan _key) = 0;
+
+        //scalars with the hints parseCBOR uses: JSONInt, JSONDouble, JSONBool, JSONString, Binary
+        //for byte strings and None for null and undefined.
+        virtual void value(StringSpan _value, ValueHint _hint) = 0;
+    };
+
+    //walks _data without building a tree. Typed arrays (RFC 8746) are reported as arrays of their
+    //numbers, other tags are skipped.
+    STICK_API stick::Error readCBOR(const char * _data, stick::Size _byteCount, CBORHandler & _handler, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_CBORREADER_HPP
@@ -0,0 +1,409 @@
+#include <Scrub/ColumnTable.hpp>
+#include <Scrub/Binary/BinarySerializer.hpp>
+#include <Scrub/Binary/KeyDictionary.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace scrub
+{
+    using namespace stick;
+
+    namespace detail
+    {
+        static void appendBit(DynamicArray<UInt8> & _bits, Size _index, bool _bSet)
+        {
+            if (_index % 8 == 0)
+                _bits.append(0);
+            if (_bSet)
+                _bits[_index / 8] |= static_cast<UInt8>(1 << (_index % 8));
+        }
+
+        static bool testBit(const DynamicArray<UInt8> & _bits, Size _index)
+        {
+            return (_bits[_index / 8] >> (_index % 8)) & 1;
+        }
+
+        static void appendCharacters(DynamicArray<char> & _characters, const char * _str, Size _length)
+        {
+            Size offset = _characters.count();
+            _characters.resize(offset + _length);
+            if (_length)
+                std::memcpy(_characters.ptr() + offset, _str, _length);
+        }
+
+        static bool isTrue(const String & _value)
+        {
+            return _value == "true" || _value == "1";
+        }
+
+        //the column type _value asks for, Null for nulls and containers. Integers are parsed into _integer.
+        static ColumnType valueType(const Shrub & _value, Int64 & _integer)
+        {
+            if (_value.arrayType() != ArrayType::None || _value.valueHint() == ValueHint::JSONObject ||
+                _value.valueHint() == ValueHint::JSONArray || _value.count())
+                return ColumnType::Null;
+
+            const String & value = _value.valueString();
+            switch (_value.valueHint())
+            {
+                case ValueHint::JSONBool:
+                    return ColumnType::Bool;
+                case ValueHint::JSONInt:
+                {
+                    //integers that don't fit are stored as doubles
+                    char * end;
+                    errno = 0;
+                    _integer = std::strtoll(value.cString(), &end, 10);
+                    if (errno == ERANGE || *end)
+                        return ColumnType::Float64;
+                    return ColumnType::Int64;
+                }
+                case ValueHint::JSONDouble:
+                    return ColumnType::Float64;
+                case ValueHint::Binary:
+                    return ColumnType::Binary;
+                case ValueHint::None:
+                    return value.length() ? ColumnType::String : ColumnType::Null;
+                default:
+                    return ColumnType::String;
+            }
+        }
+
+        //the type of a column that holds both _a and _b
+        static ColumnType mergedType(ColumnType _a, ColumnType _b)
+        {
+            if (_a == _b || _b == ColumnType::Null)
+                return _a;
+            if (_a == ColumnType::Null)
+                return _b;
+            if ((_a == ColumnType::Int64 && _b == ColumnType::Float64) || (_a == ColumnType::Float64 && _b == ColumnType::Int64))
+                return ColumnType::Float64;
+            if (_a == ColumnType::Binary || _b == ColumnType::Binary)
+                return ColumnType::Binary;
+            return ColumnType::String;
+        }
+
+        struct ColumnBuilder
+        {
+            //packed arrays only have unnamed elements, begin() would unpack them
+            static bool isRecord(const Shrub & _element)
+            {
+                return _element.valueHint() == ValueHint::JSONObject ||
+                       (_element.arrayType() == ArrayType::None && _element.count() && (*_element.begin()).name().length());
+            }
+
+            static ColumnTableResult extract(const Shrub & _array, Allocator & _alloc)
+            {
+                if (isRecord(_array))
+                    return Error(ec::InvalidArgument, String::concat("Can't extract columns from object ", _array.name(), ", expected an array of objects"), STICK_FILE, STICK_LINE);
+
+                ColumnTable table(_alloc);
+                //packed numbers don't contain objects, no need to unpack them
+                if (_array.arrayType() != ArrayType::None)
+                {
+                    table.m_rowCount = _array.count();
+                    return table;
+                }
+
+                KeyDictionary keys(_alloc);
+                //the column of the key at every position of the previous object
+                DynamicArray<UInt32> order(_alloc);
+                Size row = 0;
+                for (const Shrub & element : _array)
+                {
+                    if (isRecord(element))
+                    {
+                        Size position = 0;
+                        for (const Shrub & child : element)
+                        {
+                            //homogeneous objects have their keys in the same order, which saves the lookup
+                            UInt32 index;
+                            if (position < order.count() && table.m_columns[order[position]].m_name == child.name())
+                            {
+                                index = order[position];
+                            }
+                            else
+                            {
+                                index = keys.add(child.name());
+                                if (index == table.m_columns.count())
+                                {
+                                    table.m_columns.append(Column(child.name(), _alloc));
+                                    for (Size i = 0; i < row; ++i)
+                                        table.m_columns.last().appendNull();
+                                }
+                                if (position < order.count())
+                                    order[position] = index;
+                                else
+                                    order.append(index);
+                            }
+                            ++position;
+
+                            //the first of duplicate keys wins
+                            Column & column = table.m_columns[index];
+                            if (column.m_count == row)
+                                column.append(child);
+                        }
+                    }
+
+                    for (Column & column : table.m_columns)
+                    {
+                        if (column.m_count == row)
+                            column.appendNull();
+                    }
+                    ++row;
+                }
+                table.m_rowCount = row;
+                return table;
+            }
+        };
+    }
+
+    Column::Column(const String & _name, Allocator & _alloc) :
+        m_name(_name.cString(), _name.length(), _alloc),
+        m_type(ColumnType::Null),
+        m_count(0),
+        m_nullCount(0),
+        m_validity(_alloc),
+        m_ints(_alloc),
+        m_floats(_alloc),
+        m_bools(_alloc),
+        m_offsets(_alloc),
+        m_characters(_alloc)
+    {
+
+    }
+
+    const String & Column::name() const
+    {
+        return m_name;
+    }
+
+    ColumnType Column::type() const
+    {
+        return m_type;
+    }
+
+    Size Column::count() const
+    {
+        return m_count;
+    }
+
+    Size Column::nullCount() const
+    {
+        return m_nullCount;
+    }
+
+    bool Column::isNull(Size _row) const
+    {
+        STICK_ASSERT(_row < m_count);
+        return !detail::testBit(m_validity, _row);
+    }
+
+    Span<const UInt8> Column::validity() const
+    {
+        return Span<const UInt8>(m_validity.ptr(), m_validity.count());
+    }
+
+    Span<const Int64> Column::int64Values() const
+    {
+        return Span<const Int64>(m_ints.ptr(), m_ints.count());
+    }
+
+    Span<const Float64> Column::float64Values() const
+    {
+        return Span<const Float64>(m_floats.ptr(), m_floats.count());
+    }
+
+    Span<const UInt8> Column::boolBits() const
+    {
+        return Span<const UInt8>(m_bools.ptr(), m_bools.count());
+    }
+
+    bool Column::boolValue(Size _row) const
+    {
+        STICK_ASSERT(_row < m_count);
+        return m_type == ColumnType::Bool && detail::testBit(m_bools, _row);
+    }
+
+    StringSpan Column::stringValue(Size _row) const
+    {
+        STICK_ASSERT(_row < m_count);
+        if (m_type != ColumnType::String && m_type != ColumnType::Binary)
+            return StringSpan();
+        return StringSpan(m_characters.ptr() + m_offsets[_row], m_offsets[_row + 1] - m_offsets[_row]);
+    }
+
+    Span<const Int64> Column::offsets() const
+    {
+        return Span<const Int64>(m_offsets.ptr(), m_offsets.count());
+    }
+
+    StringSpan Column::characters() const
+    {
+        return StringSpan(m_characters.ptr(), m_characters.count());
+    }
+
+    void Column::appendNull()
+    {
+        detail::appendBit(m_validity, m_count, false);
+        switch (m_type)
+        {
+            case ColumnType::Bool:
+                detail::appendBit(m_bools, m_count, false);
+                break;
+            case ColumnType::Int64:
+                m_ints.append(0);
+                break;
+            case ColumnType::Float64:
+                m_floats.append(0.0);
+                break;
+            case ColumnType::String:
+            case ColumnType::Binary:
+                m_offsets.append(m_characters.count());
+                break;
+            default:
+                break;
+        }
+        ++m_nullCount;
+        ++m_count;
+    }
+
+    void Column::append(const Shrub & _value)
+    {
+        Int64 integer;
+        ColumnType type = detail::valueType(_value, integer);
+        if (type == ColumnType::Null)
+        {
+            appendNull();
+            return;
+        }
+
+        ColumnType merged = detail::mergedType(m_type, type);
+        if (merged != m_type)
+            convert(merged);
+
+        const String & value = _value.valueString();
+        detail::appendBit(m_validity, m_count, true);
+        switch (m_type)
+        {
+            case ColumnType::Bool:
+                detail::appendBit(m_bools, m_count, detail::isTrue(value));
+                break;
+            case ColumnType::Int64:
+                m_ints.append(integer);
+                break;
+            case ColumnType::Float64:
+                m_floats.append(type == ColumnType::Int64 ? static_cast<Float64>(integer) : std::strtod(value.cString(), nullptr));
+                break;
+            default:
+                detail::appendCharacters(m_characters, value.cString(), value.length());
+                m_offsets.append(m_characters.count());
+                break;
+        }
+        ++m_count;
+    }
+
+    void Column::convert(ColumnType _type)
+    {
+        Allocator & alloc = m_validity.allocator();
+        if (_type == ColumnType::Float64 && m_type == ColumnType::Int64)
+        {
+            m_floats.reserve(m_count);
+            for (Int64 value : m_ints)
+                m_floats.append(static_cast<Float64>(value));
+            m_ints = DynamicArray<Int64>(alloc);
+        }
+        else if (_type == ColumnType::String || _type == ColumnType::Binary)
+        {
+            if (m_type != ColumnType::String && m_type != ColumnType::Binary)
+            {
+                //the rows so far as text, the way exportJSON writes their values
+                m_offsets.reserve(m_count + 1);
+                m_offsets.append(0);
+                for (Size i = 0; i < m_count; ++i)
+                {
+                    char buffer[32];
+                    Size length = 0;
+                    if (m_type == ColumnType::Bool && detail::testBit(m_validity, i))
+                        length = std::snprintf(buffer, sizeof(buffer), "%s", detail::testBit(m_bools, i) ? "true" : "false");
+                    else if (m_type == ColumnType::Int64 && detail::testBit(m_validity, i))
+                        length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(m_ints[i]));
+                    else if (m_type == ColumnType::Float64 && detail::testBit(m_validity, i))
+                        length = binary::formatFloat(m_floats[i], 17, buffer);
+                    detail::appendCharacters(m_characters, buffer, length);
+                    m_offsets.append(m_characters.count());
+                }
+                m_bools = DynamicArray<UInt8>(alloc);
+                m_ints = DynamicArray<Int64>(alloc);
+                m_floats = DynamicArray<Float64>(alloc);
+            }
+        }
+        else
+        {
+            //only a Null column becomes one of the other types, all its rows are null
+            STICK_ASSERT(m_type == ColumnType::Null);
+            if (_type == ColumnType::Bool)
+                m_bools.resize((m_count + 7) / 8, 0);
+            else if (_type == ColumnType::Int64)
+                m_ints.resize(m_count, 0);
+            else
+                m_floats.resize(m_count, 0.0);
+        }
+        m_type = _type;
+    }
+
+    ColumnTable::ColumnTable(Allocator & _alloc) :
+        m_columns(_alloc),
+        m_rowCount(0)
+    {
+
+    }
+
+    Size ColumnTable::rowCount() const
+    {
+        return m_rowCount;
+    }
+
+    Size ColumnTable::columnCount() const
+    {
+        return m_columns.count();
+    }
+
+    const Column & ColumnTable::column(Size _index) const
+    {
+        return m_columns[_index];
+    }
+
+    const Column * ColumnTable::findColumn(const String & _name) const
+    {
+        for (const Column & column : m_columns)
+        {
+            if (column.name() == _name)
+                return &column;
+        }
+        return nullptr;
+    }
+
+    ColumnTable::ColumnIter ColumnTable::begin() const
+    {
+        return m_columns.begin();
+    }
+
+    ColumnTable::ColumnIter ColumnTable::end() const
+    {
+        return m_columns.end();
+    }
+
+    Allocator & ColumnTable::allocator() const
+    {
+        return m_columns.allocator();
+    }
+
+    ColumnTableResult extractColumns(const Shrub & _array, Allocator & _alloc)
+    {
+        return detail::ColumnBuilder::extract(_array, _alloc);
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef SCRUB_COLUMNTABLE_HPP
+#define SCRUB_COLUMNTABLE_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+
+namespace scrub
+{
+    namespace detail
+    {
+        //fills the columns of a table, see extractColumns
+        struct ColumnBuilder;
+    }
+
+    //value types of the columns extracted by extractColumns
+    STICK_API_ENUM_CLASS(ColumnType)
+    {
+        //no row has a value
+        Null,
+        Bool,
+        Int64,
+        Float64,
+        String,
+        //Binary values, or strings mixed with them
+        Binary
+    };
+
+    //the values of one key across the rows of a ColumnTable, stored contiguously in the layout of
+    //Apache Arrow: bitmaps hold a bit per row, least significant bit first, and strings are the
+    //concatenated characters with the offset of every row.
+    class STICK_API Column
+    {
+    public:
+
+        Column(const stick::String & _name, stick::Allocator & _alloc = stick::defaultAllocator());
+
+        const stick::String & name() const;
+
+        ColumnType type() const;
+
+        stick::Size count() const;
+
+        stick::Size nullCount() const;
+
+        bool isNull(stick::Size _row) const;
+
+        //the bit of every row is set if it has a value.
+        Span<const stick::UInt8> validity() const;
+
+        //the values, empty unless the column has the type. Rows without a value hold 0.
+        Span<const stick::Int64> int64Values() const;
+
+        Span<const stick::Float64> float64Values() const;
+
+        //the bit of every row is set if it is true, empty unless the column is Bool.
+        Span<const stick::UInt8> boolBits() const;
+
+        bool boolValue(stick::Size _row) const;
+
+        //the value of a String or Binary row, empty for the other types.
+        StringSpan stringValue(stick::Size _row) const;
+
+        //count() + 1 offsets into characters(), row i is [offsets[i], offsets[i + 1]).
+        Span<const stick::Int64> offsets() const;
+
+        StringSpan characters() const;
+
+    private:
+
+        friend struct detail::ColumnBuilder;
+
+
+        void appendNull();
+
+        void append(const Shrub & _value);
+
+        //switches to _type, converting the rows so far
+        void convert(ColumnType _type);
+
+
+        stick::String m_name;
+        ColumnType m_type;
+        stick::Size m_count;
+        stick::Size m_nullCount;
+        stick::DynamicArray<stick::UInt8> m_validity;
+        stick::DynamicArray<stick::Int64> m_ints;
+        stick::DynamicArray<stick::Float64> m_floats;
+        stick::DynamicArray<stick::UInt8> m_bools;
+        stick::DynamicArray<stick::Int64> m_offsets;
+        stick::DynamicArray<char> m_characters;
+    };
+
+    //a struct of arrays view of an array of objects with a column per key, see extractColumns.
+    class STICK_API ColumnTable
+    {
+    public:
+
+        typedef stick::DynamicArray<Column>::ConstIter ColumnIter;
+
+
+        ColumnTable(stick::Allocator & _alloc = stick::defaultAllocator());
+
+        stick::Size rowCount() const;
+
+        stick::Size columnCount() const;
+
+        //columns are ordered by the first row that has their key.
+        const Column & column(stick::Size _index) const;
+
+        //the column of _name, nullptr if no row has it.
+        const Column * findColumn(const stick::String & _name) const;
+
+        ColumnIter begin() const;
+
+        ColumnIter end() const;
+
+        stick::Allocator & allocator() const;
+
+    private:
+
+        friend struct detail::ColumnBuilder;
+
+
+        stick::DynamicArray<Column> m_columns;
+        stick::Size m_rowCount;
+    };
+
+    typedef stick::Result<ColumnTable> ColumnTableResult;
+
+    //Converts the objects in _array into columns in one pass over their children. A key missing
+    //from an object, null values, nested objects and arrays, and elements that aren't objects are
+    //null rows. A column of integers that meets a double becomes Float64, mixing other types turns
+    //it into a String column with the values as exportJSON writes them.
+    STICK_API ColumnTableResult extractColumns(const Shrub & _array, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_COLUMNTABLE_HPP
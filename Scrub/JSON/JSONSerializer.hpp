@@ -9,8 +9,28 @@ namespace scrub
     {
         using namespace stick;
 
-        STICK_LOCAL ShrubResult parseJSON(const String & _json, Allocator & _alloc);
+        enum class ContainerKind
+        {
+            None,
+            Array,
+            Object
+        };
+
+        //decided once per node. The hints of parsed trees answer it right away, other containers
+        //are objects as soon as one of their children has a name. Shared with the other formats
+        //that distinguish maps from arrays.
+        STICK_LOCAL ContainerKind containerKind(const Shrub & _node);
+
+        STICK_LOCAL ShrubResult parseJSON(const String & _json, const JSONParseOptions & _options, Allocator & _alloc);
+        STICK_LOCAL ShrubResult parseJSONLazy(String && _json, Allocator & _alloc);
+        STICK_LOCAL Error exportJSON(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _bufferSize = 64 * 1024);
         STICK_LOCAL TextResult exportJSON(const Shrub & _shrub, bool _bPrettify);
+        STICK_LOCAL Size exportJSONInto(const Shrub & _shrub, char * _buffer, Size _capacity, bool _bPrettify);
+        STICK_LOCAL Size measureJSON(const Shrub & _shrub, bool _bPrettify);
+        STICK_LOCAL TextResult exportJSONCanonical(const Shrub & _shrub);
+        STICK_LOCAL Error exportJSONCanonical(const Shrub & _shrub, Sink & _sink);
+        STICK_LOCAL TextResult exportJSONParallel(const Shrub & _shrub, bool _bPrettify, Size _threadCount);
+        STICK_LOCAL Error exportJSONParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _threadCount);
     }
 }
 
@@ -29,6 +29,7 @@
 #include <stddef.h>
 #include <string.h>
 #include <math.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <ostream>
 #include <algorithm>
@@ -204,10 +205,12 @@ namespace sajson {
         mutable_string_view()
             : length(0)
             , data(0)
+            , owns(true)
         {}
 
         mutable_string_view(const literal& s)
             : length(s.length())
+            , owns(true)
         {
             data = new char[length];
             memcpy(data, s.data(), length);
@@ -215,13 +218,21 @@ namespace sajson {
 
         mutable_string_view(const string& s)
             : length(s.length())
+            , owns(true)
         {
             data = new char[length];
             memcpy(data, s.data(), length);
         }
 
+        // Scrub: parses in place in a buffer the caller owns and frees
+        mutable_string_view(size_t length, char* data)
+            : length(length)
+            , data(data)
+            , owns(false)
+        {}
+
         ~mutable_string_view() {
-            if (uses.count() == 1) {
+            if (owns && uses.count() == 1) {
                 delete[] data;
             }
         }
@@ -238,6 +249,7 @@ namespace sajson {
         refcount uses;
         size_t length;
         char* data;
+        bool owns;
     };
 
     union integer_storage {
@@ -296,6 +308,11 @@ namespace sajson {
             return value_type;
         }
 
+        // Scrub: exposes the structure slot so that views can be kept without holding a value
+        const size_t* get_payload() const {
+            return payload;
+        }
+
         // valid iff get_type() is TYPE_ARRAY or TYPE_OBJECT
         size_t get_length() const {
             assert_type_2(TYPE_ARRAY, TYPE_OBJECT);
@@ -366,6 +383,13 @@ namespace sajson {
             return payload[1] - payload[0];
         }
 
+        // Scrub: the characters without a copy, get_string_length() of them as they may contain zeros
+        // valid iff get_type() is TYPE_STRING
+        const char* as_cstring() const {
+            assert_type(TYPE_STRING);
+            return text + payload[0];
+        }
+
         // valid iff get_type() is TYPE_STRING
         std::string as_string() const {
             assert_type(TYPE_STRING);
@@ -389,9 +413,10 @@ namespace sajson {
 
     class document {
     public:
-        explicit document(mutable_string_view& input, const size_t* structure, type root_type, const size_t* root, size_t error_line, size_t error_column, const std::string& error_message)
+        explicit document(mutable_string_view& input, const size_t* structure, type root_type, const size_t* root, size_t error_line, size_t error_column, const std::string& error_message, bool owns_structure = true)
             : input(input)
             , structure(structure)
+            , owns_structure(owns_structure)
             , root_type(root_type)
             , root(root)
             , error_line(error_line)
@@ -405,6 +430,7 @@ namespace sajson {
         document(document&& rhs)
             : input(rhs.input)
             , structure(rhs.structure)
+            , owns_structure(rhs.owns_structure)
             , root_type(rhs.root_type)
             , root(rhs.root)
             , error_line(rhs.error_line)
@@ -416,7 +442,9 @@ namespace sajson {
         }
 
         ~document() {
-            delete[] structure;
+            if (owns_structure) {
+                delete[] structure;
+            }
         }
 
         bool is_valid() const {
@@ -442,6 +470,8 @@ namespace sajson {
     private:
         mutable_string_view input;
         const size_t* structure;
+        // Scrub: false if the caller allocated the structure and frees it
+        bool owns_structure;
         const type root_type;
         const size_t* const root;
         const size_t error_line;
@@ -451,10 +481,13 @@ namespace sajson {
 
     class parser {
     public:
-        parser(const mutable_string_view& msv, size_t* structure)
+        // Scrub: structure needs room for input.get_length() entries, it is freed with delete[] if
+        // owns_structure is set
+        parser(const mutable_string_view& msv, size_t* structure, bool owns_structure = true)
             : input(msv)
             , input_end(input.get_data() + input.get_length())
             , structure(structure)
+            , owns_structure(owns_structure)
             , p(input.get_data())
             , temp(structure)
             , root_type(TYPE_NULL)
@@ -465,9 +498,11 @@ namespace sajson {
 
         document get_document() {
             if (parse()) {
-                return document(input, structure, root_type, out, 0, 0, std::string());
+                return document(input, structure, root_type, out, 0, 0, std::string(), owns_structure);
             } else {
-                delete[] structure;
+                if (owns_structure) {
+                    delete[] structure;
+                }
                 return document(input, 0, TYPE_NULL, 0, error_line, error_column, error_message);
             }
         }
@@ -582,11 +617,14 @@ namespace sajson {
                 char closing_bracket = (current_structure_type == TYPE_OBJECT ? '}' : ']');
 
                 c = peek_structure();
+                // Scrub: a comma or a key must be followed by a value, not by a closing bracket
+                bool value_required = false;
                 if (temp > current_base + 1) {
                     if (c != closing_bracket) {
                         if (c == ',') {
                             ++p;
                             c = peek_structure();
+                            value_required = true;
                         } else {
                             return error("expected ,");
                         }
@@ -606,6 +644,7 @@ namespace sajson {
                     }
                     ++p;
                     temp += 2;
+                    value_required = true;
                 }
 
                 switch (peek_structure()) {
@@ -656,14 +695,18 @@ namespace sajson {
                     }
 
                     case ']':
-                        if (current_structure_type == TYPE_ARRAY) {
+                        if (value_required) {
+                            return error("expected value");
+                        } else if (current_structure_type == TYPE_ARRAY) {
                             structure_installer = &parser::install_array;
                             goto pop;
                         } else {
                             return error("expected }");
                         }
                     case '}':
-                        if (current_structure_type == TYPE_OBJECT) {
+                        if (value_required) {
+                            return error("expected value");
+                        } else if (current_structure_type == TYPE_OBJECT) {
                             structure_installer = &parser::install_object;
                             goto pop;
                         } else {
@@ -816,6 +859,7 @@ namespace sajson {
         }
 
         parse_result parse_number() {
+            char* start = p;
             bool negative = false;
             if ('-' == *p) {
                 ++p;
@@ -826,6 +870,11 @@ namespace sajson {
                 }
             }
 
+            // Scrub: the integer part, the fraction and the exponent each need at least one digit
+            if (*p < '0' || *p > '9') {
+                return error("expected digit");
+            }
+
             bool try_double = false;
 
             int i = 0;
@@ -866,6 +915,9 @@ namespace sajson {
                 if (at_eof()) {
                     return error("unexpected end of input");
                 }
+                if (*p < '0' || *p > '9') {
+                    return error("expected digit");
+                }
                 for (;;) {
                     char c = *p;
                     if (c < '0' || c > '9') {
@@ -906,6 +958,9 @@ namespace sajson {
                     }
                 }
 
+                if (*p < '0' || *p > '9') {
+                    return error("expected digit");
+                }
                 int exp = 0;
                 for (;;) {
                     char c = *p;
@@ -918,14 +973,29 @@ namespace sajson {
                         return error("unexpected end of input");
                     }
 
-                    exp = 10 * exp + (c - '0');
+                    // Scrub: saturates instead of overflowing, such exponents are read with strtod
+                    if (exp < 100000) {
+                        exp = 10 * exp + (c - '0');
+                    }
                 }
                 exponent += (negativeExponent ? -exp : exp);
             }
 
-            if (exponent) {
+            // Scrub: scaling by a power of ten is only exact if both the digits and the power are
+            // exact doubles, which they are for up to 15 digits and 22 decimals (Clinger's fast
+            // path). Other doubles are read again with strtod. The token is followed by a
+            // delimiter, so strtod stops at p.
+            if (try_double && (d >= 9007199254740992.0 || exponent < -22 || exponent > 22)) {
+                char* end;
+                double exact = strtod(negative ? start + 1 : start, &end);
+                if (end == p) {
+                    d = exact;
+                } else {
+                    d *= pow10(exponent);
+                }
+            } else if (exponent) {
                 assert(try_double);
-                d *= pow10(exponent);
+                d = exponent < 0 ? d / pow10(-exponent) : d * pow10(exponent);
             }
 
             if (negative) {
@@ -1124,6 +1194,9 @@ namespace sajson {
                                         return error("invalid UTF-16 trail surrogate");
                                     }
                                     u = 0x10000 + (((u - 0xD800) << 10) | (v - 0xDC00));
+                                } else if (u >= 0xDC00 && u <= 0xDFFF) {
+                                    // Scrub: has no UTF-8 encoding without its lead surrogate
+                                    return error("unpaired UTF-16 trail surrogate");
                                 }
                                 write_utf8(u, end);
                                 break;
@@ -1143,6 +1216,7 @@ namespace sajson {
         mutable_string_view input;
         char* const input_end;
         size_t* const structure;
+        const bool owns_structure;
 
         char* p;
         size_t* temp;
@@ -0,0 +1,385 @@
+#include <Scrub/MappedView.hpp>
+#include <Scrub/Binary/BinarySerializer.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new> //for placement new
+
+namespace scrub
+{
+    using namespace stick;
+
+    namespace detail
+    {
+        struct MappedViewDocument
+        {
+            MappedViewDocument(Allocator & _alloc) :
+                data(nullptr),
+                byteCount(0),
+                copy(nullptr),
+                bMapped(false),
+                referenceCount(0),
+                allocator(&_alloc)
+            {
+
+            }
+
+            const char * data;
+            Size byteCount;
+            //the allocation holding the data, if the document owns a copy of it
+            void * copy;
+            bool bMapped;
+            std::atomic<Size> referenceCount;
+            Allocator * allocator;
+        };
+
+        static void destroy(MappedViewDocument * _doc)
+        {
+            Allocator * alloc = _doc->allocator;
+            if (_doc->bMapped)
+                munmap(const_cast<char *>(_doc->data), _doc->byteCount);
+            if (_doc->copy)
+                alloc->deallocate({_doc->copy, _doc->byteCount});
+            _doc->~MappedViewDocument();
+            alloc->deallocate({_doc, sizeof(MappedViewDocument)});
+        }
+
+        static void retain(MappedViewDocument * _doc)
+        {
+            if (_doc)
+                ++_doc->referenceCount;
+        }
+
+        static void release(MappedViewDocument * _doc)
+        {
+            if (_doc && --_doc->referenceCount == 0)
+                destroy(_doc);
+        }
+    }
+
+    static const detail::MappedNode * nodeAt(const detail::MappedViewDocument * _doc, UInt64 _offset)
+    {
+        if (_offset % alignof(detail::MappedNode) || _offset > _doc->byteCount || _doc->byteCount - _offset < sizeof(detail::MappedNode))
+            return nullptr;
+        return reinterpret_cast<const detail::MappedNode *>(_doc->data + _offset);
+    }
+
+    //the null terminated string at _offset, nullptr if it doesn't fit into the data
+    static const char * stringAt(const detail::MappedViewDocument * _doc, UInt64 _offset, Size & _outLength)
+    {
+        UInt32 length;
+        if (_offset > _doc->byteCount || _doc->byteCount - _offset < sizeof(UInt32))
+            return nullptr;
+        std::memcpy(&length, _doc->data + _offset, sizeof(UInt32));
+        const char * ret = _doc->data + _offset + sizeof(UInt32);
+        if (_doc->byteCount - _offset - sizeof(UInt32) <= length || ret[length] != '\0')
+            return nullptr;
+        _outLength = length;
+        return ret;
+    }
+
+    static const detail::MappedNode * childAt(const detail::MappedViewDocument * _doc, const detail::MappedNode * _parent, Size _index)
+    {
+        if (_index >= _parent->childCount || _parent->children > _doc->byteCount)
+            return nullptr;
+        return nodeAt(_doc, _parent->children + _index * sizeof(detail::MappedNode));
+    }
+
+    //the child at _index in name order
+    static const detail::MappedNode * sortedChildAt(const detail::MappedViewDocument * _doc, const detail::MappedNode * _parent, Size _index)
+    {
+        UInt32 index;
+        UInt64 offset = _parent->sortedChildren;
+        if (offset > _doc->byteCount || (_doc->byteCount - offset) / sizeof(UInt32) <= _index)
+            return nullptr;
+        std::memcpy(&index, _doc->data + offset + _index * sizeof(UInt32), sizeof(UInt32));
+        return childAt(_doc, _parent, index);
+    }
+
+    //binary search of the sorted child table for the first child called _name
+    static const detail::MappedNode * findChild(const detail::MappedViewDocument * _doc, const detail::MappedNode * _parent, const char * _name, Size _length)
+    {
+        const detail::MappedNode * ret = nullptr;
+        Size lo = 0;
+        Size hi = _parent->childCount;
+        while (lo < hi)
+        {
+            Size mid = lo + (hi - lo) / 2;
+            const detail::MappedNode * node = sortedChildAt(_doc, _parent, mid);
+            Size nameLength;
+            const char * name = node ? stringAt(_doc, node->name, nameLength) : nullptr;
+            if (!name)
+                return nullptr;
+
+            int cmp = binary::compareNames(name, nameLength, _name, _length);
+            if (cmp < 0)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                if (cmp == 0)
+                    ret = node;
+                hi = mid;
+            }
+        }
+        return ret;
+    }
+
+    MappedView::ChildIter::ChildIter(const MappedView & _parent, Size _index) :
+        m_parent(_parent),
+        m_index(_index)
+    {
+
+    }
+
+    MappedView MappedView::ChildIter::operator * () const
+    {
+        return m_parent[m_index];
+    }
+
+    MappedView::ChildIter & MappedView::ChildIter::operator ++ ()
+    {
+        ++m_index;
+        return *this;
+    }
+
+    bool MappedView::ChildIter::operator == (const ChildIter & _other) const
+    {
+        return m_index == _other.m_index;
+    }
+
+    bool MappedView::ChildIter::operator != (const ChildIter & _other) const
+    {
+        return !(*this == _other);
+    }
+
+    MappedView::MappedView() :
+        m_document(nullptr),
+        m_node(nullptr)
+    {
+
+    }
+
+    MappedView::MappedView(detail::MappedViewDocument * _document, const detail::MappedNode * _node) :
+        m_document(_document),
+        m_node(_node)
+    {
+        detail::retain(m_document);
+    }
+
+    MappedView::MappedView(const MappedView & _other) :
+        m_document(_other.m_document),
+        m_node(_other.m_node)
+    {
+        detail::retain(m_document);
+    }
+
+    MappedView::MappedView(MappedView && _other) :
+        m_document(_other.m_document),
+        m_node(_other.m_node)
+    {
+        _other.m_document = nullptr;
+        _other.m_node = nullptr;
+    }
+
+    MappedView::~MappedView()
+    {
+        detail::release(m_document);
+    }
+
+    MappedView & MappedView::operator = (const MappedView & _other)
+    {
+        detail::retain(_other.m_document);
+        detail::release(m_document);
+        m_document = _other.m_document;
+        m_node = _other.m_node;
+        return *this;
+    }
+
+    MappedView & MappedView::operator = (MappedView && _other)
+    {
+        if (this != &_other)
+        {
+            detail::release(m_document);
+            m_document = _other.m_document;
+            m_node = _other.m_node;
+            _other.m_document = nullptr;
+            _other.m_node = nullptr;
+        }
+        return *this;
+    }
+
+    Maybe<MappedView> MappedView::child(const String & _path, char _separator) const
+    {
+        if (!m_node)
+            return Maybe<MappedView>();
+
+        const detail::MappedNode * current = m_node;
+        const char * segment = _path.cString();
+        const char * pathEnd = segment + _path.length();
+        while (true)
+        {
+            const char * segmentEnd = segment;
+            while (segmentEnd != pathEnd && *segmentEnd != _separator) ++segmentEnd;
+
+            current = findChild(m_document, current, segment, segmentEnd - segment);
+            if (!current)
+                return Maybe<MappedView>();
+            if (segmentEnd == pathEnd)
+                return MappedView(m_document, current);
+            segment = segmentEnd + 1;
+        }
+    }
+
+    const char * MappedView::name() const
+    {
+        Size length;
+        const char * ret = m_node ? stringAt(m_document, m_node->name, length) : nullptr;
+        return ret ? ret : "";
+    }
+
+    const char * MappedView::valueCString() const
+    {
+        Size length;
+        const char * ret = m_node ? stringAt(m_document, m_node->value, length) : nullptr;
+        return ret ? ret : "";
+    }
+
+    StringSpan MappedView::valueString() const
+    {
+        Size length;
+        const char * ret = m_node ? stringAt(m_document, m_node->value, length) : nullptr;
+        if (!ret)
+            return StringSpan("", 0);
+        return StringSpan(ret, length);
+    }
+
+    ValueHint MappedView::valueHint() const
+    {
+        UInt8 hint = m_node ? m_node->flags & binary::s_hintMask : 0;
+        if (hint > static_cast<UInt8>(ValueHint::Binary))
+            return ValueHint::None;
+        return static_cast<ValueHint>(hint);
+    }
+
+    bool MappedView::isValid() const
+    {
+        return m_node != nullptr;
+    }
+
+    MappedView::ChildIter MappedView::begin() const
+    {
+        return ChildIter(*this, 0);
+    }
+
+    MappedView::ChildIter MappedView::end() const
+    {
+        return ChildIter(*this, count());
+    }
+
+    Size MappedView::count() const
+    {
+        return m_node ? m_node->childCount : 0;
+    }
+
+    MappedView MappedView::operator [] (Size _index) const
+    {
+        const detail::MappedNode * node = m_node ? childAt(m_document, m_node, _index) : nullptr;
+        if (!node)
+            return MappedView();
+        return MappedView(m_document, node);
+    }
+
+    static Error mappedError(const char * _what)
+    {
+        return Error(ec::ParseFailed, String::concat("Failed to open mapped Shrub: ", _what), STICK_FILE, STICK_LINE);
+    }
+
+    static MappedViewResult createView(const char * _data, Size _byteCount, void * _copy, bool _bMapped, Allocator & _alloc)
+    {
+        auto block = _alloc.allocate(sizeof(detail::MappedViewDocument), alignof(detail::MappedViewDocument));
+        detail::MappedViewDocument * doc = new (block.ptr) detail::MappedViewDocument(_alloc);
+        doc->data = _data;
+        doc->byteCount = _byteCount;
+        doc->copy = _copy;
+        doc->bMapped = _bMapped;
+
+        //only the header is checked up front, the rest as it is accessed
+        detail::MappedHeader header;
+        const char * err = nullptr;
+        if (_byteCount < sizeof(header))
+        {
+            err = "not a mapped Shrub";
+        }
+        else
+        {
+            std::memcpy(&header, _data, sizeof(header));
+            if (std::memcmp(header.magic, binary::s_mappedMagic, 4) != 0)
+                err = "not a mapped Shrub";
+            else if (header.version != binary::s_mappedVersion)
+                err = "unsupported version or byte order";
+            else if (header.byteCount != _byteCount)
+                err = "truncated data";
+            else if (reinterpret_cast<std::uintptr_t>(_data) % alignof(detail::MappedNode))
+                err = "the data is not 8 byte aligned";
+            else if (!nodeAt(doc, header.root))
+                err = "invalid root node";
+        }
+
+        if (err)
+        {
+            detail::destroy(doc);
+            return mappedError(err);
+        }
+        return MappedView(doc, nodeAt(doc, header.root));
+    }
+
+    MappedViewResult parseMappedViewInPlace(const char * _data, Size _byteCount, Allocator & _alloc)
+    {
+        return createView(_data, _byteCount, nullptr, false, _alloc);
+    }
+
+    MappedViewResult parseMappedView(const String & _data, Allocator & _alloc)
+    {
+        //the nodes are read in place and need their alignment
+        auto block = _alloc.allocate(_data.length(), alignof(detail::MappedNode));
+        std::memcpy(block.ptr, _data.cString(), _data.length());
+        return createView(static_cast<const char *>(block.ptr), _data.length(), block.ptr, false, _alloc);
+    }
+
+    MappedViewResult loadMappedView(const String & _path, Allocator & _alloc)
+    {
+        int fd = open(_path.cString(), O_RDONLY);
+        if (fd == -1)
+            return Error(ec::InvalidOperation, String::concat("Failed to open ", _path, ": ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            Error err(ec::InvalidOperation, String::concat("Failed to stat ", _path, ": ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+            close(fd);
+            return err;
+        }
+
+        Size byteCount = static_cast<Size>(info.st_size);
+        if (byteCount < sizeof(detail::MappedHeader))
+        {
+            close(fd);
+            return mappedError("not a mapped Shrub");
+        }
+
+        //a shared read only mapping, the pages come from the page cache and are shared with every
+        //other process that maps the same file
+        void * data = mmap(nullptr, byteCount, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return Error(ec::InvalidOperation, String::concat("Failed to map ", _path, ": ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+        return createView(static_cast<const char *>(data), byteCount, nullptr, true, _alloc);
+    }
+}
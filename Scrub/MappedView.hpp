@@ -0,0 +1,197 @@
+#ifndef SCRUB_MAPPEDVIEW_HPP
+#define SCRUB_MAPPEDVIEW_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace scrub
+{
+    namespace detail
+    {
+        //reference counted owner of the mapped (or copied) data
+        struct MappedViewDocument;
+
+        struct MappedNode;
+
+        template<class T, bool IsArithmetic = std::is_arithmetic<T>::value>
+        struct MappedViewConverter;
+    }
+
+    //read only view of a tree written by exportMappedBinary. The data is used in place, there is no
+    //parsing and nothing is copied out of it. Child lookups are binary searches of the name sorted
+    //child tables. Every offset is checked when it is followed, so damaged data results in missing
+    //children rather than out of bounds reads.
+    class STICK_API MappedView
+    {
+    public:
+
+        class ChildIter;
+
+
+        MappedView();
+
+        MappedView(detail::MappedViewDocument * _document, const detail::MappedNode * _node);
+
+        MappedView(const MappedView & _other);
+
+        MappedView(MappedView && _other);
+
+        ~MappedView();
+
+        MappedView & operator = (const MappedView & _other);
+
+        MappedView & operator = (MappedView && _other);
+
+        stick::Maybe<MappedView> child(const stick::String & _path, char _separator = '.') const;
+
+        template<class T>
+        stick::Maybe<T> maybe(const stick::String & _path, char _separator = '.') const
+        {
+            auto desc = child(_path, _separator);
+            if (desc)
+                return (*desc).value<T>();
+            return stick::Maybe<T>();
+        }
+
+        template<class T>
+        T maybe(const stick::String & _path, T _orValue) const
+        {
+            auto m = maybe<T>(_path);
+            if (m)
+                return *m;
+            return _orValue;
+        }
+
+        template<class T>
+        T get(const stick::String & _path, char _separator = '.') const
+        {
+            return maybe<T>(_path, _separator).value();
+        }
+
+        //numbers are converted in place, only String allocates.
+        template<class T>
+        stick::Maybe<T> value() const
+        {
+            return detail::MappedViewConverter<T>::convert(valueCString());
+        }
+
+        //null terminated name inside of the data.
+        const char * name() const;
+
+        //null terminated value inside of the data.
+        const char * valueCString() const;
+
+        StringSpan valueString() const;
+
+        ValueHint valueHint() const;
+
+        bool isValid() const;
+
+        ChildIter begin() const;
+
+        ChildIter end() const;
+
+        stick::Size count() const;
+
+        //the child at _index, invalid if it is out of range.
+        MappedView operator [] (stick::Size _index) const;
+
+    private:
+
+        detail::MappedViewDocument * m_document;
+        const detail::MappedNode * m_node;
+    };
+
+    //keeps a copy of its parent and with it the document alive while iterating
+    class STICK_API MappedView::ChildIter
+    {
+    public:
+
+        ChildIter(const MappedView & _parent, stick::Size _index);
+
+        MappedView operator * () const;
+
+        ChildIter & operator ++ ();
+
+        bool operator == (const ChildIter & _other) const;
+
+        bool operator != (const ChildIter & _other) const;
+
+    private:
+
+        MappedView m_parent;
+        stick::Size m_index;
+    };
+
+    namespace detail
+    {
+        template<class T>
+        struct MappedViewConverter<T, true>
+        {
+            static stick::Maybe<T> convert(const char * _str)
+            {
+                char * end;
+                T ret = std::is_floating_point<T>::value ? static_cast<T>(std::strtod(_str, &end)) : static_cast<T>(std::strtoll(_str, &end, 10));
+                if (end == _str)
+                    return stick::Maybe<T>();
+                return ret;
+            }
+        };
+
+        template<>
+        struct MappedViewConverter<bool, true>
+        {
+            static stick::Maybe<bool> convert(const char * _str)
+            {
+                if (std::strcmp(_str, "true") == 0 || std::strcmp(_str, "1") == 0)
+                    return true;
+                else if (std::strcmp(_str, "false") == 0 || std::strcmp(_str, "0") == 0)
+                    return false;
+                return stick::Maybe<bool>();
+            }
+        };
+
+        template<>
+        struct MappedViewConverter<const char *, false>
+        {
+            static stick::Maybe<const char *> convert(const char * _str)
+            {
+                return _str;
+            }
+        };
+
+        template<>
+        struct MappedViewConverter<StringSpan, false>
+        {
+            static stick::Maybe<StringSpan> convert(const char * _str)
+            {
+                return StringSpan(_str, std::strlen(_str));
+            }
+        };
+
+        template<>
+        struct MappedViewConverter<stick::String, false>
+        {
+            static stick::Maybe<stick::String> convert(const char * _str)
+            {
+                return stick::String(_str);
+            }
+        };
+    }
+
+    typedef stick::Result<MappedView> MappedViewResult;
+
+    //maps the file read only and shared, so processes viewing the same file share its pages through
+    //the page cache. Nothing is read until it is accessed. The returned view and all views derived
+    //from it keep the mapping alive.
+    STICK_API MappedViewResult loadMappedView(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    //views a copy of _data.
+    STICK_API MappedViewResult parseMappedView(const stick::String & _data, stick::Allocator & _alloc = stick::defaultAllocator());
+    //views _data in place, it has to be 8 byte aligned and outlive the returned views.
+    STICK_API MappedViewResult parseMappedViewInPlace(const char * _data, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_MAPPEDVIEW_HPP
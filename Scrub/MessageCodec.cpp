@@ -0,0 +1,138 @@
+#include <Scrub/MessageCodec.hpp>
+#include <Scrub/Binary/BinaryNodes.hpp>
+#include <Scrub/Sink.hpp>
+
+#include <algorithm>
+
+namespace scrub
+{
+    using namespace stick;
+
+    KeyDictionary trainKeyDictionary(const Shrub * _samples, Size _sampleCount, Size _maxKeyCount, Allocator & _alloc)
+    {
+        KeyDictionary all(_alloc);
+        DynamicArray<Size> counts(_alloc);
+        for (Size i = 0; i < _sampleCount; ++i)
+        {
+            DynamicArray<UInt32> ids(_alloc);
+            binary::collectKeyIds(_samples[i], all, ids);
+            counts.resize(all.count(), 0);
+            for (UInt32 id : ids)
+                ++counts[id];
+        }
+
+        DynamicArray<UInt32> order(_alloc);
+        order.resize(all.count());
+        for (Size i = 0; i < order.count(); ++i)
+            order[i] = static_cast<UInt32>(i);
+        std::stable_sort(order.begin(), order.end(), [&](UInt32 _a, UInt32 _b) { return counts[_a] > counts[_b]; });
+
+        KeyDictionary ret(_alloc);
+        for (Size i = 0; i < order.count() && i < _maxKeyCount; ++i)
+            ret.add(all.key(order[i]));
+        return ret;
+    }
+
+    static const char s_dictionaryMagic[4] = {'S', 'H', 'R', 'K'};
+
+    TextResult exportKeyDictionary(const KeyDictionary & _dictionary)
+    {
+        String ret(_dictionary.allocator());
+        StringWriter out(ret);
+        out.append(s_dictionaryMagic, 4);
+        binary::writeKeys(out, _dictionary, 0);
+        return ret;
+    }
+
+    KeyDictionaryResult parseKeyDictionary(const String & _data, Allocator & _alloc)
+    {
+        binary::BinaryReader reader(_data.cString(), _data.length());
+        DynamicArray<String> keys(_alloc);
+        const char * magic;
+        if (!reader.readBytes(magic, 4) || std::memcmp(magic, s_dictionaryMagic, 4) != 0 || !binary::readKeys(reader, keys) || reader.remaining())
+            return binary::binaryError("invalid key dictionary");
+
+        //the ids are the positions, so every key may only appear once
+        KeyDictionary ret(_alloc);
+        for (const String & key : keys)
+        {
+            if (ret.add(key) != ret.count() - 1)
+                return binary::binaryError("duplicate key in the key dictionary");
+        }
+        return ret;
+    }
+
+    MessageEncoder::MessageEncoder(Allocator & _alloc) :
+        m_dictionary(_alloc),
+        m_ids(_alloc)
+    {
+
+    }
+
+    MessageEncoder::MessageEncoder(const KeyDictionary & _dictionary) :
+        m_dictionary(_dictionary),
+        m_ids(_dictionary.allocator())
+    {
+
+    }
+
+    TextResult MessageEncoder::encode(const Shrub & _message)
+    {
+        String ret(m_dictionary.allocator());
+        encode(_message, ret);
+        return ret;
+    }
+
+    void MessageEncoder::encode(const Shrub & _message, String & _out)
+    {
+        //keys that are new to the stream are sent ahead of the nodes
+        Size known = m_dictionary.count();
+        m_ids.clear();
+        binary::collectKeyIds(_message, m_dictionary, m_ids);
+
+        StringWriter out(_out);
+        binary::writeKeys(out, m_dictionary, known);
+        binary::writeNodes(out, _message, m_ids);
+    }
+
+    const KeyDictionary & MessageEncoder::dictionary() const
+    {
+        return m_dictionary;
+    }
+
+    MessageDecoder::MessageDecoder(Allocator & _alloc) :
+        m_keys(_alloc)
+    {
+
+    }
+
+    MessageDecoder::MessageDecoder(const KeyDictionary & _dictionary) :
+        m_keys(_dictionary.keys())
+    {
+
+    }
+
+    ShrubResult MessageDecoder::decode(const char * _data, Size _byteCount)
+    {
+        binary::BinaryReader reader(_data, _byteCount);
+        Size known = m_keys.count();
+        Shrub ret(m_keys.allocator());
+        Error err;
+        if (!binary::readKeys(reader, m_keys))
+            err = binary::binaryError("invalid keys");
+        else
+            err = binary::readTree(reader, m_keys, ret);
+
+        if (err)
+        {
+            m_keys.resize(known, String(m_keys.allocator()));
+            return err;
+        }
+        return ret;
+    }
+
+    ShrubResult MessageDecoder::decode(const String & _data)
+    {
+        return decode(_data.cString(), _data.length());
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SCRUB_MESSAGECODEC_HPP
+#define SCRUB_MESSAGECODEC_HPP
+
+#include <Scrub/Binary/KeyDictionary.hpp>
+
+namespace scrub
+{
+    typedef stick::Result<KeyDictionary> KeyDictionaryResult;
+
+    //the names used in _samples, most frequent first and at most _maxKeyCount of them. Load the
+    //result on both ends of a stream so that not even the first messages have to send their keys.
+    STICK_API KeyDictionary trainKeyDictionary(const Shrub * _samples, stick::Size _sampleCount, stick::Size _maxKeyCount = 4096,
+                                               stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API stick::TextResult exportKeyDictionary(const KeyDictionary & _dictionary);
+    STICK_API KeyDictionaryResult parseKeyDictionary(const stick::String & _data, stick::Allocator & _alloc = stick::defaultAllocator());
+
+    //Encodes a stream of small messages in the binary node layout (see exportBinary) with the keys
+    //replaced by ids of a dictionary that both ends build up as the stream goes. Every message starts
+    //with the keys it adds, so each key is sent once per stream. The messages have to be decoded in
+    //the order they were encoded, by a decoder that started with the same dictionary.
+    class STICK_API MessageEncoder
+    {
+    public:
+
+        MessageEncoder(stick::Allocator & _alloc = stick::defaultAllocator());
+
+        MessageEncoder(const KeyDictionary & _dictionary);
+
+        stick::TextResult encode(const Shrub & _message);
+
+        //appends the message to _out, so that a buffer can be reused.
+        void encode(const Shrub & _message, stick::String & _out);
+
+        const KeyDictionary & dictionary() const;
+
+    private:
+
+        KeyDictionary m_dictionary;
+        //the key id of every node of the message being encoded
+        stick::DynamicArray<stick::UInt32> m_ids;
+    };
+
+    class STICK_API MessageDecoder
+    {
+    public:
+
+        MessageDecoder(stick::Allocator & _alloc = stick::defaultAllocator());
+
+        MessageDecoder(const KeyDictionary & _dictionary);
+
+        //a message that fails to decode doesn't add its keys.
+        ShrubResult decode(const char * _data, stick::Size _byteCount);
+
+        ShrubResult decode(const stick::String & _data);
+
+    private:
+
+        stick::DynamicArray<stick::String> m_keys;
+    };
+}
+
+#endif //SCRUB_MESSAGECODEC_HPP
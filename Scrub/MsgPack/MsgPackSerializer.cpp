@@ -0,0 +1,569 @@
+#include <Scrub/MsgPack/MsgPackSerializer.hpp>
+#include <Scrub/Binary/BinarySerializer.hpp>
+#include <Scrub/JSON/JSONSerializer.hpp>
+#include <Scrub/Sink.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+namespace scrub
+{
+    namespace msgpack
+    {
+        //writes _tag followed by the lowest _byteCount bytes of _value in big endian order
+        template<class W>
+        static void writeTagged(W & _out, UInt8 _tag, UInt64 _value, Size _byteCount)
+        {
+            char bytes[9];
+            bytes[0] = static_cast<char>(_tag);
+            for (Size i = 0; i < _byteCount; ++i)
+                bytes[1 + i] = static_cast<char>(_value >> (8 * (_byteCount - 1 - i)));
+            _out.append(bytes, _byteCount + 1);
+        }
+
+        template<class W>
+        static void writeString(W & _out, const String & _str)
+        {
+            Size length = _str.length();
+            if (length < 32)
+                _out.append(static_cast<char>(0xA0 | length));
+            else if (length <= 0xFF)
+                writeTagged(_out, 0xD9, length, 1);
+            else if (length <= 0xFFFF)
+                writeTagged(_out, 0xDA, length, 2);
+            else
+                writeTagged(_out, 0xDB, length, 4);
+            _out.append(_str);
+        }
+
+        template<class W>
+        static void writeBin(W & _out, const String & _bytes)
+        {
+            Size length = _bytes.length();
+            if (length <= 0xFF)
+                writeTagged(_out, 0xC4, length, 1);
+            else if (length <= 0xFFFF)
+                writeTagged(_out, 0xC5, length, 2);
+            else
+                writeTagged(_out, 0xC6, length, 4);
+            _out.append(_bytes);
+        }
+
+        template<class W>
+        static void writeContainerHeader(W & _out, bool _bMap, Size _count)
+        {
+            if (_count < 16)
+                _out.append(static_cast<char>((_bMap ? 0x80 : 0x90) | _count));
+            else if (_count <= 0xFFFF)
+                writeTagged(_out, _bMap ? 0xDE : 0xDC, _count, 2);
+            else
+                writeTagged(_out, _bMap ? 0xDF : 0xDD, _count, 4);
+        }
+
+        template<class W>
+        static void writeUInt(W & _out, UInt64 _value)
+        {
+            if (_value < 128)
+                _out.append(static_cast<char>(_value));
+            else if (_value <= 0xFF)
+                writeTagged(_out, 0xCC, _value, 1);
+            else if (_value <= 0xFFFF)
+                writeTagged(_out, 0xCD, _value, 2);
+            else if (_value <= 0xFFFFFFFF)
+                writeTagged(_out, 0xCE, _value, 4);
+            else
+                writeTagged(_out, 0xCF, _value, 8);
+        }
+
+        template<class W>
+        static void writeInt(W & _out, Int64 _value)
+        {
+            if (_value >= 0)
+                writeUInt(_out, static_cast<UInt64>(_value));
+            else if (_value >= -32)
+                _out.append(static_cast<char>(_value));
+            else if (_value >= -128)
+                writeTagged(_out, 0xD0, static_cast<UInt64>(_value), 1);
+            else if (_value >= -32768)
+                writeTagged(_out, 0xD1, static_cast<UInt64>(_value), 2);
+            else if (_value >= -2147483648LL)
+                writeTagged(_out, 0xD2, static_cast<UInt64>(_value), 4);
+            else
+                writeTagged(_out, 0xD3, static_cast<UInt64>(_value), 8);
+        }
+
+        //false if _value isn't an integer in the range of Int64 or UInt64
+        template<class W>
+        static bool writeIntString(W & _out, const String & _value)
+        {
+            const char * str = _value.cString();
+            char * end;
+            errno = 0;
+            if (str[0] == '-')
+            {
+                long long i = std::strtoll(str, &end, 10);
+                if (errno || end != str + _value.length())
+                    return false;
+                writeInt(_out, static_cast<Int64>(i));
+                return true;
+            }
+
+            unsigned long long u = std::strtoull(str, &end, 10);
+            if (errno || end != str + _value.length())
+                return false;
+            writeUInt(_out, static_cast<UInt64>(u));
+            return true;
+        }
+
+        template<class W>
+        static bool writeDoubleString(W & _out, const String & _value)
+        {
+            char * end;
+            Float64 d = std::strtod(_value.cString(), &end);
+            if (end != _value.cString() + _value.length())
+                return false;
+            UInt64 bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            writeTagged(_out, 0xCB, bits, 8);
+            return true;
+        }
+
+        //numbers and bools whose values don't parse are written as strings, like the other
+        //hints. Empty values without a hint are nil.
+        template<class W>
+        static void writeScalar(W & _out, const Shrub & _node)
+        {
+            const String & value = _node.valueString();
+            ValueHint hint = _node.valueHint();
+            if (hint == ValueHint::JSONInt && value.length())
+            {
+                if (writeIntString(_out, value) || writeDoubleString(_out, value))
+                    return;
+            }
+            else if (hint == ValueHint::JSONDouble && value.length())
+            {
+                if (writeDoubleString(_out, value))
+                    return;
+            }
+            else if (hint == ValueHint::JSONBool)
+            {
+                bool bTrue = value == "true" || value == "1";
+                if (bTrue || value == "false" || value == "0")
+                {
+                    _out.append(static_cast<char>(bTrue ? 0xC3 : 0xC2));
+                    return;
+                }
+            }
+            else if (hint == ValueHint::None && !value.length())
+            {
+                _out.append(static_cast<char>(0xC0));
+                return;
+            }
+            else if (hint == ValueHint::Binary)
+            {
+                writeBin(_out, value);
+                return;
+            }
+            writeString(_out, value);
+        }
+
+        struct ExportFrame
+        {
+            const Shrub * next;
+            const Shrub * end;
+            bool bMap;
+        };
+
+        //packed arrays are written straight from their buffer, without unpacking them
+        template<class W>
+        static void writeTypedArray(W & _out, const Shrub & _node)
+        {
+            writeContainerHeader(_out, false, _node.count());
+            if (_node.arrayType() == ArrayType::Float32)
+            {
+                for (Float32 value : _node.typedArray<Float32>())
+                {
+                    UInt32 bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    writeTagged(_out, 0xCA, bits, 4);
+                }
+            }
+            else if (_node.arrayType() == ArrayType::Float64)
+            {
+                for (Float64 value : _node.typedArray<Float64>())
+                {
+                    UInt64 bits;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    writeTagged(_out, 0xCB, bits, 8);
+                }
+            }
+            else if (_node.arrayType() == ArrayType::Int32)
+            {
+                for (Int32 value : _node.typedArray<Int32>())
+                    writeInt(_out, value);
+            }
+            else
+            {
+                for (Int64 value : _node.typedArray<Int64>())
+                    writeInt(_out, value);
+            }
+        }
+
+        template<class W>
+        static void writeNode(W & _out, const Shrub & _node, DynamicArray<ExportFrame> & _stack)
+        {
+            if (_node.arrayType() != ArrayType::None)
+            {
+                writeTypedArray(_out, _node);
+                return;
+            }
+
+            json::ContainerKind kind = json::containerKind(_node);
+            if (kind == json::ContainerKind::None)
+            {
+                writeScalar(_out, _node);
+                return;
+            }
+
+            bool bMap = kind == json::ContainerKind::Object;
+            writeContainerHeader(_out, bMap, _node.count());
+            if (_node.count())
+                _stack.append({&*_node.begin(), &*_node.begin() + _node.count(), bMap});
+        }
+
+        template<class W>
+        static void writeMsgPack(const Shrub & _root, W & _out)
+        {
+            DynamicArray<ExportFrame> stack(const_cast<Allocator &>(_root.allocator()));
+            writeNode(_out, _root, stack);
+            while (stack.count())
+            {
+                ExportFrame & top = stack.last();
+                if (top.next == top.end)
+                {
+                    stack.resize(stack.count() - 1);
+                    continue;
+                }
+
+                const Shrub & node = *top.next++;
+                if (top.bMap)
+                    writeString(_out, node.name());
+                writeNode(_out, node, stack);
+            }
+        }
+
+        Error exportMsgPack(const Shrub & _shrub, Sink & _sink, Size _bufferSize)
+        {
+            BufferedSink out(_sink, _bufferSize, const_cast<Allocator &>(_shrub.allocator()));
+            writeMsgPack(_shrub, out);
+            return out.flush();
+        }
+
+        TextResult exportMsgPack(const Shrub & _shrub)
+        {
+            String ret(const_cast<Allocator &>(_shrub.allocator()));
+            StringWriter out(ret);
+            writeMsgPack(_shrub, out);
+            return ret;
+        }
+
+        class MsgPackReader
+        {
+        public:
+
+            MsgPackReader(const char * _data, Size _byteCount) :
+                m_it(_data),
+                m_end(_data + _byteCount)
+            {
+
+            }
+
+            bool readByte(UInt8 & _out)
+            {
+                if (m_it == m_end)
+                    return false;
+                _out = static_cast<UInt8>(*m_it++);
+                return true;
+            }
+
+            bool peekByte(UInt8 & _out) const
+            {
+                if (m_it == m_end)
+                    return false;
+                _out = static_cast<UInt8>(*m_it);
+                return true;
+            }
+
+            bool readBigEndian(Size _byteCount, UInt64 & _out)
+            {
+                if (_byteCount > remaining())
+                    return false;
+                _out = 0;
+                for (Size i = 0; i < _byteCount; ++i)
+                    _out = (_out << 8) | static_cast<UInt8>(*m_it++);
+                return true;
+            }
+
+            bool readBytes(const char *& _out, UInt64 _byteCount)
+            {
+                if (_byteCount > remaining())
+                    return false;
+                _out = m_it;
+                m_it += _byteCount;
+                return true;
+            }
+
+            Size remaining() const
+            {
+                return m_end - m_it;
+            }
+
+        private:
+
+            const char * m_it;
+            const char * m_end;
+        };
+
+        static Error msgPackError(const char * _what)
+        {
+            return Error(ec::ParseFailed, String::concat("Failed to parse MessagePack: ", _what), STICK_FILE, STICK_LINE);
+        }
+
+        static void setValue(Shrub & _node, String && _value, ValueHint _hint)
+        {
+            _node.setValue(std::move(_value));
+            _node.setValueHint(_hint);
+        }
+
+        template<class T>
+        static String formatFloat(T _value, int _maxPrecision, Allocator & _alloc)
+        {
+            char buffer[32];
+            Size length = binary::formatFloat(_value, _maxPrecision, buffer);
+            return String(buffer, length, _alloc);
+        }
+
+        //the value of a str, bin or ext with a length of _lengthSize bytes
+        static bool readRaw(MsgPackReader & _reader, Size _lengthSize, bool _bExt, Shrub & _node, ValueHint _hint)
+        {
+            UInt64 length;
+            UInt8 type;
+            const char * data;
+            if (!_reader.readBigEndian(_lengthSize, length) || (_bExt && !_reader.readByte(type)) || !_reader.readBytes(data, length))
+                return false;
+            setValue(_node, String(data, length, _node.allocator()), _hint);
+            return true;
+        }
+
+        static bool readSigned(MsgPackReader & _reader, Size _byteCount, Shrub & _node)
+        {
+            UInt64 bits;
+            if (!_reader.readBigEndian(_byteCount, bits))
+                return false;
+            //sign extend
+            Size shift = 64 - _byteCount * 8;
+            Int64 value = static_cast<Int64>(bits << shift) >> shift;
+            setValue(_node, toString(value, _node.allocator()), ValueHint::JSONInt);
+            return true;
+        }
+
+        //reads one value into _node. Maps and arrays only read their header, _count is the number of
+        //elements (key value pairs for maps) that follow.
+        static bool readValue(MsgPackReader & _reader, Shrub & _node, Size & _count, bool & _bMap)
+        {
+            Allocator & alloc = _node.allocator();
+            UInt8 tag;
+            UInt64 value;
+            const char * data;
+            _count = 0;
+            if (!_reader.readByte(tag))
+                return false;
+
+            if (tag <= 0x7F)
+            {
+                setValue(_node, toString(static_cast<UInt64>(tag), alloc), ValueHint::JSONInt);
+                return true;
+            }
+            if (tag >= 0xE0)
+            {
+                setValue(_node, toString(static_cast<Int64>(static_cast<Int8>(tag)), alloc), ValueHint::JSONInt);
+                return true;
+            }
+            if (tag <= 0x9F)
+            {
+                _bMap = tag <= 0x8F;
+                _count = tag & 0x0F;
+                _node.setValueHint(_bMap ? ValueHint::JSONObject : ValueHint::JSONArray);
+                return true;
+            }
+            if (tag <= 0xBF)
+            {
+                if (!_reader.readBytes(data, tag & 0x1F))
+                    return false;
+                setValue(_node, String(data, tag & 0x1F, alloc), ValueHint::JSONString);
+                return true;
+            }
+
+            switch (tag)
+            {
+                case 0xC0:
+                    setValue(_node, String(alloc), ValueHint::None);
+                    return true;
+                case 0xC2:
+                case 0xC3:
+                    setValue(_node, String(tag == 0xC3 ? "true" : "false", alloc), ValueHint::JSONBool);
+                    return true;
+                //ext values keep their bytes, the type is dropped
+                case 0xC4:
+                case 0xC5:
+                case 0xC6:
+                    return readRaw(_reader, Size(1) << (tag - 0xC4), false, _node, ValueHint::Binary);
+                case 0xC7:
+                case 0xC8:
+                case 0xC9:
+                    return readRaw(_reader, Size(1) << (tag - 0xC7), true, _node, ValueHint::None);
+                case 0xCA:
+                {
+                    Float32 f;
+                    if (!_reader.readBigEndian(4, value))
+                        return false;
+                    UInt32 bits = static_cast<UInt32>(value);
+                    std::memcpy(&f, &bits, sizeof(f));
+                    setValue(_node, formatFloat(f, 9, alloc), ValueHint::JSONDouble);
+                    return true;
+                }
+                case 0xCB:
+                {
+                    Float64 d;
+                    if (!_reader.readBigEndian(8, value))
+                        return false;
+                    std::memcpy(&d, &value, sizeof(d));
+                    setValue(_node, formatFloat(d, 17, alloc), ValueHint::JSONDouble);
+                    return true;
+                }
+                case 0xCC:
+                case 0xCD:
+                case 0xCE:
+                case 0xCF:
+                    if (!_reader.readBigEndian(Size(1) << (tag - 0xCC), value))
+                        return false;
+                    setValue(_node, toString(value, alloc), ValueHint::JSONInt);
+                    return true;
+                case 0xD0:
+                case 0xD1:
+                case 0xD2:
+                case 0xD3:
+                    return readSigned(_reader, Size(1) << (tag - 0xD0), _node);
+                case 0xD4:
+                case 0xD5:
+                case 0xD6:
+                case 0xD7:
+                case 0xD8:
+                {
+                    UInt8 type;
+                    Size length = Size(1) << (tag - 0xD4);
+                    if (!_reader.readByte(type) || !_reader.readBytes(data, length))
+                        return false;
+                    setValue(_node, String(data, length, alloc), ValueHint::None);
+                    return true;
+                }
+                case 0xD9:
+                case 0xDA:
+                case 0xDB:
+                    return readRaw(_reader, Size(1) << (tag - 0xD9), false, _node, ValueHint::JSONString);
+                case 0xDC:
+                case 0xDD:
+                case 0xDE:
+                case 0xDF:
+                {
+                    _bMap = tag >= 0xDE;
+                    //every element takes at least a byte
+                    if (!_reader.readBigEndian(tag & 1 ? 4 : 2, value) || value > _reader.remaining())
+                        return false;
+                    _count = static_cast<Size>(value);
+                    _node.setValueHint(_bMap ? ValueHint::JSONObject : ValueHint::JSONArray);
+                    return true;
+                }
+                default:
+                    //0xC1 is never used
+                    return false;
+            }
+        }
+
+        //map keys become names. Strings are the common case, other scalars use their text.
+        static bool readKey(MsgPackReader & _reader, Shrub & _node)
+        {
+            UInt8 tag;
+            UInt64 length;
+            const char * data;
+            if (_reader.peekByte(tag) && ((tag >= 0xA0 && tag <= 0xBF) || (tag >= 0xD9 && tag <= 0xDB)))
+            {
+                _reader.readByte(tag);
+                if (tag <= 0xBF)
+                    length = tag & 0x1F;
+                else if (!_reader.readBigEndian(Size(1) << (tag - 0xD9), length))
+                    return false;
+                if (!_reader.readBytes(data, length))
+                    return false;
+                _node.setName(String(data, length, _node.allocator()));
+                return true;
+            }
+
+            //read into a scratch node, the value of the map entry may not overwrite what the key leaves
+            Shrub key(_node.allocator());
+            Size count;
+            bool bMap;
+            if (!readValue(_reader, key, count, bMap) || key.valueHint() == ValueHint::JSONObject || key.valueHint() == ValueHint::JSONArray)
+                return false;
+            _node.setName(key.valueString());
+            return true;
+        }
+
+        struct ParseFrame
+        {
+            Shrub * node;
+            Size remaining;
+            bool bMap;
+        };
+
+        ShrubResult parseMsgPack(const char * _data, Size _byteCount, Allocator & _alloc)
+        {
+            MsgPackReader reader(_data, _byteCount);
+            Shrub ret(_alloc);
+            Size count;
+            bool bMap;
+            if (!readValue(reader, ret, count, bMap))
+                return msgPackError("invalid value");
+
+            //children are only appended to the node on top of the stack, so growing its children never
+            //moves a node that is still on the stack. The counts come from untrusted data and nested
+            //headers could claim the rest of the input over and over, so nothing is reserved up front.
+            DynamicArray<ParseFrame> stack(_alloc);
+            if (count)
+                stack.append({&ret, count, bMap});
+            while (stack.count())
+            {
+                ParseFrame & top = stack.last();
+                if (!top.remaining)
+                {
+                    stack.resize(stack.count() - 1);
+                    continue;
+                }
+
+                --top.remaining;
+                Shrub & child = top.node->append(Shrub(_alloc));
+                if (top.bMap && !readKey(reader, child))
+                    return msgPackError("invalid map key");
+                if (!readValue(reader, child, count, bMap))
+                    return msgPackError("invalid value");
+                if (count)
+                    stack.append({&child, count, bMap});
+            }
+
+            if (reader.remaining())
+                return msgPackError("unexpected data after the root value");
+            return ret;
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SCRUB_MSGPACK_MSGPACKSERIALIZER_HPP
+#define SCRUB_MSGPACK_MSGPACKSERIALIZER_HPP
+
+#include <Scrub/Shrub.hpp>
+
+namespace scrub
+{
+    namespace msgpack
+    {
+        using namespace stick;
+
+        STICK_LOCAL Error exportMsgPack(const Shrub & _shrub, Sink & _sink, Size _bufferSize = 64 * 1024);
+        STICK_LOCAL TextResult exportMsgPack(const Shrub & _shrub);
+        STICK_LOCAL ShrubResult parseMsgPack(const char * _data, Size _byteCount, Allocator & _alloc);
+    }
+}
+
+#endif //SCRUB_MSGPACK_MSGPACKSERIALIZER_HPP
@@ -0,0 +1,148 @@
+#ifndef SCRUB_PARALLEL_HPP
+#define SCRUB_PARALLEL_HPP
+
+#include <Scrub/Sink.hpp>
+#include <Stick/Result.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace scrub
+{
+    namespace detail
+    {
+        inline stick::Size resolveThreadCount(stick::Size _threadCount)
+        {
+            if (_threadCount)
+                return _threadCount;
+            unsigned int hw = std::thread::hardware_concurrency();
+            return hw ? hw : 1;
+        }
+
+        //calls _fn(i) for every i in [0, _count) on up to _threadCount threads, including the calling one.
+        template<class F>
+        void parallelFor(stick::Size _count, stick::Size _threadCount, F _fn)
+        {
+            std::atomic<stick::Size> next(0);
+            auto work = [&]()
+            {
+                for (stick::Size i = next++; i < _count; i = next++)
+                    _fn(i);
+            };
+
+            stick::Size extra = (_threadCount < _count ? _threadCount : _count);
+            extra = extra ? extra - 1 : 0;
+            stick::DynamicArray<std::thread> threads;
+            threads.reserve(extra);
+            for (stick::Size i = 0; i < extra; ++i)
+                threads.append(std::thread(work));
+            work();
+            for (auto & t : threads)
+                t.join();
+        }
+
+        //Parallel exports split the output at the children of one node. The frame is everything
+        //else, written by _frame(buffer, capacity, splitOffset) with the children left out. It
+        //reports where they belong in splitOffset. _range(buffer, capacity, begin, end) writes the
+        //children [begin, end). Both return their size and only measure with a capacity of zero.
+        struct ParallelExport
+        {
+            stick::Size childCount;
+            stick::Size threadCount;
+            stick::Allocator * allocator;
+        };
+
+        inline stick::Size chunkBegin(const ParallelExport & _export, stick::Size _chunkCount, stick::Size _chunk)
+        {
+            return _export.childCount * _chunk / _chunkCount;
+        }
+
+        //enough chunks to balance the threads
+        inline stick::Size chunkCount(const ParallelExport & _export)
+        {
+            stick::Size ret = _export.threadCount * 8;
+            return ret < _export.childCount ? ret : _export.childCount;
+        }
+
+        template<class FrameFn, class RangeFn>
+        stick::TextResult exportParallel(const ParallelExport & _export, FrameFn _frame, RangeFn _range)
+        {
+            //measure everything first, then every thread writes to its final position in the result
+            stick::Size splitOffset = 0;
+            stick::Size frameSize = _frame(nullptr, 0, splitOffset);
+
+            stick::Size chunks = chunkCount(_export);
+            stick::DynamicArray<stick::Size> offsets(*_export.allocator);
+            offsets.resize(chunks + 1);
+            parallelFor(chunks, _export.threadCount, [&](stick::Size _i)
+            {
+                offsets[_i + 1] = _range(nullptr, 0, chunkBegin(_export, chunks, _i), chunkBegin(_export, chunks, _i + 1));
+            });
+
+            offsets[0] = splitOffset;
+            for (stick::Size i = 1; i <= chunks; ++i)
+                offsets[i] += offsets[i - 1];
+            stick::Size total = frameSize + offsets[chunks] - splitOffset;
+
+            stick::String ret(*_export.allocator);
+            ret.resize(total);
+            char * buffer = &ret[0];
+            _frame(buffer, frameSize, splitOffset);
+            std::memmove(buffer + offsets[chunks], buffer + splitOffset, frameSize - splitOffset);
+
+            parallelFor(chunks, _export.threadCount, [&](stick::Size _i)
+            {
+                _range(buffer + offsets[_i], offsets[_i + 1] - offsets[_i], chunkBegin(_export, chunks, _i), chunkBegin(_export, chunks, _i + 1));
+            });
+            return ret;
+        }
+
+        template<class FrameFn, class RangeFn>
+        stick::Error exportParallel(const ParallelExport & _export, Sink & _sink, FrameFn _frame, RangeFn _range)
+        {
+            stick::Allocator & alloc = *_export.allocator;
+            stick::Size splitOffset = 0;
+            stick::String frame(alloc);
+            frame.resize(_frame(nullptr, 0, splitOffset));
+            if (frame.length())
+                _frame(&frame[0], frame.length(), splitOffset);
+
+            //the chunks are rendered in batches, each handed to the sink in one vectored write
+            //while memory stays bounded by the batch size.
+            stick::Size chunks = chunkCount(_export);
+            stick::Size batchSize = _export.threadCount * 2;
+            stick::DynamicArray<stick::String> rendered(alloc);
+            stick::DynamicArray<StringSpan> blocks(alloc);
+            for (stick::Size i = 0; i < batchSize; ++i)
+                rendered.append(stick::String(alloc));
+
+            stick::Error err = _sink.write(frame.cString(), splitOffset);
+            for (stick::Size batch = 0; batch < chunks && !err; batch += batchSize)
+            {
+                stick::Size count = chunks - batch < batchSize ? chunks - batch : batchSize;
+                parallelFor(count, _export.threadCount, [&](stick::Size _i)
+                {
+                    stick::Size begin = chunkBegin(_export, chunks, batch + _i);
+                    stick::Size end = chunkBegin(_export, chunks, batch + _i + 1);
+                    stick::String & str = rendered[_i];
+                    str.resize(_range(nullptr, 0, begin, end));
+                    if (str.length())
+                        _range(&str[0], str.length(), begin, end);
+                });
+
+                blocks.clear();
+                for (stick::Size i = 0; i < count; ++i)
+                    blocks.append(StringSpan(rendered[i].cString(), rendered[i].length()));
+                err = _sink.writeVectored(&blocks[0], count);
+            }
+
+            if (!err)
+                err = _sink.write(frame.cString() + splitOffset, frame.length() - splitOffset);
+            if (!err)
+                err = _sink.flush();
+            return err;
+        }
+    }
+}
+
+#endif //SCRUB_PARALLEL_HPP
@@ -1,17 +1,134 @@
 #include <Stick/FileUtilities.hpp>
 #include <Scrub/JSON/JSONSerializer.hpp>
 #include <Scrub/XML/XMLSerializer.hpp>
+#include <Scrub/Binary/BinarySerializer.hpp>
+#include <Scrub/CBOR/CBORSerializer.hpp>
+#include <Scrub/MsgPack/MsgPackSerializer.hpp>
+#include <Scrub/Base64.hpp>
 #include <algorithm> //for std::sort
+#include <new> //for placement new
 
 namespace scrub
 {
     using namespace stick;
 
+    namespace detail
+    {
+        //Caches that exist anywhere. Without any there is nothing to invalidate, which spares
+        //building and parsing trees the walk to the root on every change.
+        static std::atomic<Size> s_exportCacheCount(0);
+
+        static void destroyExportCache(ExportCache * _cache, Allocator & _alloc)
+        {
+            if (_cache)
+            {
+                --s_exportCacheCount;
+                _cache->~ExportCache();
+                _alloc.deallocate({_cache, sizeof(ExportCache)});
+            }
+        }
+
+        static Size arrayTypeSize(ArrayType _type)
+        {
+            return _type == ArrayType::Float32 || _type == ArrayType::Int32 ? 4 : 8;
+        }
+
+        static Size packedArrayByteCount(ArrayType _type, Size _count)
+        {
+            return sizeof(PackedArray) + _count * arrayTypeSize(_type);
+        }
+
+        static PackedArray * createPackedArray(ArrayType _type, const void * _data, Size _count, Allocator & _alloc)
+        {
+            auto block = _alloc.allocate(packedArrayByteCount(_type, _count), alignof(Float64));
+            PackedArray * ret = new (block.ptr) PackedArray{_type, _count};
+            std::memcpy(ret->data(), _data, _count * arrayTypeSize(_type));
+            return ret;
+        }
+
+        static PackedArray * copyPackedArray(const PackedArray * _array, Allocator & _alloc)
+        {
+            return _array ? createPackedArray(_array->type, _array->data(), _array->count, _alloc) : nullptr;
+        }
+
+        static void destroyPackedArray(PackedArray * _array, Allocator & _alloc)
+        {
+            if (_array)
+                _alloc.deallocate({_array, packedArrayByteCount(_array->type, _array->count)});
+        }
+
+        static ShrubExtension * createExtension(Allocator & _alloc)
+        {
+            auto block = _alloc.allocate(sizeof(ShrubExtension), alignof(ShrubExtension));
+            return new (block.ptr) ShrubExtension{nullptr, 0, 0, nullptr, nullptr, nullptr, false, false};
+        }
+
+        static bool isUnused(const ShrubExtension & _extension)
+        {
+            return !_extension.lazySource && !_extension.packed && !_extension.exportCache && !_extension.bTracked && !_extension.bExportCaching;
+        }
+
+        static void destroyExtension(ShrubExtension * _extension, Allocator & _alloc)
+        {
+            if (_extension)
+            {
+                releaseLazySource(_extension->lazySource);
+                destroyExportCache(_extension->exportCache, _alloc);
+                destroyPackedArray(_extension->packed, _alloc);
+                _alloc.deallocate({_extension, sizeof(ShrubExtension)});
+            }
+        }
+
+        //writes the digits of _value to the end of _buffer and returns where they start
+        static char * formatUnsigned(UInt64 _value, char * _end)
+        {
+            do
+            {
+                *--_end = static_cast<char>('0' + _value % 10);
+                _value /= 10;
+            }
+            while (_value);
+            return _end;
+        }
+
+        static Size formatInt(Int64 _value, char (&_buffer)[32])
+        {
+            char digits[20];
+            char * end = digits + sizeof(digits);
+            //the magnitude of the smallest Int64 doesn't fit into an Int64
+            char * begin = formatUnsigned(_value < 0 ? ~static_cast<UInt64>(_value) + 1 : static_cast<UInt64>(_value), end);
+            Size length = 0;
+            if (_value < 0)
+                _buffer[length++] = '-';
+            std::memcpy(_buffer + length, begin, end - begin);
+            return length + (end - begin);
+        }
+
+        static Size formatPackedElement(const PackedArray & _array, Size _index, char (&_buffer)[32])
+        {
+            const void * data = _array.data();
+            switch (_array.type)
+            {
+                case ArrayType::Float32:
+                    return binary::formatFloat(static_cast<const Float32 *>(data)[_index], 9, _buffer);
+                case ArrayType::Float64:
+                    return binary::formatFloat(static_cast<const Float64 *>(data)[_index], 17, _buffer);
+                case ArrayType::Int32:
+                    return formatInt(static_cast<const Int32 *>(data)[_index], _buffer);
+                default:
+                    return formatInt(static_cast<const Int64 *>(data)[_index], _buffer);
+            }
+        }
+    }
+
     Shrub::Shrub(Allocator & _allocator) :
         m_name(_allocator),
         m_value(_allocator),
         m_valueHint(ValueHint::None),
-        m_children(_allocator)
+        m_bNameKnownClean(false),
+        m_bValueKnownClean(false),
+        m_children(_allocator),
+        m_extension(nullptr)
     {
 
     }
@@ -20,7 +137,10 @@ namespace scrub
         m_name(_name),
         m_value(_allocator),
         m_valueHint(_hint),
-        m_children(_allocator)
+        m_bNameKnownClean(false),
+        m_bValueKnownClean(false),
+        m_children(_allocator),
+        m_extension(nullptr)
     {
 
     }
@@ -29,9 +149,186 @@ namespace scrub
         m_name(_name),
         m_value(_value),
         m_valueHint(_hint),
-        m_children(_allocator)
+        m_bNameKnownClean(false),
+        m_bValueKnownClean(false),
+        m_children(_allocator),
+        m_extension(nullptr)
+    {
+
+    }
+
+    Shrub::Shrub(const String & _name, ValueHint _hint, detail::LazySource * _source, Size _begin, Size _end, Allocator & _allocator) :
+        m_name(_name),
+        m_value(_allocator),
+        m_valueHint(_hint),
+        m_bNameKnownClean(false),
+        m_bValueKnownClean(false),
+        m_children(_allocator),
+        m_extension(nullptr)
+    {
+        if (_source)
+        {
+            detail::ShrubExtension & ext = extension();
+            ext.lazySource = _source;
+            ext.lazyBegin = _begin;
+            ext.lazyEnd = _end;
+            detail::retainLazySource(_source);
+        }
+    }
+
+    Shrub::Shrub(const Shrub & _other) :
+        m_name(_other.m_name),
+        m_value(_other.m_value),
+        m_valueHint(_other.m_valueHint),
+        m_bNameKnownClean(_other.m_bNameKnownClean),
+        m_bValueKnownClean(_other.m_bValueKnownClean),
+        m_children(_other.m_children),
+        m_extension(nullptr)
+    {
+        copyExtension(_other);
+        //a copy of a caching node caches, too
+        if (isExportCaching())
+            trackSubtree();
+    }
+
+    Shrub::Shrub(Shrub && _other) :
+        m_name(std::move(_other.m_name)),
+        m_value(std::move(_other.m_value)),
+        m_valueHint(_other.m_valueHint),
+        m_bNameKnownClean(_other.m_bNameKnownClean),
+        m_bValueKnownClean(_other.m_bValueKnownClean),
+        m_children(std::move(_other.m_children)),
+        m_extension(_other.m_extension)
+    {
+        _other.m_extension = nullptr;
+        //the node it is appended to tracks it again
+        if (m_extension)
+            m_extension->parent = nullptr;
+        adoptChildren();
+    }
+
+    Shrub::~Shrub()
+    {
+        detail::destroyExtension(m_extension, m_children.allocator());
+    }
+
+    Shrub & Shrub::operator = (const Shrub & _other)
+    {
+        if (this != &_other)
+        {
+            m_name = _other.m_name;
+            m_value = _other.m_value;
+            m_valueHint = _other.m_valueHint;
+            m_bNameKnownClean = _other.m_bNameKnownClean;
+            m_bValueKnownClean = _other.m_bValueKnownClean;
+            m_children = _other.m_children;
+            //the node keeps its place in the tree and its cache, which is outdated below
+            copyExtension(_other);
+            retrack();
+            invalidateExportCache();
+            trimExtension();
+        }
+        return *this;
+    }
+
+    Shrub & Shrub::operator = (Shrub && _other)
+    {
+        if (this != &_other)
+        {
+            m_name = std::move(_other.m_name);
+            m_value = std::move(_other.m_value);
+            m_valueHint = _other.m_valueHint;
+            m_bNameKnownClean = _other.m_bNameKnownClean;
+            m_bValueKnownClean = _other.m_bValueKnownClean;
+            m_children = std::move(_other.m_children);
+            clearExtension();
+            detail::ShrubExtension * other = _other.m_extension;
+            if (other && (other->lazySource || other->packed || other->bExportCaching))
+            {
+                detail::ShrubExtension & ext = extension();
+                ext.lazySource = other->lazySource;
+                ext.lazyBegin = other->lazyBegin;
+                ext.lazyEnd = other->lazyEnd;
+                ext.packed = other->packed;
+                ext.bExportCaching = other->bExportCaching;
+                other->lazySource = nullptr;
+                other->packed = nullptr;
+            }
+            retrack();
+            invalidateExportCache();
+            trimExtension();
+        }
+        return *this;
+    }
+
+    detail::ShrubExtension & Shrub::extension() const
+    {
+        if (!m_extension)
+            m_extension = detail::createExtension(const_cast<Allocator &>(m_children.allocator()));
+        return *m_extension;
+    }
+
+    void Shrub::trimExtension() const
+    {
+        if (m_extension && detail::isUnused(*m_extension))
+        {
+            detail::destroyExtension(m_extension, const_cast<Allocator &>(m_children.allocator()));
+            m_extension = nullptr;
+        }
+    }
+
+    void Shrub::clearExtension()
+    {
+        if (!m_extension)
+            return;
+        Allocator & alloc = m_children.allocator();
+        detail::releaseLazySource(m_extension->lazySource);
+        m_extension->lazySource = nullptr;
+        detail::destroyPackedArray(m_extension->packed, alloc);
+        m_extension->packed = nullptr;
+        m_extension->bExportCaching = false;
+    }
+
+    void Shrub::copyExtension(const Shrub & _other)
     {
+        clearExtension();
+        const detail::ShrubExtension * other = _other.m_extension;
+        if (!other || !(other->lazySource || other->packed || other->bExportCaching))
+            return;
 
+        detail::ShrubExtension & ext = extension();
+        detail::retainLazySource(other->lazySource);
+        ext.lazySource = other->lazySource;
+        ext.lazyBegin = other->lazyBegin;
+        ext.lazyEnd = other->lazyEnd;
+        ext.packed = detail::copyPackedArray(other->packed, m_children.allocator());
+        ext.bExportCaching = other->bExportCaching;
+    }
+
+    namespace detail
+    {
+        LazySource * createLazySource(String && _text, LazySource::ExpandFunction _expand, Allocator & _alloc)
+        {
+            auto block = _alloc.allocate(sizeof(LazySource), alignof(LazySource));
+            LazySource * ret = new (block.ptr) LazySource(std::move(_text), _expand, &_alloc);
+            return ret;
+        }
+
+        void retainLazySource(LazySource * _source)
+        {
+            if (_source)
+                ++_source->referenceCount;
+        }
+
+        void releaseLazySource(LazySource * _source)
+        {
+            if (_source && _source->referenceCount.fetch_sub(1) == 1)
+            {
+                Allocator * alloc = _source->allocator;
+                _source->~LazySource();
+                alloc->deallocate({_source, sizeof(LazySource)});
+            }
+        }
     }
 
     Maybe<Shrub &> Shrub::child(const String & _path, char _separator)
@@ -53,21 +350,175 @@ namespace scrub
     Shrub & Shrub::setName(const String & _name)
     {
         m_name = _name;
+        m_bNameKnownClean = false;
+        invalidateExportCache();
         return *this;
     }
 
     Shrub & Shrub::setValue(const String & _value)
     {
         m_value = _value;
+        m_bValueKnownClean = false;
+        invalidateExportCache();
         return *this;
     }
 
+    Shrub & Shrub::setValue(String && _value)
+    {
+        m_value = std::move(_value);
+        m_bValueKnownClean = false;
+        invalidateExportCache();
+        return *this;
+    }
+
+    Shrub & Shrub::setKnownClean(bool _bName, bool _bValue)
+    {
+        m_bNameKnownClean = _bName;
+        m_bValueKnownClean = _bValue;
+        return *this;
+    }
+
+    bool Shrub::isNameKnownClean() const
+    {
+        return m_bNameKnownClean;
+    }
+
+    bool Shrub::isValueKnownClean() const
+    {
+        return m_bValueKnownClean;
+    }
+
     Shrub & Shrub::setValueHint(ValueHint _hint)
     {
         m_valueHint = _hint;
+        invalidateExportCache();
         return *this;
     }
 
+    Shrub & Shrub::setExportCaching(bool _bEnabled)
+    {
+        if (_bEnabled)
+        {
+            extension().bExportCaching = true;
+            trackSubtree();
+        }
+        else
+        {
+            if (m_extension)
+                m_extension->bExportCaching = false;
+            //the nodes stay tracked inside of an enclosing caching subtree
+            releaseExportCaches(!m_extension || !m_extension->parent);
+        }
+        return *this;
+    }
+
+    bool Shrub::isExportCaching() const
+    {
+        return m_extension && m_extension->bExportCaching;
+    }
+
+    const String * Shrub::cachedExport(const detail::ExportCacheKey & _key) const
+    {
+        const detail::ExportCache * cache = m_extension ? m_extension->exportCache : nullptr;
+        if (cache && cache->key.format == _key.format && cache->key.depth == _key.depth)
+            return &cache->bytes;
+        return nullptr;
+    }
+
+    const String & Shrub::storeExport(const detail::ExportCacheKey & _key, String && _bytes) const
+    {
+        detail::ShrubExtension & ext = extension();
+        if (!ext.exportCache)
+        {
+            Allocator & alloc = const_cast<Allocator &>(m_children.allocator());
+            auto block = alloc.allocate(sizeof(detail::ExportCache), alignof(detail::ExportCache));
+            ext.exportCache = new (block.ptr) detail::ExportCache{std::move(_bytes), _key};
+            ++detail::s_exportCacheCount;
+        }
+        else
+        {
+            ext.exportCache->bytes = std::move(_bytes);
+            ext.exportCache->key = _key;
+        }
+        return ext.exportCache->bytes;
+    }
+
+    void Shrub::invalidateExportCache()
+    {
+        if (!detail::s_exportCacheCount.load(std::memory_order_relaxed))
+            return;
+
+        //the output of every ancestor contains that of this node
+        for (Shrub * node = this; node && node->m_extension; node = node->m_extension->parent)
+        {
+            if (node->m_extension->exportCache)
+                node->m_extension->exportCache->key.format = detail::ExportFormat::None;
+        }
+    }
+
+    void Shrub::releaseExportCaches(bool _bUntrack)
+    {
+        //nested caching subtrees stay tracked
+        bool bUntrack = _bUntrack && !isExportCaching();
+        if (m_extension)
+        {
+            detail::destroyExportCache(m_extension->exportCache, m_children.allocator());
+            m_extension->exportCache = nullptr;
+            if (bUntrack)
+                m_extension->bTracked = false;
+        }
+        for (Shrub & child : m_children)
+        {
+            if (bUntrack && child.m_extension)
+                child.m_extension->parent = nullptr;
+            child.releaseExportCaches(bUntrack);
+        }
+        trimExtension();
+    }
+
+    bool Shrub::isTracked() const
+    {
+        return m_extension && m_extension->bTracked;
+    }
+
+    void Shrub::trackSubtree()
+    {
+        extension().bTracked = true;
+        DynamicArray<Shrub *> stack(m_children.allocator());
+        stack.append(this);
+        while (stack.count())
+        {
+            Shrub * node = stack.last();
+            stack.resize(stack.count() - 1);
+            for (Shrub & child : node->m_children)
+            {
+                detail::ShrubExtension & ext = child.extension();
+                ext.parent = node;
+                if (!ext.bTracked)
+                {
+                    ext.bTracked = true;
+                    stack.append(&child);
+                }
+            }
+        }
+    }
+
+    void Shrub::retrack()
+    {
+        //tracked if it caches itself or its parent is tracked
+        if (isExportCaching() || (m_extension && m_extension->parent))
+        {
+            trackSubtree();
+        }
+        else if (isTracked())
+        {
+            m_extension->bTracked = false;
+            detail::destroyExportCache(m_extension->exportCache, m_children.allocator());
+            m_extension->exportCache = nullptr;
+        }
+        adoptChildren();
+    }
+
     /*
     Shrub & Shrub::set(const String & _path, const char * _val, char _separator)
     {
@@ -105,16 +556,61 @@ namespace scrub
 
     Shrub & Shrub::append(const Shrub & _child)
     {
-        m_children.append(_child);
-        return m_children.last();
+        return appendChild(Shrub(_child));
     }
 
     Shrub & Shrub::append(Shrub && _child)
     {
+        return appendChild(std::move(_child));
+    }
+
+    Shrub & Shrub::appendChild(Shrub && _child)
+    {
+        ensureExpanded();
+        const Shrub * previous = m_children.count() ? &m_children[0] : nullptr;
         m_children.append(std::move(_child));
+        //growing moves all children
+        if (previous && previous != &m_children[0])
+            adoptChildren();
+        adoptChild(m_children.last());
+        invalidateExportCache();
         return m_children.last();
     }
 
+    Shrub & Shrub::reserve(Size _childCount)
+    {
+        ensureExpanded();
+        const Shrub * previous = m_children.count() ? &m_children[0] : nullptr;
+        m_children.reserve(_childCount);
+        if (previous && previous != &m_children[0])
+            adoptChildren();
+        return *this;
+    }
+
+    void Shrub::adoptChild(Shrub & _child)
+    {
+        if (isTracked())
+        {
+            detail::ShrubExtension & ext = _child.extension();
+            ext.parent = this;
+            if (!ext.bTracked)
+                _child.trackSubtree();
+        }
+        else if (_child.m_extension && (_child.m_extension->parent || _child.m_extension->bTracked))
+        {
+            //moved out of a caching subtree
+            _child.m_extension->parent = nullptr;
+            if (!_child.isExportCaching())
+                _child.releaseExportCaches(true);
+        }
+    }
+
+    void Shrub::adoptChildren()
+    {
+        for (Shrub & child : m_children)
+            adoptChild(child);
+    }
+
     const Shrub * Shrub::resolvePath(const String & _path, char _separator) const
     {
         auto segments = path::segments(_path, const_cast<Allocator &>(m_children.allocator()), _separator);
@@ -150,7 +646,7 @@ namespace scrub
             auto it = ret->findByName(segments[segment]);
             if (it == ret->m_children.end())
             {
-                ret->m_children.append(Shrub(segments[segment], ValueHint::None, const_cast<Allocator &>(m_children.allocator())));
+                ret->appendChild(Shrub(segments[segment], ValueHint::None, const_cast<Allocator &>(m_children.allocator())));
                 it = ret->m_children.begin() + ret->m_children.count() - 1;
                 ret = &(*it);
             }
@@ -178,13 +674,136 @@ namespace scrub
         }
     }
 
+    void Shrub::expand() const
+    {
+        if (m_extension->packed)
+        {
+            unpack();
+            return;
+        }
+
+        //detach the source first, the expand function appends to this node
+        detail::LazySource * source = m_extension->lazySource;
+        m_extension->lazySource = nullptr;
+        source->expandFunction(*source, m_extension->lazyBegin, m_extension->lazyEnd, const_cast<Shrub &>(*this));
+        detail::releaseLazySource(source);
+        trimExtension();
+    }
+
+    void Shrub::unpack() const
+    {
+        //detach the elements first, appending goes through ensureExpanded
+        detail::PackedArray * packed = m_extension->packed;
+        m_extension->packed = nullptr;
+
+        Allocator & alloc = const_cast<Allocator &>(m_children.allocator());
+        Shrub & self = const_cast<Shrub &>(*this);
+        ValueHint hint = binary::packedElementHint(packed->type);
+        self.reserve(packed->count);
+        for (Size i = 0; i < packed->count; ++i)
+        {
+            char buffer[32];
+            Size length = detail::formatPackedElement(*packed, i, buffer);
+            Shrub & child = self.appendChild(Shrub(String(alloc), String(buffer, length, alloc), hint, alloc));
+            child.setKnownClean(true, true);
+        }
+        detail::destroyPackedArray(packed, alloc);
+        trimExtension();
+    }
+
+    template<class T>
+    Shrub & Shrub::setPacked(const T * _values, Size _count)
+    {
+        Allocator & alloc = m_children.allocator();
+        m_children.clear();
+        if (m_extension)
+        {
+            detail::releaseLazySource(m_extension->lazySource);
+            m_extension->lazySource = nullptr;
+            detail::destroyPackedArray(m_extension->packed, alloc);
+            m_extension->packed = nullptr;
+        }
+        //empty arrays don't need a buffer
+        if (_count)
+            extension().packed = detail::createPackedArray(detail::ArrayTypeOf<T>::value, _values, _count, alloc);
+        else
+            trimExtension();
+        m_value.clear();
+        m_valueHint = ValueHint::JSONArray;
+        m_bValueKnownClean = true;
+        invalidateExportCache();
+        return *this;
+    }
+
+    Shrub & Shrub::setTypedArray(const Float32 * _values, Size _count)
+    {
+        return setPacked(_values, _count);
+    }
+
+    Shrub & Shrub::setTypedArray(const Float64 * _values, Size _count)
+    {
+        return setPacked(_values, _count);
+    }
+
+    Shrub & Shrub::setTypedArray(const Int32 * _values, Size _count)
+    {
+        return setPacked(_values, _count);
+    }
+
+    Shrub & Shrub::setTypedArray(const Int64 * _values, Size _count)
+    {
+        return setPacked(_values, _count);
+    }
+
+    ArrayType Shrub::arrayType() const
+    {
+        return m_extension && m_extension->packed ? m_extension->packed->type : ArrayType::None;
+    }
+
+    Size Shrub::formatTypedElement(Size _index, char (&_buffer)[32]) const
+    {
+        const detail::PackedArray * packed = m_extension ? m_extension->packed : nullptr;
+        STICK_ASSERT(packed && _index < packed->count);
+        return detail::formatPackedElement(*packed, _index, _buffer);
+    }
+
+    Shrub & Shrub::setBlob(const void * _data, Size _byteCount)
+    {
+        m_value = String(static_cast<const char *>(_data), _byteCount, m_children.allocator());
+        m_valueHint = ValueHint::Binary;
+        m_bValueKnownClean = false;
+        invalidateExportCache();
+        return *this;
+    }
+
+    ByteSpan Shrub::blob() const
+    {
+        if (m_valueHint != ValueHint::Binary)
+            return ByteSpan();
+        return ByteSpan(reinterpret_cast<const UInt8 *>(m_value.cString()), m_value.length());
+    }
+
+    Error Shrub::decodeBlob()
+    {
+        auto result = decodeBase64(m_value.cString(), m_value.length(), m_children.allocator());
+        if (!result)
+            return result.error();
+        m_value = std::move(result.get());
+        m_valueHint = ValueHint::Binary;
+        m_bValueKnownClean = false;
+        invalidateExportCache();
+        return Error();
+    }
+
     Shrub::ChildConstIter Shrub::findByName(const String & _name) const
     {
+        ensureExpanded();
         return findIf(m_children.begin(), m_children.end(), [this, _name](const Shrub & _child) { return _child.m_name == _name; });
     }
 
     Shrub::ChildIter Shrub::findByName(const String & _name)
     {
+        ensureExpanded();
         return findIf(m_children.begin(), m_children.end(), [this, _name](const Shrub & _child) { return _child.m_name == _name; });
     }
 
@@ -203,54 +822,74 @@ namespace scrub
         return m_valueHint;
     }
 
+    bool Shrub::isExpanded() const
+    {
+        return !m_extension || !m_extension->lazySource;
+    }
+
     Shrub & Shrub::sort()
     {
+        ensureExpanded();
         std::sort(m_children.begin(), m_children.end(), [this](const Shrub & _a, const Shrub & _b) { return _a.m_name < _b.m_name; });
+        adoptChildren();
+        invalidateExportCache();
         return *this;
     }
 
     Shrub::ChildIter Shrub::begin()
     {
+        ensureExpanded();
         return m_children.begin();
     }
 
     Shrub::ChildConstIter Shrub::begin() const
     {
+        ensureExpanded();
         return m_children.begin();
     }
 
     Shrub::ChildIter Shrub::end()
     {
+        ensureExpanded();
         return m_children.end();
     }
 
     Shrub::ChildConstIter Shrub::end() const
     {
+        ensureExpanded();
         return m_children.end();
     }
 
     Shrub::ReverseChildIter Shrub::rbegin()
     {
+        ensureExpanded();
         return m_children.rbegin();
     }
 
     Shrub::ReverseChildConstIter Shrub::rbegin() const
     {
+        ensureExpanded();
         return m_children.rbegin();
     }
 
     Shrub::ReverseChildIter Shrub::rend()
     {
+        ensureExpanded();
         return m_children.rend();
     }
 
     Shrub::ReverseChildConstIter Shrub::rend() const
     {
+        ensureExpanded();
         return m_children.rend();
     }
 
     Size Shrub::count() const
     {
+        //packed elements are counted without unpacking them
+        if (m_extension && m_extension->packed)
+            return m_extension->packed->count;
+        ensureExpanded();
         return m_children.count();
     }
 
@@ -264,43 +903,348 @@ namespace scrub
         return m_children.allocator();
     }
 
+    JSONParseOptions::JSONParseOptions() :
+        bPackNumberArrays(false)
+    {
+
+    }
+
     ShrubResult parseJSON(const String & _json, Allocator & _alloc)
     {
-        return json::parseJSON(_json, _alloc);
+        return json::parseJSON(_json, JSONParseOptions(), _alloc);
+    }
+
+    ShrubResult parseJSON(const String & _json, const JSONParseOptions & _options, Allocator & _alloc)
+    {
+        return json::parseJSON(_json, _options, _alloc);
     }
 
     ShrubResult loadJSON(const String & _path, Allocator & _alloc)
+    {
+        return loadJSON(_path, JSONParseOptions(), _alloc);
+    }
+
+    ShrubResult loadJSON(const String & _path, const JSONParseOptions & _options, Allocator & _alloc)
     {
         auto result = loadTextFile(_path, _alloc);
         if (result)
         {
-            return parseJSON(result.get(), _alloc);
+            return parseJSON(result.get(), _options, _alloc);
         }
         return result.error();
     }
 
+    SaveOptions::SaveOptions() :
+        bPrettify(false),
+        bAtomic(true),
+        sync(FileSync::File),
+        bufferSize(1024 * 1024)
+    {
+
+    }
+
+    //the exporters write straight to the file through a buffer of the requested size
+    template<class F>
+    static Error saveFile(const String & _path, const SaveOptions & _options, Allocator & _alloc, F _export)
+    {
+        FileSink file(_options.sync, _options.bAtomic, _alloc);
+        Error err = file.open(_path);
+        if (!err)
+            err = _export(file);
+        if (!err)
+            err = file.commit();
+        return err;
+    }
+
+    Error saveJSON(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return json::exportJSON(_shrub, _sink, _options.bPrettify, _options.bufferSize);
+        });
+    }
+
     TextResult exportJSON(const Shrub & _shrub, bool _bPrettify)
     {
         return json::exportJSON(_shrub, _bPrettify);
     }
 
+    Error exportJSON(const Shrub & _shrub, Sink & _sink, bool _bPrettify)
+    {
+        return json::exportJSON(_shrub, _sink, _bPrettify);
+    }
+
+    Size measureJSON(const Shrub & _shrub, bool _bPrettify)
+    {
+        return json::measureJSON(_shrub, _bPrettify);
+    }
+
+    Size exportJSONInto(const Shrub & _shrub, char * _buffer, Size _capacity, bool _bPrettify)
+    {
+        return json::exportJSONInto(_shrub, _buffer, _capacity, _bPrettify);
+    }
+
+    TextResult exportJSONCanonical(const Shrub & _shrub)
+    {
+        return json::exportJSONCanonical(_shrub);
+    }
+
+    Error exportJSONCanonical(const Shrub & _shrub, Sink & _sink)
+    {
+        return json::exportJSONCanonical(_shrub, _sink);
+    }
+
+    TextResult exportJSONParallel(const Shrub & _shrub, bool _bPrettify, Size _threadCount)
+    {
+        return json::exportJSONParallel(_shrub, _bPrettify, _threadCount);
+    }
+
+    Error exportJSONParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _threadCount)
+    {
+        return json::exportJSONParallel(_shrub, _sink, _bPrettify, _threadCount);
+    }
+
+    ShrubResult parseJSONLazy(const String & _json, Allocator & _alloc)
+    {
+        return json::parseJSONLazy(String(_json.cString(), _json.cString() + _json.length(), _alloc), _alloc);
+    }
+
+    ShrubResult loadJSONLazy(const String & _path, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (result)
+        {
+            return json::parseJSONLazy(std::move(result.get()), _alloc);
+        }
+        return result.error();
+    }
+
+    XMLParseOptions::XMLParseOptions() :
+        bDecodeEntities(true),
+        bNormalizeEOL(true),
+        bNormalizeAttributes(true),
+        bKeepCDATA(true),
+        bKeepComments(false),
+        bKeepProcessingInstructions(false),
+        bKeepWhitespacePCData(false),
+        bTrimPCData(false)
+    {
+
+    }
+
+    XMLParseOptions XMLParseOptions::minimal()
+    {
+        XMLParseOptions ret;
+        ret.bDecodeEntities = false;
+        ret.bNormalizeEOL = false;
+        ret.bNormalizeAttributes = false;
+        ret.bKeepCDATA = false;
+        return ret;
+    }
+
+    XMLParseOptions XMLParseOptions::fast()
+    {
+        XMLParseOptions ret = minimal();
+        ret.bDecodeEntities = true;
+        return ret;
+    }
+
     ShrubResult parseXML(const String & _xml, Allocator & _alloc)
     {
-        return xml::parseXML(_xml, _alloc);
+        return xml::parseXML(_xml, XMLParseOptions(), _alloc);
+    }
+
+    ShrubResult parseXML(const String & _xml, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        return xml::parseXML(_xml, _options, _alloc);
     }
 
     ShrubResult loadXML(const String & _path, Allocator & _alloc)
+    {
+        return loadXML(_path, XMLParseOptions(), _alloc);
+    }
+
+    ShrubResult loadXML(const String & _path, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (result)
+        {
+            //the loaded text is ours, so pugi can parse it in place
+            String & text = result.get();
+            if (!text.length())
+                return xml::parseXML(text, _options, _alloc);
+            return xml::parseXMLInPlace(&text[0], text.length(), _options, _alloc);
+        }
+        return result.error();
+    }
+
+    ShrubResult parseXMLInPlace(char * _buffer, Size _byteCount, Allocator & _alloc)
+    {
+        return xml::parseXMLInPlace(_buffer, _byteCount, XMLParseOptions(), _alloc);
+    }
+
+    ShrubResult parseXMLInPlace(char * _buffer, Size _byteCount, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        return xml::parseXMLInPlace(_buffer, _byteCount, _options, _alloc);
+    }
+
+    TextResult exportBinary(const Shrub & _shrub)
+    {
+        return binary::exportBinary(_shrub);
+    }
+
+    Error exportBinary(const Shrub & _shrub, Sink & _sink)
+    {
+        return binary::exportBinary(_shrub, _sink);
+    }
+
+    ShrubResult parseBinary(const String & _data, Allocator & _alloc)
+    {
+        return binary::parseBinary(_data.cString(), _data.length(), _alloc);
+    }
+
+    ShrubResult parseBinary(const char * _data, Size _byteCount, Allocator & _alloc)
+    {
+        return binary::parseBinary(_data, _byteCount, _alloc);
+    }
+
+    ShrubResult loadBinary(const String & _path, Allocator & _alloc)
     {
         auto result = loadTextFile(_path, _alloc);
         if (result)
         {
-            return parseXML(result.get(), _alloc);
+            return parseBinary(result.get(), _alloc);
         }
         return result.error();
     }
 
+    Error saveBinary(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return binary::exportBinary(_shrub, _sink, _options.bufferSize);
+        });
+    }
+
+    TextResult exportMappedBinary(const Shrub & _shrub)
+    {
+        return binary::exportMappedBinary(_shrub);
+    }
+
+    Error exportMappedBinary(const Shrub & _shrub, Sink & _sink)
+    {
+        return binary::exportMappedBinary(_shrub, _sink);
+    }
+
+    Error saveMappedBinary(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return binary::exportMappedBinary(_shrub, _sink, _options.bufferSize);
+        });
+    }
+
+    TextResult exportMsgPack(const Shrub & _shrub)
+    {
+        return msgpack::exportMsgPack(_shrub);
+    }
+
+    Error exportMsgPack(const Shrub & _shrub, Sink & _sink)
+    {
+        return msgpack::exportMsgPack(_shrub, _sink);
+    }
+
+    ShrubResult parseMsgPack(const String & _data, Allocator & _alloc)
+    {
+        return msgpack::parseMsgPack(_data.cString(), _data.length(), _alloc);
+    }
+
+    ShrubResult parseMsgPack(const char * _data, Size _byteCount, Allocator & _alloc)
+    {
+        return msgpack::parseMsgPack(_data, _byteCount, _alloc);
+    }
+
+    ShrubResult loadMsgPack(const String & _path, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (result)
+        {
+            return parseMsgPack(result.get(), _alloc);
+        }
+        return result.error();
+    }
+
+    Error saveMsgPack(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return msgpack::exportMsgPack(_shrub, _sink, _options.bufferSize);
+        });
+    }
+
+    TextResult exportCBOR(const Shrub & _shrub)
+    {
+        return cbor::exportCBOR(_shrub);
+    }
+
+    Error exportCBOR(const Shrub & _shrub, Sink & _sink)
+    {
+        return cbor::exportCBOR(_shrub, _sink);
+    }
+
+    ShrubResult parseCBOR(const String & _data, Allocator & _alloc)
+    {
+        return cbor::parseCBOR(_data.cString(), _data.length(), _alloc);
+    }
+
+    ShrubResult parseCBOR(const char * _data, Size _byteCount, Allocator & _alloc)
+    {
+        return cbor::parseCBOR(_data, _byteCount, _alloc);
+    }
+
+    ShrubResult loadCBOR(const String & _path, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (result)
+        {
+            return parseCBOR(result.get(), _alloc);
+        }
+        return result.error();
+    }
+
+    Error saveCBOR(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return cbor::exportCBOR(_shrub, _sink, _options.bufferSize);
+        });
+    }
+
+    Error saveXML(const Shrub & _shrub, const String & _path, const SaveOptions & _options)
+    {
+        return saveFile(_path, _options, const_cast<Allocator &>(_shrub.allocator()), [&](Sink & _sink)
+        {
+            return xml::exportXML(_shrub, _sink, _options.bPrettify, _options.bufferSize);
+        });
+    }
+
     TextResult exportXML(const Shrub & _shrub, bool _bPrettify)
     {
         return xml::exportXML(_shrub, _bPrettify);
     }
+
+    Error exportXML(const Shrub & _shrub, Sink & _sink, bool _bPrettify)
+    {
+        return xml::exportXML(_shrub, _sink, _bPrettify);
+    }
+
+    TextResult exportXMLParallel(const Shrub & _shrub, bool _bPrettify, Size _threadCount)
+    {
+        return xml::exportXMLParallel(_shrub, _bPrettify, _threadCount);
+    }
+
+    Error exportXMLParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _threadCount)
+    {
+        return xml::exportXMLParallel(_shrub, _sink, _bPrettify, _threadCount);
+    }
 }
@@ -11,7 +11,10 @@
 #include <Stick/Utility.hpp>
 #include <Stick/URI.hpp>
 #include <Stick/Result.hpp>
+#include <Scrub/Sink.hpp>
+#include <Scrub/Span.hpp>
 
+#include <atomic>
 #include <type_traits>
 
 namespace scrub
@@ -26,18 +29,144 @@ namespace scrub
         JSONDouble,
         JSONObject,
         JSONArray,
-        XMLAttribute
+        XMLAttribute,
+        XMLComment,
+        XMLProcessingInstruction,
+        //raw bytes, written as byte strings by the binary formats
+        Binary
     };
 
+    //element types of packed number arrays, see Shrub::setTypedArray
+    STICK_API_ENUM_CLASS(ArrayType)
+    {
+        None,
+        Float32,
+        Float64,
+        Int32,
+        Int64
+    };
+
+    class Shrub;
+
     namespace detail
     {
+        //reference counted copy of a source document that lazily parsed
+        //Shrubs decode their children from on first access. The count is atomic
+        //so that different subtrees can be expanded on different threads.
+        struct LazySource
+        {
+            typedef void (*ExpandFunction)(LazySource & _source, stick::Size _begin, stick::Size _end, Shrub & _node);
+
+            LazySource(stick::String && _text, ExpandFunction _expand, stick::Allocator * _alloc) :
+                text(std::move(_text)),
+                expandFunction(_expand),
+                referenceCount(0),
+                allocator(_alloc)
+            {
+
+            }
+
+            stick::String text;
+            ExpandFunction expandFunction;
+            std::atomic<stick::Size> referenceCount;
+            stick::Allocator * allocator;
+        };
+
+        //what a cached export of a node was written for, None marks it outdated
+        STICK_API_ENUM_CLASS(ExportFormat)
+        {
+            None,
+            JSON,
+            JSONPretty,
+            XML,
+            XMLPretty
+        };
+
+        struct ExportCacheKey
+        {
+            ExportFormat format;
+            //the indentation depth of pretty output
+            stick::Size depth;
+        };
+
+        struct ExportCache
+        {
+            stick::String bytes;
+            ExportCacheKey key;
+        };
+
+        //the elements of a packed array follow the header
+        struct PackedArray
+        {
+            ArrayType type;
+            stick::Size count;
+
+            void * data()
+            {
+                return this + 1;
+            }
+
+            const void * data() const
+            {
+                return this + 1;
+            }
+        };
+
+        //The state of lazy parsing, packed arrays and export caching. Most nodes use none of it, so
+        //it is allocated on demand to keep plain nodes small.
+        struct ShrubExtension
+        {
+            LazySource * lazySource;
+            stick::Size lazyBegin;
+            stick::Size lazyEnd;
+            PackedArray * packed;
+            ExportCache * exportCache;
+            //only tracked inside of export caching subtrees, to outdate the caches of the ancestors
+            Shrub * parent;
+            bool bTracked;
+            bool bExportCaching;
+        };
+
+        template<class T>
+        struct ArrayTypeOf;
+
+        template<>
+        struct ArrayTypeOf<stick::Float32>
+        {
+            static constexpr ArrayType value = ArrayType::Float32;
+        };
+
+        template<>
+        struct ArrayTypeOf<stick::Float64>
+        {
+            static constexpr ArrayType value = ArrayType::Float64;
+        };
+
+        template<>
+        struct ArrayTypeOf<stick::Int32>
+        {
+            static constexpr ArrayType value = ArrayType::Int32;
+        };
+
+        template<>
+        struct ArrayTypeOf<stick::Int64>
+        {
+            static constexpr ArrayType value = ArrayType::Int64;
+        };
+
+        STICK_API LazySource * createLazySource(stick::String && _text, LazySource::ExpandFunction _expand, stick::Allocator & _alloc);
+
+        STICK_API void retainLazySource(LazySource * _source);
+
+        STICK_API void releaseLazySource(LazySource * _source);
+
         template<class T>
         inline stick::String toString(T _val, stick::Allocator & _alloc)
         {
             return stick::toString(_val, _alloc);
         }
 
-        inline stick::String toString(const stick::String & _str, stick::Allocator & _alloc)
+        inline stick::String toString(const stick::String & _str, stick::Allocator &)
         {
             return _str;
         }
@@ -120,6 +249,10 @@ namespace scrub
         }
     }
 
+    //A node of a parsed or built tree. Const access is not free of side effects: it expands lazily
+    //parsed nodes, unpacks packed arrays whose children are accessed and fills the export caches of
+    //caching subtrees. Several threads can only read a const tree at once if none of that applies to
+    //the nodes they share, different subtrees can be used on different threads.
     class STICK_API Shrub
     {
     public:
@@ -137,10 +270,19 @@ namespace scrub
 
         Shrub(const stick::String & _name, const stick::String & _value, ValueHint _hint = ValueHint::None, stick::Allocator & _allocator = stick::defaultAllocator());
 
-        //@TODO: What about these?, Moka 05/12/2017
-        /*Shrub(const Shrub & _other);
+        //creates an unexpanded placeholder whose children are decoded from the byte range
+        //[_begin, _end) of _source the first time they are accessed (see parseJSONLazy).
+        Shrub(const stick::String & _name, ValueHint _hint, detail::LazySource * _source, stick::Size _begin, stick::Size _end, stick::Allocator & _allocator);
+
+        Shrub(const Shrub & _other);
+
+        Shrub(Shrub && _other);
 
-        Shrub(Shrub && _other);*/
+        ~Shrub();
+
+        Shrub & operator = (const Shrub & _other);
+
+        Shrub & operator = (Shrub && _other);
 
         stick::Maybe<Shrub &> child(const stick::String & _path, char _separator = '.');
 
@@ -152,7 +294,8 @@ namespace scrub
             if(_condition(*this))
                 return *this;
 
-            for(auto & child : m_children)
+            ensureExpanded();
+            for(const Shrub & child : m_children)
             {
                 auto maybe = child.find(_condition);
                 if(maybe) return maybe;
@@ -197,6 +340,8 @@ namespace scrub
 
         Shrub & setValue(const stick::String & _value);
 
+        Shrub & setValue(stick::String && _value);
+
         Shrub & setValueHint(ValueHint _hint);
 
         template<class T>
@@ -211,6 +356,8 @@ namespace scrub
             auto it = ensureTree(_path, _separator);
             it->m_value = detail::toString(_val, m_children.allocator());
             it->m_valueHint = _hint;
+            it->m_bValueKnownClean = false;
+            it->invalidateExportCache();
             return *it;
         }
 
@@ -219,15 +366,14 @@ namespace scrub
         template<class T>
         Shrub & append(const stick::String & _path, T _val, char _separator = '.')
         {
-            return append(_path, _val, detail::deduceHint<std::remove_cv<T>::type>(), _separator);
+            return append(_path, _val, detail::deduceHint<typename std::remove_cv<T>::type>(), _separator);
         }
 
         template<class T>
         Shrub & append(const stick::String & _path, T _val, ValueHint _hint, char _separator = '.')
         {
             auto it = ensureTree(_path, _separator);
-            it->m_children.append(Shrub(stick::String("", m_children.allocator()), detail::toString(_val, m_children.allocator()), _hint, m_children.allocator()));
-            return it->m_children.last();
+            return it->append(Shrub(stick::String("", m_children.allocator()), detail::toString(_val, m_children.allocator()), _hint, m_children.allocator()));
         }
 
         Shrub & append(const stick::String & _path, const Shrub & _node, char _separator = '.');
@@ -236,6 +382,9 @@ namespace scrub
 
         Shrub & append(Shrub && _child);
 
+        //makes room for _childCount children, so appending up to that many doesn't move the ones before.
+        Shrub & reserve(stick::Size _childCount);
+
 
         template<class T>
         T value() const
@@ -249,6 +398,79 @@ namespace scrub
 
         ValueHint valueHint() const;
 
+        //false while the children of a lazily parsed node have not been decoded yet.
+        bool isExpanded() const;
+
+        //Replaces the children with _count numbers that are stored packed in one buffer instead of a
+        //child each and makes this a JSONArray. exportJSON and exportXML write them straight from the
+        //buffer, anything that accesses the children unpacks them into JSONInt or JSONDouble children.
+        Shrub & setTypedArray(const stick::Float32 * _values, stick::Size _count);
+
+        Shrub & setTypedArray(const stick::Float64 * _values, stick::Size _count);
+
+        Shrub & setTypedArray(const stick::Int32 * _values, stick::Size _count);
+
+        Shrub & setTypedArray(const stick::Int64 * _values, stick::Size _count);
+
+        //the element type while the children are packed, ArrayType::None otherwise.
+        ArrayType arrayType() const;
+
+        //the packed elements, empty unless they are packed as T.
+        template<class T>
+        Span<const T> typedArray() const
+        {
+            const detail::PackedArray * packed = m_extension ? m_extension->packed : nullptr;
+            if (!packed || packed->type != detail::ArrayTypeOf<T>::value)
+                return Span<const T>();
+            return Span<const T>(static_cast<const T *>(packed->data()), packed->count);
+        }
+
+        template<class T>
+        Span<T> typedArray()
+        {
+            detail::PackedArray * packed = m_extension ? m_extension->packed : nullptr;
+            if (!packed || packed->type != detail::ArrayTypeOf<T>::value)
+                return Span<T>();
+            //the elements can be changed through the span
+            invalidateExportCache();
+            return Span<T>(static_cast<T *>(packed->data()), packed->count);
+        }
+
+        //the text of the packed element at _index, as the serializers write it and unpacking stores it.
+        stick::Size formatTypedElement(stick::Size _index, char (&_buffer)[32]) const;
+
+        //stores _byteCount raw bytes as the value and makes it Binary. The binary formats write them as
+        //byte strings, exportJSON and exportXML as base64.
+        Shrub & setBlob(const void * _data, stick::Size _byteCount);
+
+        //the value bytes, empty unless the value is Binary.
+        ByteSpan blob() const;
+
+        //replaces a base64 value, like the ones parsed from JSON or XML, with the bytes it encodes and
+        //makes it Binary.
+        stick::Error decodeBlob();
+
+        //marks name and value as free of anything JSON needs to escape (quotes, backslashes and control
+        //characters), so exportJSON copies them without scanning. Set by parseJSON, setting the name or
+        //value clears the respective mark.
+        Shrub & setKnownClean(bool _bName, bool _bValue);
+
+        bool isNameKnownClean() const;
+
+        bool isValueKnownClean() const;
+
+        //Exports keep the output of the containers in this subtree and reuse it for the ones that didn't
+        //change since. The setters, append and sort outdate the output of the node they change and its
+        //ancestors. Costs memory for the kept output, disabling releases it.
+        Shrub & setExportCaching(bool _bEnabled);
+
+        bool isExportCaching() const;
+
+        //the cached output for _key or nullptr, used by the serializers.
+        const stick::String * cachedExport(const detail::ExportCacheKey & _key) const;
+
+        const stick::String & storeExport(const detail::ExportCacheKey & _key, stick::String && _bytes) const;
+
         Shrub & sort();
 
         ChildIter begin();
@@ -276,6 +498,53 @@ namespace scrub
 
     private:
 
+        void ensureExpanded() const
+        {
+            if (m_extension && (m_extension->lazySource || m_extension->packed))
+                expand();
+        }
+
+        void expand() const;
+
+        void unpack() const;
+
+        template<class T>
+        Shrub & setPacked(const T * _values, stick::Size _count);
+
+        Shrub & appendChild(Shrub && _child);
+
+        //the extension, allocated if there is none yet
+        detail::ShrubExtension & extension() const;
+
+        //frees the extension once nothing in it is used anymore
+        void trimExtension() const;
+
+        //releases the lazy source and packed elements and disables export caching
+        void clearExtension();
+
+        //copies the lazy source, packed elements and export caching of _other
+        void copyExtension(const Shrub & _other);
+
+        bool isTracked() const;
+
+        //points _child back at this node if it is tracked, stops tracking it otherwise
+        void adoptChild(Shrub & _child);
+
+        //adopts the children after they were moved or copied
+        void adoptChildren();
+
+        //tracks the parents in this subtree, so that changes outdate the caches above them
+        void trackSubtree();
+
+        //updates the tracking after an assignment
+        void retrack();
+
+        void invalidateExportCache();
+
+        //destroys the caches in this subtree and stops tracking the nodes outside of nested caching
+        //subtrees if _bUntrack is set
+        void releaseExportCaches(bool _bUntrack);
+
         const Shrub * resolvePath(const stick::String & _path, char _separator) const;
 
         ChildIter ensureTree(const stick::String & _path, char _separator);
@@ -290,18 +559,155 @@ namespace scrub
         stick::String m_name;
         stick::String m_value;
         ValueHint m_valueHint;
-        ChildArray m_children;
+        bool m_bNameKnownClean;
+        bool m_bValueKnownClean;
+        //mutable so that lazily parsed nodes can be expanded from const accessors
+        mutable ChildArray m_children;
+        //nullptr unless the node is lazy, packed or part of an export caching subtree
+        mutable detail::ShrubExtension * m_extension;
     };
 
     typedef stick::Result<Shrub> ShrubResult;
 
+    //how saveJSON and saveXML write files
+    struct STICK_API SaveOptions
+    {
+        //atomic, synced and compact
+        SaveOptions();
+
+        bool bPrettify;
+        //write to a temporary file that replaces the target once complete, see FileSink
+        bool bAtomic;
+        FileSync sync;
+        //size of the blocks handed to the file
+        stick::Size bufferSize;
+    };
+
+    //controls how parseJSON builds the tree
+    struct STICK_API JSONParseOptions
+    {
+        //builds the same tree as parseJSON without options
+        JSONParseOptions();
+
+        //Stores arrays that only contain numbers packed (see Shrub::setTypedArray), as Int32 if all of
+        //them are integers and as Float64 otherwise. Exports write the doubles in their shortest round
+        //trip form rather than their original spelling.
+        bool bPackNumberArrays;
+    };
+
     STICK_API ShrubResult parseJSON(const stick::String & _json, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseJSON(const stick::String & _json, const JSONParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
     STICK_API ShrubResult loadJSON(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadJSON(const stick::String & _path, const JSONParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
+    //streams the JSON to the file without building the text in memory first.
+    STICK_API stick::Error saveJSON(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+    //validates the whole document but only decodes the top level. Nested objects and arrays stay
+    //unexpanded placeholders until they are first accessed.
+    STICK_API ShrubResult parseJSONLazy(const stick::String & _json, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadJSONLazy(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
     STICK_API stick::TextResult exportJSON(const Shrub & _shrub, bool _bPrettify = false);
+    //streams the JSON to _sink through a fixed size buffer, so the memory use doesn't depend on the size of the output.
+    STICK_API stick::Error exportJSON(const Shrub & _shrub, Sink & _sink, bool _bPrettify = false);
+    //the exact number of bytes exportJSON produces for _shrub.
+    STICK_API stick::Size measureJSON(const Shrub & _shrub, bool _bPrettify = false);
+    //writes the JSON to _buffer without allocating and returns its size. The output only is complete
+    //if that is not larger than _capacity. It is not null terminated.
+    STICK_API stick::Size exportJSONInto(const Shrub & _shrub, char * _buffer, stick::Size _capacity, bool _bPrettify = false);
+    //Identical trees always produce identical bytes, for hashing and signing: object keys sorted by their
+    //UTF-8 bytes (without sorting the tree), no whitespace, integers without leading zeros and doubles in
+    //their shortest round trip form.
+    STICK_API stick::TextResult exportJSONCanonical(const Shrub & _shrub);
+    STICK_API stick::Error exportJSONCanonical(const Shrub & _shrub, Sink & _sink);
+    //produces the same output as exportJSON, splitting the children of a large container into chunks
+    //that are written on _threadCount threads (0 uses one per core). The tree's allocator must be thread safe.
+    //The export cache is neither read nor filled.
+    STICK_API stick::TextResult exportJSONParallel(const Shrub & _shrub, bool _bPrettify = false, stick::Size _threadCount = 0);
+    //hands the chunks to _sink in batches, so only a few of them are held in memory at a time.
+    STICK_API stick::Error exportJSONParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify = false, stick::Size _threadCount = 0);
+
+    //compact binary form of a tree that loads without any text parsing and round trips exactly,
+    //including the value hints (see Scrub/Binary/BinarySerializer.hpp for the layout).
+    STICK_API stick::TextResult exportBinary(const Shrub & _shrub);
+    STICK_API stick::Error exportBinary(const Shrub & _shrub, Sink & _sink);
+    STICK_API ShrubResult parseBinary(const stick::String & _data, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseBinary(const char * _data, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadBinary(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    //SaveOptions::bPrettify doesn't apply.
+    STICK_API stick::Error saveBinary(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+    //fixed layout binary form that is used in place instead of being parsed, see Scrub/MappedView.hpp.
+    STICK_API stick::TextResult exportMappedBinary(const Shrub & _shrub);
+    STICK_API stick::Error exportMappedBinary(const Shrub & _shrub, Sink & _sink);
+    //SaveOptions::bPrettify doesn't apply.
+    STICK_API stick::Error saveMappedBinary(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+
+    //MessagePack, containers become maps or arrays the same way exportJSON decides between objects and
+    //arrays and the JSON hints pick the scalar types. Binary values are bin, values with other hints
+    //strings and empty ones without a hint nil. Parsing sets the matching hints, ext values keep their bytes.
+    STICK_API stick::TextResult exportMsgPack(const Shrub & _shrub);
+    STICK_API stick::Error exportMsgPack(const Shrub & _shrub, Sink & _sink);
+    STICK_API ShrubResult parseMsgPack(const stick::String & _data, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseMsgPack(const char * _data, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadMsgPack(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    //SaveOptions::bPrettify doesn't apply.
+    STICK_API stick::Error saveMsgPack(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+
+    //CBOR (RFC 8949) with the same mapping as MessagePack. Containers are written with definite lengths,
+    //parsing also accepts indefinite ones. Packed arrays are written as typed arrays (RFC 8746) and the
+    //typed arrays of their element types are parsed back packed, other typed arrays become arrays of
+    //numbers and other tags are skipped. See Scrub/CBORReader.hpp to read strings in place without building a tree.
+    STICK_API stick::TextResult exportCBOR(const Shrub & _shrub);
+    STICK_API stick::Error exportCBOR(const Shrub & _shrub, Sink & _sink);
+    STICK_API ShrubResult parseCBOR(const stick::String & _data, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseCBOR(const char * _data, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadCBOR(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    //SaveOptions::bPrettify doesn't apply.
+    STICK_API stick::Error saveCBOR(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+
+    //controls which XML features the parser handles, disabling what a document doesn't use speeds up parsing.
+    struct STICK_API XMLParseOptions
+    {
+        //matches pugixml's defaults, which is what parseXML always used
+        XMLParseOptions();
+
+        //elements, attributes and text only, no conversions of any kind
+        static XMLParseOptions minimal();
+
+        //like minimal but still decodes entities, so values are correct for any well formed document
+        static XMLParseOptions fast();
+
+        //expand character and entity references
+        bool bDecodeEntities;
+        //convert \r\n and \r to \n
+        bool bNormalizeEOL;
+        //replace whitespace characters in attribute values with spaces
+        bool bNormalizeAttributes;
+        //keep CDATA sections as text, they are dropped otherwise
+        bool bKeepCDATA;
+        //add comments as children with the XMLComment hint
+        bool bKeepComments;
+        //add processing instructions as children with the XMLProcessingInstruction hint
+        bool bKeepProcessingInstructions;
+        //keep text that only consists of whitespace
+        bool bKeepWhitespacePCData;
+        //remove leading and trailing whitespace from text
+        bool bTrimPCData;
+    };
 
     STICK_API ShrubResult parseXML(const stick::String & _xml, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseXML(const stick::String & _xml, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
     STICK_API ShrubResult loadXML(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult loadXML(const stick::String & _path, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API stick::Error saveXML(const Shrub & _shrub, const stick::String & _path, const SaveOptions & _options = SaveOptions());
+    //parses _buffer without copying it first, its contents are modified in the process.
+    //Also works on a private (copy on write) memory mapping of a file.
+    STICK_API ShrubResult parseXMLInPlace(char * _buffer, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubResult parseXMLInPlace(char * _buffer, stick::Size _byteCount, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
     STICK_API stick::TextResult exportXML(const Shrub & _shrub, bool _bPrettify = false);
+    //writes the XML straight to _sink, without building a DOM or the whole text first.
+    STICK_API stick::Error exportXML(const Shrub & _shrub, Sink & _sink, bool _bPrettify = false);
+    //the XML counterparts of exportJSONParallel.
+    STICK_API stick::TextResult exportXMLParallel(const Shrub & _shrub, bool _bPrettify = false, stick::Size _threadCount = 0);
+    STICK_API stick::Error exportXMLParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify = false, stick::Size _threadCount = 0);
 }
 
 #endif //SCRUB_SHRUB_HPP
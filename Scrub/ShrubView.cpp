@@ -0,0 +1,339 @@
+#include <Scrub/ShrubView.hpp>
+#include <Scrub/JSON/sajson.h>
+#include <Stick/FileUtilities.hpp>
+#include <atomic>
+#include <cstring>
+#include <new> //for placement new
+
+namespace scrub
+{
+    using namespace stick;
+
+    namespace detail
+    {
+        struct JSONViewDocument
+        {
+            JSONViewDocument(const sajson::mutable_string_view & _input, sajson::document && _document, mem::Block _text, mem::Block _structure, Allocator & _alloc) :
+                input(_input),
+                document(std::move(_document)),
+                text(_text),
+                structure(_structure),
+                referenceCount(0),
+                allocator(&_alloc)
+            {
+
+            }
+
+            //sajson::document keeps the text private, the children need it to locate keys and strings
+            sajson::mutable_string_view input;
+            sajson::document document;
+            //the copy of the text that sajson parsed in place and its structure buffer
+            mem::Block text;
+            mem::Block structure;
+            std::atomic<Size> referenceCount;
+            Allocator * allocator;
+        };
+
+        static void retain(JSONViewDocument * _doc)
+        {
+            if (_doc)
+                ++_doc->referenceCount;
+        }
+
+        static void release(JSONViewDocument * _doc)
+        {
+            if (_doc && --_doc->referenceCount == 0)
+            {
+                Allocator * alloc = _doc->allocator;
+                mem::Block text = _doc->text;
+                mem::Block structure = _doc->structure;
+                _doc->~JSONViewDocument();
+                alloc->deallocate({_doc, sizeof(JSONViewDocument)});
+                alloc->deallocate(structure);
+                alloc->deallocate(text);
+            }
+        }
+    }
+
+    static sajson::value toSajson(const detail::JSONViewDocument * _doc, const Size * _payload, UInt8 _type)
+    {
+        return sajson::value(static_cast<sajson::type>(_type), _payload, _doc->input.get_data());
+    }
+
+    ShrubView::ChildIter::ChildIter(const ShrubView & _parent, Size _index) :
+        m_parent(_parent),
+        m_index(_index)
+    {
+
+    }
+
+    ShrubView ShrubView::ChildIter::operator * () const
+    {
+        return m_parent[m_index];
+    }
+
+    ShrubView::ChildIter & ShrubView::ChildIter::operator ++ ()
+    {
+        ++m_index;
+        return *this;
+    }
+
+    bool ShrubView::ChildIter::operator == (const ChildIter & _other) const
+    {
+        return m_parent.m_payload == _other.m_parent.m_payload && m_index == _other.m_index;
+    }
+
+    bool ShrubView::ChildIter::operator != (const ChildIter & _other) const
+    {
+        return !(*this == _other);
+    }
+
+    ShrubView::ShrubView() :
+        m_document(nullptr),
+        m_payload(nullptr),
+        m_type(sajson::TYPE_NULL),
+        m_name(""),
+        m_nameLength(0)
+    {
+
+    }
+
+    ShrubView::ShrubView(detail::JSONViewDocument * _document, const Size * _payload, UInt8 _type, const char * _name, Size _nameLength) :
+        m_document(_document),
+        m_payload(_payload),
+        m_type(_type),
+        m_name(_name),
+        m_nameLength(_nameLength)
+    {
+        detail::retain(m_document);
+    }
+
+    ShrubView::ShrubView(const ShrubView & _other) :
+        m_document(_other.m_document),
+        m_payload(_other.m_payload),
+        m_type(_other.m_type),
+        m_name(_other.m_name),
+        m_nameLength(_other.m_nameLength)
+    {
+        detail::retain(m_document);
+    }
+
+    ShrubView::ShrubView(ShrubView && _other) :
+        m_document(_other.m_document),
+        m_payload(_other.m_payload),
+        m_type(_other.m_type),
+        m_name(_other.m_name),
+        m_nameLength(_other.m_nameLength)
+    {
+        _other.m_document = nullptr;
+    }
+
+    ShrubView::~ShrubView()
+    {
+        detail::release(m_document);
+    }
+
+    ShrubView & ShrubView::operator = (const ShrubView & _other)
+    {
+        detail::retain(_other.m_document);
+        detail::release(m_document);
+        m_document = _other.m_document;
+        m_payload = _other.m_payload;
+        m_type = _other.m_type;
+        m_name = _other.m_name;
+        m_nameLength = _other.m_nameLength;
+        return *this;
+    }
+
+    ShrubView & ShrubView::operator = (ShrubView && _other)
+    {
+        if (this != &_other)
+        {
+            detail::release(m_document);
+            m_document = _other.m_document;
+            m_payload = _other.m_payload;
+            m_type = _other.m_type;
+            m_name = _other.m_name;
+            m_nameLength = _other.m_nameLength;
+            _other.m_document = nullptr;
+        }
+        return *this;
+    }
+
+    //children are located in the structure buffer the same way sajson does it, as a sajson::value
+    //would only hand out values that don't keep the document alive
+    static ShrubView childAt(detail::JSONViewDocument * _doc, const Size * _payload, UInt8 _type, Size _index)
+    {
+        if (_type == sajson::TYPE_OBJECT)
+        {
+            const Size * record = _payload + 1 + _index * 3;
+            const char * text = _doc->input.get_data();
+            return ShrubView(_doc, _payload + sajson::get_element_value(record[2]), sajson::get_element_type(record[2]),
+                             text + record[0], record[1] - record[0]);
+        }
+        Size element = _payload[1 + _index];
+        return ShrubView(_doc, _payload + sajson::get_element_value(element), sajson::get_element_type(element), "", 0);
+    }
+
+    Maybe<ShrubView> ShrubView::child(const String & _path, char _separator) const
+    {
+        if (!m_document)
+            return Maybe<ShrubView>();
+
+        //walk the path segments in place, sajson sorts object keys so every lookup is a binary search
+        const Size * payload = m_payload;
+        UInt8 type = m_type;
+        const char * segment = _path.cString();
+        const char * pathEnd = segment + _path.length();
+        while (true)
+        {
+            if (type != sajson::TYPE_OBJECT)
+                return Maybe<ShrubView>();
+
+            const char * segmentEnd = segment;
+            while (segmentEnd != pathEnd && *segmentEnd != _separator) ++segmentEnd;
+
+            Size idx = toSajson(m_document, payload, type).find_object_key(sajson::string(segment, segmentEnd - segment));
+            if (idx == payload[0])
+                return Maybe<ShrubView>();
+
+            Size element = payload[3 + idx * 3];
+            if (segmentEnd == pathEnd)
+                return childAt(m_document, payload, type, idx);
+
+            payload = payload + sajson::get_element_value(element);
+            type = sajson::get_element_type(element);
+            segment = segmentEnd + 1;
+        }
+    }
+
+    StringSpan ShrubView::name() const
+    {
+        return StringSpan(m_name, m_nameLength);
+    }
+
+    StringSpan ShrubView::stringValue() const
+    {
+        if (m_type == sajson::TYPE_STRING)
+        {
+            const char * text = m_document->input.get_data();
+            return StringSpan(text + m_payload[0], m_payload[1] - m_payload[0]);
+        }
+        else if (m_type == sajson::TYPE_TRUE)
+        {
+            return StringSpan("true", 4);
+        }
+        else if (m_type == sajson::TYPE_FALSE)
+        {
+            return StringSpan("false", 5);
+        }
+        return StringSpan();
+    }
+
+    ValueHint ShrubView::valueHint() const
+    {
+        switch (m_type)
+        {
+        case sajson::TYPE_INTEGER:
+            return ValueHint::JSONInt;
+        case sajson::TYPE_DOUBLE:
+            return ValueHint::JSONDouble;
+        case sajson::TYPE_TRUE:
+        case sajson::TYPE_FALSE:
+            return ValueHint::JSONBool;
+        case sajson::TYPE_STRING:
+            return ValueHint::JSONString;
+        case sajson::TYPE_ARRAY:
+            return ValueHint::JSONArray;
+        case sajson::TYPE_OBJECT:
+            return ValueHint::JSONObject;
+        default:
+            return ValueHint::None;
+        }
+    }
+
+    bool ShrubView::isValid() const
+    {
+        return m_document != nullptr;
+    }
+
+    bool ShrubView::isNumber() const
+    {
+        return m_type == sajson::TYPE_INTEGER || m_type == sajson::TYPE_DOUBLE;
+    }
+
+    Float64 ShrubView::numberValue() const
+    {
+        if (!isNumber())
+            return 0.0;
+        return toSajson(m_document, m_payload, m_type).get_number_value();
+    }
+
+    ShrubView::ChildIter ShrubView::begin() const
+    {
+        return ChildIter(*this, 0);
+    }
+
+    ShrubView::ChildIter ShrubView::end() const
+    {
+        return ChildIter(*this, count());
+    }
+
+    Size ShrubView::count() const
+    {
+        if (m_type == sajson::TYPE_OBJECT || m_type == sajson::TYPE_ARRAY)
+            return m_payload[0];
+        return 0;
+    }
+
+    ShrubView ShrubView::operator [] (Size _index) const
+    {
+        STICK_ASSERT(_index < count());
+        return childAt(m_document, m_payload, m_type, _index);
+    }
+
+    ShrubViewResult parseJSONView(const String & _json, Allocator & _alloc)
+    {
+        //sajson parses in place, the strings of the view point into this copy
+        Size length = _json.length() ? _json.length() : 1;
+        mem::Block text = _alloc.allocate(length, 1);
+        mem::Block structure = _alloc.allocate(length * sizeof(size_t), alignof(size_t));
+        auto block = _alloc.allocate(sizeof(detail::JSONViewDocument), alignof(detail::JSONViewDocument));
+        if (!text.ptr || !structure.ptr || !block.ptr)
+        {
+            if (text.ptr)
+                _alloc.deallocate(text);
+            if (structure.ptr)
+                _alloc.deallocate(structure);
+            if (block.ptr)
+                _alloc.deallocate(block);
+            return Error(ec::BadAlloc, "Failed to allocate the JSON view", STICK_FILE, STICK_LINE);
+        }
+        std::memcpy(text.ptr, _json.cString(), _json.length());
+
+        sajson::mutable_string_view input(_json.length(), static_cast<char *>(text.ptr));
+        sajson::document document = sajson::parser(input, static_cast<size_t *>(structure.ptr), false).get_document();
+        if (!document.is_valid())
+        {
+            Error err(ec::ParseFailed, String::concat("Failed to parse JSON: ", document.get_error_message().c_str()), STICK_FILE, STICK_LINE);
+            _alloc.deallocate(block);
+            _alloc.deallocate(structure);
+            _alloc.deallocate(text);
+            return err;
+        }
+
+        detail::JSONViewDocument * doc = new (block.ptr) detail::JSONViewDocument(input, std::move(document), text, structure, _alloc);
+        sajson::value root = doc->document.get_root();
+        return ShrubView(doc, root.get_payload(), root.get_type(), "", 0);
+    }
+
+    ShrubViewResult loadJSONView(const String & _path, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (result)
+        {
+            return parseJSONView(result.get(), _alloc);
+        }
+        return result.error();
+    }
+}
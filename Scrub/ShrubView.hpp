@@ -0,0 +1,199 @@
+#ifndef SCRUB_SHRUBVIEW_HPP
+#define SCRUB_SHRUBVIEW_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+
+namespace scrub
+{
+    namespace detail
+    {
+        //reference counted owner of a parsed sajson document
+        struct JSONViewDocument;
+
+        template<class T, bool IsArithmetic = std::is_arithmetic<T>::value>
+        struct ViewConverter;
+    }
+
+    //read only view of a parsed JSON document. Navigates the sajson structure buffer
+    //directly, neither the lookups nor the iteration allocate any memory.
+    class STICK_API ShrubView
+    {
+    public:
+
+        class ChildIter;
+
+
+        ShrubView();
+
+        ShrubView(detail::JSONViewDocument * _document, const stick::Size * _payload, stick::UInt8 _type, const char * _name, stick::Size _nameLength);
+
+        ShrubView(const ShrubView & _other);
+
+        ShrubView(ShrubView && _other);
+
+        ~ShrubView();
+
+        ShrubView & operator = (const ShrubView & _other);
+
+        ShrubView & operator = (ShrubView && _other);
+
+        stick::Maybe<ShrubView> child(const stick::String & _path, char _separator = '.') const;
+
+        template<class T>
+        stick::Maybe<T> maybe(const stick::String & _path, char _separator = '.') const
+        {
+            auto desc = child(_path, _separator);
+            if (desc)
+                return (*desc).value<T>();
+            return stick::Maybe<T>();
+        }
+
+        template<class T>
+        T maybe(const stick::String & _path, T _orValue) const
+        {
+            auto m = maybe<T>(_path);
+            if (m)
+                return *m;
+            return _orValue;
+        }
+
+        template<class T>
+        T get(const stick::String & _path, char _separator = '.') const
+        {
+            return maybe<T>(_path, _separator).value();
+        }
+
+        //converts the value, only strings go through an allocation.
+        template<class T>
+        stick::Maybe<T> value() const
+        {
+            return detail::ViewConverter<T>::convert(*this);
+        }
+
+        StringSpan name() const;
+
+        //the unescaped characters of strings, "true" or "false" for booleans and empty otherwise.
+        StringSpan stringValue() const;
+
+        ValueHint valueHint() const;
+
+        bool isValid() const;
+
+        bool isNumber() const;
+
+        stick::Float64 numberValue() const;
+
+        ChildIter begin() const;
+
+        ChildIter end() const;
+
+        stick::Size count() const;
+
+        //the child at _index for both, objects and arrays.
+        ShrubView operator [] (stick::Size _index) const;
+
+    private:
+
+        detail::JSONViewDocument * m_document;
+        const stick::Size * m_payload;
+        stick::UInt8 m_type;
+        const char * m_name;
+        stick::Size m_nameLength;
+    };
+
+    //keeps a copy of its parent and with it the document alive while iterating
+    class STICK_API ShrubView::ChildIter
+    {
+    public:
+
+        ChildIter(const ShrubView & _parent, stick::Size _index);
+
+        ShrubView operator * () const;
+
+        ChildIter & operator ++ ();
+
+        bool operator == (const ChildIter & _other) const;
+
+        bool operator != (const ChildIter & _other) const;
+
+    private:
+
+        ShrubView m_parent;
+        stick::Size m_index;
+    };
+
+    namespace detail
+    {
+        template<class T>
+        struct ViewConverter<T, true>
+        {
+            static stick::Maybe<T> convert(const ShrubView & _view)
+            {
+                if (_view.isNumber())
+                    return static_cast<T>(_view.numberValue());
+                if (_view.valueHint() == ValueHint::JSONBool)
+                    return static_cast<T>(_view.stringValue() == "true");
+                if (_view.valueHint() == ValueHint::JSONString)
+                {
+                    StringSpan str = _view.stringValue();
+                    stick::Maybe<T> ret = stick::detail::convert<T>(stick::String(str.begin(), str.end()));
+                    return ret;
+                }
+                return stick::Maybe<T>();
+            }
+        };
+
+        template<>
+        struct ViewConverter<bool, true>
+        {
+            static stick::Maybe<bool> convert(const ShrubView & _view)
+            {
+                if (_view.valueHint() == ValueHint::JSONBool || _view.valueHint() == ValueHint::JSONString)
+                {
+                    StringSpan str = _view.stringValue();
+                    if (str == "true")
+                        return true;
+                    else if (str == "false")
+                        return false;
+                }
+                return stick::Maybe<bool>();
+            }
+        };
+
+        template<>
+        struct ViewConverter<stick::String, false>
+        {
+            static stick::Maybe<stick::String> convert(const ShrubView & _view)
+            {
+                if (_view.isNumber())
+                {
+                    if (_view.valueHint() == ValueHint::JSONInt)
+                        return stick::toString(static_cast<stick::Int32>(_view.numberValue()));
+                    return stick::toString(_view.numberValue());
+                }
+                StringSpan str = _view.stringValue();
+                return stick::String(str.begin(), str.end());
+            }
+        };
+
+        template<>
+        struct ViewConverter<StringSpan, false>
+        {
+            static stick::Maybe<StringSpan> convert(const ShrubView & _view)
+            {
+                if (_view.valueHint() == ValueHint::JSONString || _view.valueHint() == ValueHint::JSONBool)
+                    return _view.stringValue();
+                return stick::Maybe<StringSpan>();
+            }
+        };
+    }
+
+    typedef stick::Result<ShrubView> ShrubViewResult;
+
+    //the returned view and all views derived from it keep the parsed document alive.
+    STICK_API ShrubViewResult parseJSONView(const stick::String & _json, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API ShrubViewResult loadJSONView(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_SHRUBVIEW_HPP
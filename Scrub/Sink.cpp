@@ -0,0 +1,312 @@
+#include <Scrub/Sink.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+namespace scrub
+{
+    using namespace stick;
+
+    Sink::~Sink()
+    {
+
+    }
+
+    Error Sink::writeVectored(const StringSpan * _blocks, Size _count)
+    {
+        for (Size i = 0; i < _count; ++i)
+        {
+            Error err = write(_blocks[i].ptr(), _blocks[i].count());
+            if (err)
+                return err;
+        }
+        return Error();
+    }
+
+    Error Sink::flush()
+    {
+        return Error();
+    }
+
+    StringSink::StringSink(String & _target) :
+        m_target(&_target)
+    {
+
+    }
+
+    Error StringSink::write(const char * _data, Size _byteCount)
+    {
+        m_target->append(_data, _byteCount);
+        return Error();
+    }
+
+    FileDescriptorSink::FileDescriptorSink(int _fd) :
+        m_fd(_fd)
+    {
+
+    }
+
+    Error FileDescriptorSink::write(const char * _data, Size _byteCount)
+    {
+        while (_byteCount)
+        {
+            ssize_t written = ::write(m_fd, _data, _byteCount);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return Error(ec::InvalidOperation, String::concat("Failed to write: ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+            }
+            _data += written;
+            _byteCount -= written;
+        }
+        return Error();
+    }
+
+    Error FileDescriptorSink::writeVectored(const StringSpan * _blocks, Size _count)
+    {
+        //a handful of blocks at a time is all BufferedSink needs
+        static const Size s_maxBlocks = 16;
+        while (_count)
+        {
+            iovec vecs[s_maxBlocks];
+            Size count = _count < s_maxBlocks ? _count : s_maxBlocks;
+            for (Size i = 0; i < count; ++i)
+            {
+                vecs[i].iov_base = const_cast<char *>(_blocks[i].ptr());
+                vecs[i].iov_len = _blocks[i].count();
+            }
+
+            ssize_t written = ::writev(m_fd, vecs, static_cast<int>(count));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return Error(ec::InvalidOperation, String::concat("Failed to write: ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+            }
+
+            //skip the blocks that were written completely and finish a partially written one
+            Size i = 0;
+            for (; i < count && Size(written) >= vecs[i].iov_len; ++i)
+                written -= vecs[i].iov_len;
+            if (i < count)
+            {
+                Error err = write(static_cast<const char *>(vecs[i].iov_base) + written, vecs[i].iov_len - written);
+                if (err)
+                    return err;
+                ++i;
+            }
+            _blocks += i;
+            _count -= i;
+        }
+        return Error();
+    }
+
+    static Error fileError(const char * _what, const String & _path)
+    {
+        return Error(ec::InvalidOperation, String::concat("Failed to ", _what, " ", _path, ": ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+    }
+
+    //Creates _path with a random suffix. Unlike mkstemp, which only gives the owner access, the
+    //file gets 0666 minus the umask like any other new file.
+    static int createTemporaryFile(const String & _path, String & _outTempPath)
+    {
+        static const char s_characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        static std::atomic<UInt64> s_counter(0);
+        for (Size attempt = 0; attempt < 100; ++attempt)
+        {
+            //splitmix64 of the process, the time and a counter
+            UInt64 seed = (static_cast<UInt64>(::getpid()) << 40) ^ ++s_counter ^
+                          static_cast<UInt64>(std::chrono::steady_clock::now().time_since_epoch().count());
+            seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+            seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+            seed ^= seed >> 31;
+
+            _outTempPath = String::concat(_path, ".XXXXXX");
+            char * suffix = &_outTempPath[_outTempPath.length() - 6];
+            for (Size i = 0; i < 6; ++i, seed /= 62)
+                suffix[i] = s_characters[seed % 62];
+
+            int fd = ::open(_outTempPath.cString(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+            if (fd >= 0 || errno != EEXIST)
+                return fd;
+        }
+        return -1;
+    }
+
+    FileSink::FileSink(FileSync _sync, bool _bAtomic, Allocator & _alloc) :
+        m_sync(_sync),
+        m_bAtomic(_bAtomic),
+        m_path(_alloc),
+        m_tempPath(_alloc),
+        m_fd(-1),
+        m_sink(-1)
+    {
+
+    }
+
+    FileSink::~FileSink()
+    {
+        discard();
+    }
+
+    Error FileSink::open(const String & _path)
+    {
+        discard();
+        m_path = _path;
+        if (m_bAtomic)
+        {
+            //next to the target, rename is only atomic within one file system
+            m_fd = createTemporaryFile(_path, m_tempPath);
+            if (m_fd < 0)
+                return fileError("create a temporary file for", _path);
+
+            //keep the mode of the file that is replaced
+            struct stat st;
+            if (::stat(_path.cString(), &st) == 0 && ::fchmod(m_fd, st.st_mode & 07777) != 0)
+            {
+                Error err = fileError("keep the mode of", _path);
+                discard();
+                return err;
+            }
+        }
+        else
+        {
+            m_fd = ::open(_path.cString(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (m_fd < 0)
+                return fileError("open", _path);
+        }
+        m_sink = FileDescriptorSink(m_fd);
+        return Error();
+    }
+
+    Error FileSink::write(const char * _data, Size _byteCount)
+    {
+        return m_sink.write(_data, _byteCount);
+    }
+
+    Error FileSink::writeVectored(const StringSpan * _blocks, Size _count)
+    {
+        return m_sink.writeVectored(_blocks, _count);
+    }
+
+    Error FileSink::commit()
+    {
+        if (m_fd < 0)
+            return Error(ec::InvalidOperation, "No file is open", STICK_FILE, STICK_LINE);
+
+        Error err;
+        if (m_sync != FileSync::None && ::fsync(m_fd) != 0)
+            err = fileError("sync", m_path);
+        if (::close(m_fd) != 0 && !err)
+            err = fileError("close", m_path);
+        m_fd = -1;
+        if (!err && m_bAtomic && ::rename(m_tempPath.cString(), m_path.cString()) != 0)
+            err = fileError("replace", m_path);
+        if (err)
+        {
+            if (m_bAtomic)
+                ::unlink(m_tempPath.cString());
+            return err;
+        }
+
+        if (m_sync == FileSync::FileAndDirectory)
+        {
+            auto idx = m_path.rfindIndex('/');
+            String dir = idx == String::InvalidIndex ? String(".") : (idx ? m_path.sub(0, idx) : String("/"));
+            int dirFd = ::open(dir.cString(), O_RDONLY);
+            if (dirFd < 0)
+                return fileError("open the directory of", m_path);
+            if (::fsync(dirFd) != 0)
+                err = fileError("sync the directory of", m_path);
+            ::close(dirFd);
+        }
+        return err;
+    }
+
+    void FileSink::discard()
+    {
+        if (m_fd < 0)
+            return;
+        ::close(m_fd);
+        m_fd = -1;
+        //without a temporary file the target is written in place, it isn't this sink's to remove
+        if (m_bAtomic)
+            ::unlink(m_tempPath.cString());
+    }
+
+    CallbackSink::CallbackSink(Callback _callback, void * _userData) :
+        m_callback(_callback),
+        m_userData(_userData)
+    {
+
+    }
+
+    Error CallbackSink::write(const char * _data, Size _byteCount)
+    {
+        return m_callback(_data, _byteCount, m_userData);
+    }
+
+    BufferedSink::BufferedSink(Sink & _target, Size _bufferSize, Allocator & _alloc) :
+        m_target(&_target),
+        m_buffer(_alloc),
+        m_end(0)
+    {
+        m_buffer.resize(_bufferSize ? _bufferSize : 1);
+    }
+
+    Error BufferedSink::write(const char * _data, Size _byteCount)
+    {
+        append(_data, _byteCount);
+        return m_error;
+    }
+
+    Error BufferedSink::flush()
+    {
+        flushBuffer();
+        if (!m_error)
+            m_error = m_target->flush();
+        return m_error;
+    }
+
+    const Error & BufferedSink::error() const
+    {
+        return m_error;
+    }
+
+    void BufferedSink::appendSlow(const char * _data, Size _byteCount)
+    {
+        //large blocks go straight to the target, together with what is buffered
+        if (_byteCount >= m_buffer.count())
+        {
+            if (!m_error)
+            {
+                StringSpan blocks[2] = {StringSpan(&m_buffer[0], m_end), StringSpan(_data, _byteCount)};
+                m_error = m_end ? m_target->writeVectored(blocks, 2) : m_target->write(_data, _byteCount);
+            }
+            m_end = 0;
+            return;
+        }
+
+        Size space = m_buffer.count() - m_end;
+        std::memcpy(&m_buffer[0] + m_end, _data, space);
+        m_end += space;
+        _data += space;
+        _byteCount -= space;
+        flushBuffer();
+        std::memcpy(&m_buffer[0], _data, _byteCount);
+        m_end = _byteCount;
+    }
+
+    void BufferedSink::flushBuffer()
+    {
+        if (m_end && !m_error)
+            m_error = m_target->write(&m_buffer[0], m_end);
+        m_end = 0;
+    }
+}
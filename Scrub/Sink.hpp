@@ -0,0 +1,275 @@
+#ifndef SCRUB_SINK_HPP
+#define SCRUB_SINK_HPP
+
+#include <Scrub/Span.hpp>
+#include <Stick/DynamicArray.hpp>
+#include <Stick/Error.hpp>
+
+#include <cstring>
+
+namespace scrub
+{
+    //destination of the streaming exporters
+    class STICK_API Sink
+    {
+    public:
+
+        virtual ~Sink();
+
+        virtual stick::Error write(const char * _data, stick::Size _byteCount) = 0;
+
+        //writes several blocks at once, in order. Calls write for each block by default.
+        virtual stick::Error writeVectored(const StringSpan * _blocks, stick::Size _count);
+
+        //pushes anything held back to the destination.
+        virtual stick::Error flush();
+    };
+
+    //appends to a String
+    class STICK_API StringSink : public Sink
+    {
+    public:
+
+        StringSink(stick::String & _target);
+
+        stick::Error write(const char * _data, stick::Size _byteCount) override;
+
+    private:
+
+        stick::String * m_target;
+    };
+
+    //writes to a file descriptor, retrying partial and interrupted writes. Does not take ownership of _fd.
+    //Vectored writes use a single writev call.
+    class STICK_API FileDescriptorSink : public Sink
+    {
+    public:
+
+        FileDescriptorSink(int _fd);
+
+        stick::Error write(const char * _data, stick::Size _byteCount) override;
+
+        stick::Error writeVectored(const StringSpan * _blocks, stick::Size _count) override;
+
+    private:
+
+        int m_fd;
+    };
+
+    //how much of a finished file is forced to disk before it's considered saved
+    STICK_API_ENUM_CLASS(FileSync)
+    {
+        //leave it to the OS
+        None,
+        //fsync the file's data before it replaces the target
+        File,
+        //also fsync the directory, so the rename itself survives a crash
+        FileAndDirectory
+    };
+
+    //Writes a file. If atomic, the data goes to a temporary file next to _path that only replaces the
+    //target on commit, so the target always has either its old or its complete new content. A temporary
+    //file that wasn't committed is removed on destruction, a file written in place is only closed.
+    class STICK_API FileSink : public Sink
+    {
+    public:
+
+        FileSink(FileSync _sync = FileSync::File, bool _bAtomic = true, stick::Allocator & _alloc = stick::defaultAllocator());
+
+        ~FileSink();
+
+        stick::Error open(const stick::String & _path);
+
+        stick::Error write(const char * _data, stick::Size _byteCount) override;
+
+        stick::Error writeVectored(const StringSpan * _blocks, stick::Size _count) override;
+
+        //syncs according to the policy, closes the file and moves it into place.
+        stick::Error commit();
+
+    private:
+
+        void discard();
+
+
+        FileSync m_sync;
+        bool m_bAtomic;
+        stick::String m_path;
+        stick::String m_tempPath;
+        int m_fd;
+        FileDescriptorSink m_sink;
+    };
+
+    //hands every write to a function, _userData is passed through.
+    class STICK_API CallbackSink : public Sink
+    {
+    public:
+
+        typedef stick::Error (*Callback)(const char * _data, stick::Size _byteCount, void * _userData);
+
+
+        CallbackSink(Callback _callback, void * _userData = nullptr);
+
+        stick::Error write(const char * _data, stick::Size _byteCount) override;
+
+    private:
+
+        Callback m_callback;
+        void * m_userData;
+    };
+
+    //collects small writes in a fixed size buffer and forwards them to _target in blocks. Writes that
+    //don't fit into the buffer are passed on together with the buffered data in one vectored write
+    //rather than being copied. The first error is kept and everything after it dropped, so writers
+    //only need to check flush(). Data that wasn't flushed yet is discarded on destruction.
+    class STICK_API BufferedSink : public Sink
+    {
+    public:
+
+        BufferedSink(Sink & _target, stick::Size _bufferSize = 64 * 1024, stick::Allocator & _alloc = stick::defaultAllocator());
+
+        stick::Error write(const char * _data, stick::Size _byteCount) override;
+
+        stick::Error flush() override;
+
+        void append(const char * _data, stick::Size _byteCount)
+        {
+            if (m_end + _byteCount <= m_buffer.count())
+            {
+                std::memcpy(&m_buffer[0] + m_end, _data, _byteCount);
+                m_end += _byteCount;
+            }
+            else
+            {
+                appendSlow(_data, _byteCount);
+            }
+        }
+
+        void append(const char * _str)
+        {
+            append(_str, std::strlen(_str));
+        }
+
+        void append(const stick::String & _str)
+        {
+            append(_str.cString(), _str.length());
+        }
+
+        void append(char _c)
+        {
+            if (m_end == m_buffer.count())
+                flushBuffer();
+            m_buffer[m_end++] = _c;
+        }
+
+        void append(char _c, stick::Size _count)
+        {
+            for (stick::Size i = 0; i < _count; ++i)
+                append(_c);
+        }
+
+        const stick::Error & error() const;
+
+    private:
+
+        void appendSlow(const char * _data, stick::Size _byteCount);
+
+        void flushBuffer();
+
+
+        Sink * m_target;
+        stick::DynamicArray<char> m_buffer;
+        stick::Size m_end;
+        stick::Error m_error;
+    };
+
+    //writes into a caller provided buffer with the append interface of BufferedSink. Counts everything
+    //that didn't fit, so with a capacity of zero it measures the output instead.
+    struct BoundedWriter
+    {
+        BoundedWriter(char * _buffer, stick::Size _capacity) :
+            buffer(_buffer),
+            capacity(_capacity),
+            count(0)
+        {
+
+        }
+
+        void append(const char * _data, stick::Size _byteCount)
+        {
+            if (_byteCount && count + _byteCount <= capacity)
+                std::memcpy(buffer + count, _data, _byteCount);
+            count += _byteCount;
+        }
+
+        void append(const char * _str)
+        {
+            append(_str, std::strlen(_str));
+        }
+
+        void append(const stick::String & _str)
+        {
+            append(_str.cString(), _str.length());
+        }
+
+        void append(char _c)
+        {
+            if (count < capacity)
+                buffer[count] = _c;
+            ++count;
+        }
+
+        void append(char _c, stick::Size _count)
+        {
+            if (_count && count + _count <= capacity)
+                std::memset(buffer + count, _c, _count);
+            count += _count;
+        }
+
+        char * buffer;
+        stick::Size capacity;
+        stick::Size count;
+    };
+
+    //appends to a String with the append interface of BufferedSink
+    struct StringWriter
+    {
+        StringWriter(stick::String & _target) :
+            target(&_target)
+        {
+
+        }
+
+        void append(const char * _data, stick::Size _byteCount)
+        {
+            target->append(_data, _byteCount);
+        }
+
+        void append(const char * _str)
+        {
+            append(_str, std::strlen(_str));
+        }
+
+        void append(const stick::String & _str)
+        {
+            append(_str.cString(), _str.length());
+        }
+
+        void append(char _c)
+        {
+            target->append(_c);
+        }
+
+        void append(char _c, stick::Size _count)
+        {
+            stick::Size length = target->length();
+            target->resize(length + _count);
+            if (_count)
+                std::memset(&(*target)[0] + length, _c, _count);
+        }
+
+        stick::String * target;
+    };
+}
+
+#endif //SCRUB_SINK_HPP
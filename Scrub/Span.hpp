@@ -0,0 +1,101 @@
+#ifndef SCRUB_SPAN_HPP
+#define SCRUB_SPAN_HPP
+
+#include <Stick/String.hpp>
+
+#include <cstring>
+
+namespace scrub
+{
+    //non owning view of a contiguous range of elements
+    template<class T>
+    class Span
+    {
+    public:
+
+        typedef T ValueType;
+        typedef T * Iter;
+
+
+        Span() :
+            m_ptr(nullptr),
+            m_count(0)
+        {
+
+        }
+
+        Span(T * _ptr, stick::Size _count) :
+            m_ptr(_ptr),
+            m_count(_count)
+        {
+
+        }
+
+        T * ptr() const
+        {
+            return m_ptr;
+        }
+
+        stick::Size count() const
+        {
+            return m_count;
+        }
+
+        stick::Size byteCount() const
+        {
+            return m_count * sizeof(T);
+        }
+
+        Iter begin() const
+        {
+            return m_ptr;
+        }
+
+        Iter end() const
+        {
+            return m_ptr + m_count;
+        }
+
+        T & operator [] (stick::Size _index) const
+        {
+            STICK_ASSERT(_index < m_count);
+            return m_ptr[_index];
+        }
+
+    private:
+
+        T * m_ptr;
+        stick::Size m_count;
+    };
+
+    typedef Span<const char> StringSpan;
+
+    typedef Span<const stick::UInt8> ByteSpan;
+
+    inline bool operator == (const StringSpan & _a, const StringSpan & _b)
+    {
+        return _a.count() == _b.count() && std::memcmp(_a.ptr(), _b.ptr(), _a.count()) == 0;
+    }
+
+    inline bool operator == (const StringSpan & _a, const char * _b)
+    {
+        return _a == StringSpan(_b, std::strlen(_b));
+    }
+
+    inline bool operator == (const StringSpan & _a, const stick::String & _b)
+    {
+        return _a == StringSpan(_b.cString(), _b.length());
+    }
+
+    inline bool operator != (const StringSpan & _a, const char * _b)
+    {
+        return !(_a == _b);
+    }
+
+    inline bool operator != (const StringSpan & _a, const stick::String & _b)
+    {
+        return !(_a == _b);
+    }
+}
+
+#endif //SCRUB_SPAN_HPP
@@ -1,114 +1,617 @@
 #include <Scrub/XML/XMLSerializer.hpp>
 #include <Scrub/XML/pugixml.hpp>
+#include <Scrub/Parallel.hpp>
+#include <Scrub/Base64.hpp>
+#include <cstddef> //for std::max_align_t
 
 namespace scrub
 {
     namespace xml
     {
+        struct PugiBlockHeader
+        {
+            Allocator * allocator;
+            Size byteCount;
+        };
+
+        //keeps the memory handed to pugi aligned like malloc would
+        static const Size s_pugiHeaderSize = (sizeof(PugiBlockHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        static thread_local Allocator * s_pugiAllocator = nullptr;
+
+        static void * pugiAllocate(size_t _byteCount)
+        {
+            Allocator * alloc = s_pugiAllocator ? s_pugiAllocator : &defaultAllocator();
+            auto block = alloc->allocate(_byteCount + s_pugiHeaderSize, alignof(std::max_align_t));
+            if (!block.ptr)
+                return nullptr;
+            PugiBlockHeader * header = static_cast<PugiBlockHeader *>(block.ptr);
+            header->allocator = alloc;
+            header->byteCount = block.byteCount;
+            return static_cast<char *>(block.ptr) + s_pugiHeaderSize;
+        }
+
+        static void pugiDeallocate(void * _ptr)
+        {
+            if (!_ptr)
+                return;
+            PugiBlockHeader * header = reinterpret_cast<PugiBlockHeader *>(static_cast<char *>(_ptr) - s_pugiHeaderSize);
+            header->allocator->deallocate({header, header->byteCount});
+        }
+
+        //installed before main so that no pugi memory can come from anywhere else
+        struct PugiMemoryHooks
+        {
+            PugiMemoryHooks()
+            {
+                pugi::set_memory_management_functions(pugiAllocate, pugiDeallocate);
+            }
+        };
+
+        static PugiMemoryHooks s_pugiMemoryHooks;
+
+        ScopedPugiAllocator::ScopedPugiAllocator(Allocator & _alloc) :
+            m_previous(s_pugiAllocator)
+        {
+            s_pugiAllocator = &_alloc;
+        }
+
+        ScopedPugiAllocator::~ScopedPugiAllocator()
+        {
+            s_pugiAllocator = m_previous;
+        }
+
+        //CDATA sections are text like any other, pugi only keeps them with parse_cdata
+        static bool isText(pugi::xml_node _node)
+        {
+            return _node.type() == pugi::node_pcdata || _node.type() == pugi::node_cdata;
+        }
+
         static void parseXMLNode(pugi::xml_node _node, Shrub & _shrub, Allocator & _alloc)
         {
-            _shrub.setName(_node.name());
+            _shrub.setName(String(_node.name(), _alloc));
             _shrub.setValueHint(ValueHint::None);
 
+            //text after the value of an element is an unnamed child
+            if (isText(_node))
+            {
+                _shrub.setValue(String(_node.value(), _alloc));
+                return;
+            }
+
             //add the nodes attributes as children
             for (pugi::xml_attribute_iterator ait = _node.attributes_begin(); ait != _node.attributes_end(); ++ait)
             {
-                _shrub.append(Shrub((*ait).name(), (*ait).value(), ValueHint::XMLAttribute, _alloc));
+                _shrub.append(Shrub(String((*ait).name(), _alloc), String((*ait).value(), _alloc), ValueHint::XMLAttribute, _alloc));
             }
 
             for (pugi::xml_node xmlchild = _node.first_child(); xmlchild; xmlchild = xmlchild.next_sibling())
             {
-                if (xmlchild.type() == pugi::node_element || (xmlchild.type() == pugi::node_pcdata && _shrub.valueString().length()))
+                if (xmlchild.type() == pugi::node_comment)
+                {
+                    _shrub.append(Shrub(String(_alloc), String(xmlchild.value(), _alloc), ValueHint::XMLComment, _alloc));
+                }
+                else if (xmlchild.type() == pugi::node_pi)
+                {
+                    _shrub.append(Shrub(String(xmlchild.name(), _alloc), String(xmlchild.value(), _alloc), ValueHint::XMLProcessingInstruction, _alloc));
+                }
+                else if (xmlchild.type() == pugi::node_element || (isText(xmlchild) && _shrub.valueString().length()))
                 {
                     Shrub child(_alloc);
                     parseXMLNode(xmlchild, child, _alloc);
-                    _shrub.append(child);
+                    _shrub.append(std::move(child));
                 }
-                else if (xmlchild.type() == pugi::node_pcdata)
+                else if (isText(xmlchild))
                 {
-                    _shrub.setValue(xmlchild.value());
+                    _shrub.setValue(String(xmlchild.value(), _alloc));
                 }
             }
         }
 
-        ShrubResult parseXML(const String & _xml, Allocator & _alloc)
+        static ShrubResult toShrub(const pugi::xml_document & _doc, const pugi::xml_parse_result & _result, Allocator & _alloc)
         {
-            //use pugi xml to parse the xml
-            pugi::xml_document doc;
-            pugi::xml_parse_result result = doc.load(_xml.cString());
-
-            if (result)
+            if (_result)
             {
                 //recursively parse the DOM
-                Shrub ret;
-                parseXMLNode(doc.first_child(), ret, _alloc);
+                Shrub ret(_alloc);
+                parseXMLNode(_doc.document_element(), ret, _alloc);
                 return ret;
             }
             else
             {
-                return Error(ec::ParseFailed, String::concat("Failed to parse XML: ", result.description()), STICK_FILE, STICK_LINE);
+                return Error(ec::ParseFailed, String::concat("Failed to parse XML: ", _result.description()), STICK_FILE, STICK_LINE);
             }
         }
 
-        static void createXMLNode(pugi::xml_node _parent, const Shrub & _shrub)
+        unsigned int pugiParseFlags(const XMLParseOptions & _options)
+        {
+            unsigned int ret = pugi::parse_minimal;
+            if (_options.bDecodeEntities)
+                ret |= pugi::parse_escapes;
+            if (_options.bNormalizeEOL)
+                ret |= pugi::parse_eol;
+            if (_options.bNormalizeAttributes)
+                ret |= pugi::parse_wconv_attribute;
+            if (_options.bKeepCDATA)
+                ret |= pugi::parse_cdata;
+            if (_options.bKeepComments)
+                ret |= pugi::parse_comments;
+            if (_options.bKeepProcessingInstructions)
+                ret |= pugi::parse_pi;
+            if (_options.bKeepWhitespacePCData)
+                ret |= pugi::parse_ws_pcdata;
+            if (_options.bTrimPCData)
+                ret |= pugi::parse_trim_pcdata;
+            return ret;
+        }
+
+        ShrubResult parseXML(const String & _xml, const XMLParseOptions & _options, Allocator & _alloc)
+        {
+            //use pugi xml to parse the xml
+            ScopedPugiAllocator pugiAlloc(_alloc);
+            pugi::xml_document doc;
+            pugi::xml_parse_result result = doc.load(_xml.cString(), pugiParseFlags(_options));
+            return toShrub(doc, result, _alloc);
+        }
+
+        ShrubResult parseXMLInPlace(char * _buffer, Size _byteCount, const XMLParseOptions & _options, Allocator & _alloc)
         {
-            pugi::xml_node child = _parent.append_child();
+            //pugi parses directly in _buffer rather than copying it first
+            ScopedPugiAllocator pugiAlloc(_alloc);
+            pugi::xml_document doc;
+            pugi::xml_parse_result result = doc.load_buffer_inplace(_buffer, _byteCount, pugiParseFlags(_options));
+            return toShrub(doc, result, _alloc);
+        }
 
-            if (_shrub.name().length())
+        //escapes what XML doesn't allow verbatim, copying runs of clean characters in one go
+        template<class W>
+        static void writeEscaped(W & _sink, const String & _str, bool _bAttribute)
+        {
+            const char * it = _str.cString();
+            const char * end = it + _str.length();
+            const char * clean = it;
+            for (; it != end; ++it)
             {
-                child.set_name(_shrub.name().cString());
+                unsigned char c = static_cast<unsigned char>(*it);
+                const char * escaped = nullptr;
+                if (c == '&')
+                    escaped = "&amp;";
+                else if (c == '<')
+                    escaped = "&lt;";
+                else if (c == '>')
+                    escaped = "&gt;";
+                else if (c == '"' && _bAttribute)
+                    escaped = "&quot;";
+                else if (c >= 32 || (!_bAttribute && (c == '\t' || c == '\n' || c == '\r')))
+                    continue;
+
+                _sink.append(clean, it - clean);
+                clean = it + 1;
+                if (escaped)
+                {
+                    _sink.append(escaped);
+                }
+                else
+                {
+                    //control characters and whitespace in attributes as character references
+                    char ref[8];
+                    ref[0] = '&';
+                    ref[1] = '#';
+                    Size len = 2;
+                    if (c >= 10)
+                        ref[len++] = static_cast<char>('0' + c / 10);
+                    ref[len++] = static_cast<char>('0' + c % 10);
+                    ref[len++] = ';';
+                    _sink.append(ref, len);
+                }
             }
-            else if (_parent)
+            _sink.append(clean, end - clean);
+        }
+
+        //the text of an element, Binary values as base64 which never needs escaping
+        template<class W>
+        static void writeText(W & _sink, const Shrub & _shrub)
+        {
+            if (_shrub.valueHint() != ValueHint::Binary)
             {
-                child.set_name(String::concat(_parent.name(), "Child").cString());
+                writeEscaped(_sink, _shrub.valueString(), false);
+                return;
+            }
+
+            writeBase64(_sink, _shrub.valueString().cString(), _shrub.valueString().length());
+        }
+
+        //unnamed nodes are named after their parent with a "Child" suffix per level, an unnamed root
+        //is "Child". The suffixes are written on the fly rather than concatenating a new name for
+        //every node.
+        struct XMLName
+        {
+            const String * base;
+            Size childSuffixCount;
+        };
+
+        template<class W>
+        static void writeName(W & _sink, const XMLName & _name)
+        {
+            _sink.append(*_name.base);
+            for (Size i = 0; i < _name.childSuffixCount; ++i)
+                _sink.append("Child", 5);
+        }
+
+        static bool isXMLElement(const Shrub & _shrub)
+        {
+            return _shrub.valueHint() != ValueHint::XMLAttribute && _shrub.valueHint() != ValueHint::XMLComment &&
+                   _shrub.valueHint() != ValueHint::XMLProcessingInstruction;
+        }
+
+        //the element whose children a parallel export writes separately, with the name and depth
+        //they are written with and where they go in the output.
+        struct XMLSplitPoint
+        {
+            const Shrub * node;
+            XMLName name;
+            Size depth;
+            bool bPrettify;
+            Size offset;
+        };
+
+        //only exports into memory are split
+        static Size writtenCount(const BoundedWriter & _out)
+        {
+            return _out.count;
+        }
+
+        template<class W>
+        static Size writtenCount(const W &)
+        {
+            return 0;
+        }
+
+        //comments can't contain "--" or end with "-", a space is written after such a dash like pugixml does
+        template<class W>
+        static void writeCommentText(W & _sink, const String & _str)
+        {
+            const char * it = _str.cString();
+            const char * end = it + _str.length();
+            const char * clean = it;
+            for (; it != end; ++it)
+            {
+                if (*it == '-' && (it + 1 == end || it[1] == '-'))
+                {
+                    _sink.append(clean, it + 1 - clean);
+                    _sink.append(' ');
+                    clean = it + 1;
+                }
+            }
+            _sink.append(clean, end - clean);
+        }
+
+        //"?>" would end a processing instruction early and is written as "? >" like pugixml does
+        template<class W>
+        static void writeProcessingInstructionText(W & _sink, const String & _str)
+        {
+            const char * it = _str.cString();
+            const char * end = it + _str.length();
+            const char * clean = it;
+            for (; it != end; ++it)
+            {
+                if (*it == '?' && it + 1 != end && it[1] == '>')
+                {
+                    _sink.append(clean, it + 1 - clean);
+                    _sink.append(' ');
+                    clean = it + 1;
+                }
+            }
+            _sink.append(clean, end - clean);
+        }
+
+        //cached output is only kept this deep, which bounds the recursion of writing it
+        static const Size s_maxCachedDepth = 32;
+
+        template<class W>
+        static void writeXMLNode(W & _sink, const Shrub & _shrub, const XMLName & _name, Size _depth, bool _bPrettify, bool _bCaching, XMLSplitPoint * _split);
+
+        //writes a child of an element at _depth, named after _parentName if it doesn't have a name
+        template<class W>
+        static void writeXMLChild(W & _sink, const Shrub & _child, const XMLName & _parentName, Size _depth, bool _bPrettify, bool _bCaching, XMLSplitPoint * _split)
+        {
+            if (isXMLElement(_child))
+            {
+                XMLName name = _child.name().length() ? XMLName{&_child.name(), 0} : XMLName{_parentName.base, _parentName.childSuffixCount + 1};
+                writeXMLNode(_sink, _child, name, _depth + 1, _bPrettify, _bCaching, _split);
+                return;
+            }
+
+            if (_bPrettify)
+                _sink.append(' ', (_depth + 1) * 4);
+            if (_child.valueHint() == ValueHint::XMLComment)
+            {
+                _sink.append("<!--", 4);
+                writeCommentText(_sink, _child.valueString());
+                _sink.append("-->", 3);
             }
             else
             {
-                child.set_name("");
+                _sink.append("<?", 2);
+                _sink.append(_child.name());
+                if (_child.valueString().length())
+                {
+                    _sink.append(' ');
+                    writeProcessingInstructionText(_sink, _child.valueString());
+                }
+                _sink.append("?>", 2);
             }
+            if (_bPrettify)
+                _sink.append('\n');
+        }
+
+        template<class W>
+        static void writeXMLElement(W & _sink, const Shrub & _shrub, const XMLName & _name, Size _depth, bool _bPrettify, bool _bCaching, XMLSplitPoint * _split);
 
-            if (_shrub.valueString().length())
+        template<class W>
+        static void writeXMLNode(W & _sink, const Shrub & _shrub, const XMLName & _name, Size _depth, bool _bPrettify, bool _bCaching, XMLSplitPoint * _split)
+        {
+            //Unnamed elements take their name from an ancestor, so only named ones are cached. Parallel
+            //exports neither read nor fill the cache, the split element might be in cached output and the
+            //chunks are written on several threads.
+            bool bCaching = (_bCaching || _shrub.isExportCaching()) && !_split;
+            if (!bCaching || _name.childSuffixCount || !_shrub.count() || _depth >= s_maxCachedDepth)
             {
-                pugi::xml_node txt = child.append_child(pugi::node_pcdata);
-                txt.set_value(_shrub.valueString().cString());
+                writeXMLElement(_sink, _shrub, _name, _depth, _bPrettify, bCaching, _split);
+                return;
             }
-            for (const auto & c : _shrub)
+
+            detail::ExportCacheKey key = {_bPrettify ? detail::ExportFormat::XMLPretty : detail::ExportFormat::XML, _bPrettify ? _depth : 0};
+            const String * bytes = _shrub.cachedExport(key);
+            if (!bytes)
+            {
+                String str(const_cast<Allocator &>(_shrub.allocator()));
+                StringWriter out(str);
+                writeXMLElement(out, _shrub, _name, _depth, _bPrettify, true, nullptr);
+                bytes = &_shrub.storeExport(key, std::move(str));
+            }
+            _sink.append(*bytes);
+        }
+
+        //the rest of a packed array element after its name, with an element per number like its
+        //unpacked children would get
+        template<class W>
+        static void writeTypedArray(W & _sink, const Shrub & _shrub, const XMLName & _name, Size _depth, bool _bPrettify)
+        {
+            XMLName childName = {_name.base, _name.childSuffixCount + 1};
+            _sink.append('>');
+            if (_bPrettify)
+                _sink.append('\n');
+            char buffer[32];
+            for (Size i = 0; i < _shrub.count(); ++i)
+            {
+                if (_bPrettify)
+                    _sink.append(' ', (_depth + 1) * 4);
+                _sink.append('<');
+                writeName(_sink, childName);
+                _sink.append('>');
+                _sink.append(buffer, _shrub.formatTypedElement(i, buffer));
+                _sink.append("</", 2);
+                writeName(_sink, childName);
+                _sink.append('>');
+                if (_bPrettify)
+                    _sink.append('\n');
+            }
+            if (_bPrettify)
+                _sink.append(' ', _depth * 4);
+            _sink.append("</", 2);
+            writeName(_sink, _name);
+            _sink.append('>');
+            if (_bPrettify)
+                _sink.append('\n');
+        }
+
+        //mirrors the formatting of pugixml's save
+        template<class W>
+        static void writeXMLElement(W & _sink, const Shrub & _shrub, const XMLName & _name, Size _depth, bool _bPrettify, bool _bCaching, XMLSplitPoint * _split)
+        {
+            if (_bPrettify)
+                _sink.append(' ', _depth * 4);
+
+            _sink.append('<');
+            writeName(_sink, _name);
+
+            if (_shrub.arrayType() != ArrayType::None)
+            {
+                writeTypedArray(_sink, _shrub, _name, _depth, _bPrettify);
+                return;
+            }
+
+            bool bHasContent = _shrub.valueString().length() > 0;
+            for (const Shrub & c : _shrub)
             {
                 if (c.valueHint() == ValueHint::XMLAttribute)
                 {
-                    child.append_attribute(c.name().cString()) = c.valueString().cString();
+                    _sink.append(' ');
+                    _sink.append(c.name());
+                    _sink.append("=\"", 2);
+                    writeEscaped(_sink, c.valueString(), true);
+                    _sink.append('"');
                 }
                 else
                 {
-                    createXMLNode(child, c);
+                    bHasContent = true;
                 }
             }
+
+            if (!bHasContent)
+            {
+                _sink.append(" />", 3);
+                if (_bPrettify)
+                    _sink.append('\n');
+                return;
+            }
+
+            _sink.append('>');
+
+            writeText(_sink, _shrub);
+
+            bool bHasChildren = false;
+            for (const Shrub & c : _shrub)
+            {
+                if (c.valueHint() != ValueHint::XMLAttribute)
+                {
+                    bHasChildren = true;
+                    break;
+                }
+            }
+
+            //text only elements stay on one line, so do the children of elements with text as
+            //indenting them would add whitespace to the text when parsed again
+            if (bHasChildren)
+            {
+                bool bPrettifyChildren = _bPrettify && !_shrub.valueString().length();
+                if (bPrettifyChildren)
+                    _sink.append('\n');
+
+                if (_split && _split->node == &_shrub)
+                {
+                    //leave the children out and remember where they go
+                    _split->name = _name;
+                    _split->depth = _depth;
+                    _split->bPrettify = bPrettifyChildren;
+                    _split->offset = writtenCount(_sink);
+                }
+                else
+                {
+                    for (const Shrub & c : _shrub)
+                    {
+                        if (c.valueHint() != ValueHint::XMLAttribute)
+                            writeXMLChild(_sink, c, _name, _depth, bPrettifyChildren, _bCaching, _split);
+                    }
+                }
+
+                if (bPrettifyChildren)
+                    _sink.append(' ', _depth * 4);
+            }
+
+            _sink.append("</", 2);
+            writeName(_sink, _name);
+            _sink.append('>');
+            if (_bPrettify)
+                _sink.append('\n');
+        }
+
+        template<class W>
+        static void writeXMLDocument(W & _sink, const Shrub & _shrub, bool _bPrettify, XMLSplitPoint * _split)
+        {
+            _sink.append("<?xml version=\"1.0\"?>");
+            if (_bPrettify)
+                _sink.append('\n');
+            writeXMLNode(_sink, _shrub, XMLName{&_shrub.name(), _shrub.name().length() ? 0u : 1u}, 0, _bPrettify, false, _split);
+        }
+
+        Error exportXML(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _bufferSize)
+        {
+            BufferedSink sink(_sink, _bufferSize, const_cast<Allocator &>(_shrub.allocator()));
+            writeXMLDocument(sink, _shrub, _bPrettify, nullptr);
+            return sink.flush();
+        }
+
+        TextResult exportXML(const Shrub & _shrub, bool _bPrettify)
+        {
+            String ret(const_cast<Allocator &>(_shrub.allocator()));
+            StringSink sink(ret);
+            Error err = xml::exportXML(_shrub, sink, _bPrettify);
+            if (err)
+                return err;
+            return ret;
+        }
+   
+        static Size elementChildCount(const Shrub & _shrub)
+        {
+            Size ret = 0;
+            for (const Shrub & c : _shrub)
+            {
+                if (c.valueHint() != ValueHint::XMLAttribute)
+                    ++ret;
+            }
+            return ret;
         }
 
-        struct XMLStringWriter: pugi::xml_writer
+        //Walks down the elements from the root to one with enough children to keep all threads busy.
+        //Exports fall back to the sequential ones if there is none.
+        static const Shrub * findSplitElement(const Shrub & _shrub, Size & _threadCount)
         {
-            XMLStringWriter(Allocator & _alloc) :
-                result(_alloc)
+            _threadCount = detail::resolveThreadCount(_threadCount);
+            if (_threadCount < 2)
+                return nullptr;
+
+            const Shrub * node = &_shrub;
+            //packed arrays are written in one go
+            for (Size depth = 0; depth < 8 && node && node->arrayType() == ArrayType::None; ++depth)
             {
+                if (elementChildCount(*node) >= _threadCount * 2)
+                    return node;
 
+                const Shrub * largest = nullptr;
+                for (const Shrub & child : *node)
+                {
+                    if (isXMLElement(child) && (!largest || child.count() > largest->count()))
+                        largest = &child;
+                }
+                node = largest;
             }
+            return nullptr;
+        }
 
-            void write(const void * data, size_t size) override
+        //the frame and range functions of detail::exportParallel
+        struct XMLParallelWriter
+        {
+            Size operator()(char * _buffer, Size _capacity, Size & _splitOffset)
             {
-                result.append(static_cast<const char *>(data), size);
+                BoundedWriter out(_buffer, _capacity);
+                writeXMLDocument(out, *root, bPrettify, split);
+                _splitOffset = split->offset;
+                return out.count;
             }
 
-            String result;
+            Size operator()(char * _buffer, Size _capacity, Size _begin, Size _end)
+            {
+                //attributes were written with the split element. The split point bypasses the cache like
+                //it does for the frame, the element itself is never reached.
+                BoundedWriter out(_buffer, _capacity);
+                const Shrub * children = &*split->node->begin();
+                for (Size i = _begin; i < _end; ++i)
+                {
+                    if (children[i].valueHint() != ValueHint::XMLAttribute)
+                        writeXMLChild(out, children[i], split->name, split->depth, split->bPrettify, false, split);
+                }
+                return out.count;
+            }
 
+            const Shrub * root;
+            XMLSplitPoint * split;
+            bool bPrettify;
         };
 
-        TextResult exportXML(const Shrub & _shrub, bool _bPrettify)
+        TextResult exportXMLParallel(const Shrub & _shrub, bool _bPrettify, Size _threadCount)
         {
-            pugi::xml_document doc;
-            createXMLNode(doc, _shrub);
-            XMLStringWriter writer(const_cast<Allocator &>(_shrub.allocator()));
-            doc.save(writer, "    ", pugi::format_default, pugi::encoding_utf8);
-            return writer.result;
+            const Shrub * node = findSplitElement(_shrub, _threadCount);
+            if (!node)
+                return xml::exportXML(_shrub, _bPrettify);
+
+            XMLSplitPoint split = {node, XMLName{&node->name(), 0}, 0, _bPrettify, 0};
+            XMLParallelWriter writer = {&_shrub, &split, _bPrettify};
+            detail::ParallelExport pe = {node->count(), _threadCount, &const_cast<Allocator &>(_shrub.allocator())};
+            return detail::exportParallel(pe, writer, writer);
+        }
+
+        Error exportXMLParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _threadCount)
+        {
+            const Shrub * node = findSplitElement(_shrub, _threadCount);
+            if (!node)
+                return xml::exportXML(_shrub, _sink, _bPrettify);
+
+            XMLSplitPoint split = {node, XMLName{&node->name(), 0}, 0, _bPrettify, 0};
+            XMLParallelWriter writer = {&_shrub, &split, _bPrettify};
+            detail::ParallelExport pe = {node->count(), _threadCount, &const_cast<Allocator &>(_shrub.allocator())};
+            return detail::exportParallel(pe, _sink, writer, writer);
         }
     }
-}
\ No newline at end of file
+}
@@ -9,8 +9,29 @@ namespace scrub
     {
         using namespace stick;
 
-        STICK_LOCAL ShrubResult parseXML(const String & _xml, Allocator & _alloc);
+        //pugixml only has global allocation functions. Scrub installs functions that forward to the
+        //allocator of the innermost ScopedPugiAllocator on the calling thread (or the default allocator)
+        //and remember it in a small header, so every block is freed by the allocator it came from.
+        class STICK_LOCAL ScopedPugiAllocator
+        {
+        public:
+
+            ScopedPugiAllocator(Allocator & _alloc);
+
+            ~ScopedPugiAllocator();
+
+        private:
+
+            Allocator * m_previous;
+        };
+
+        STICK_LOCAL unsigned int pugiParseFlags(const XMLParseOptions & _options);
+        STICK_LOCAL ShrubResult parseXML(const String & _xml, const XMLParseOptions & _options, Allocator & _alloc);
+        STICK_LOCAL ShrubResult parseXMLInPlace(char * _buffer, Size _byteCount, const XMLParseOptions & _options, Allocator & _alloc);
+        STICK_LOCAL Error exportXML(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _bufferSize = 64 * 1024);
         STICK_LOCAL TextResult exportXML(const Shrub & _shrub, bool _bPrettify);
+        STICK_LOCAL TextResult exportXMLParallel(const Shrub & _shrub, bool _bPrettify, Size _threadCount);
+        STICK_LOCAL Error exportXMLParallel(const Shrub & _shrub, Sink & _sink, bool _bPrettify, Size _threadCount);
     }
 }
 
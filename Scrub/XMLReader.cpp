@@ -0,0 +1,649 @@
+#include <Scrub/XMLReader.hpp>
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace scrub
+{
+    using namespace stick;
+
+    static bool isSpace(char _c)
+    {
+        return _c == ' ' || _c == '\t' || _c == '\n' || _c == '\r';
+    }
+
+    static bool isNameEnd(char _c)
+    {
+        return isSpace(_c) || _c == '/' || _c == '>' || _c == '=';
+    }
+
+    static bool isWhitespace(const char * _begin, const char * _end)
+    {
+        for (; _begin != _end; ++_begin)
+        {
+            if (!isSpace(*_begin))
+                return false;
+        }
+        return true;
+    }
+
+    static char * findSequence(char * _begin, char * _end, const char * _sequence)
+    {
+        Size len = std::strlen(_sequence);
+        for (; _begin + len <= _end; ++_begin)
+        {
+            _begin = static_cast<char *>(std::memchr(_begin, _sequence[0], _end - _begin));
+            if (!_begin || _begin + len > _end)
+                return nullptr;
+            if (std::memcmp(_begin, _sequence, len) == 0)
+                return _begin;
+        }
+        return nullptr;
+    }
+
+    //the closing '>' of a tag, skipping the ones inside of quoted attribute values
+    static char * findTagEnd(char * _begin, char * _end)
+    {
+        char quote = 0;
+        for (; _begin != _end; ++_begin)
+        {
+            if (quote)
+            {
+                if (*_begin == quote)
+                    quote = 0;
+            }
+            else if (*_begin == '"' || *_begin == '\'')
+                quote = *_begin;
+            else if (*_begin == '>')
+                return _begin;
+        }
+        return nullptr;
+    }
+
+    //the closing '>' of a doctype, skipping the internal subset
+    static char * findDoctypeEnd(char * _begin, char * _end)
+    {
+        Size depth = 0;
+        for (; _begin != _end; ++_begin)
+        {
+            if (*_begin == '[')
+                ++depth;
+            else if (*_begin == ']' && depth)
+                --depth;
+            else if (*_begin == '>' && !depth)
+                return _begin;
+        }
+        return nullptr;
+    }
+
+    static char * writeUTF8(char * _out, UInt32 _cp)
+    {
+        if (_cp < 0x80)
+        {
+            *_out++ = static_cast<char>(_cp);
+        }
+        else if (_cp < 0x800)
+        {
+            *_out++ = static_cast<char>(0xC0 | (_cp >> 6));
+            *_out++ = static_cast<char>(0x80 | (_cp & 0x3F));
+        }
+        else if (_cp < 0x10000)
+        {
+            *_out++ = static_cast<char>(0xE0 | (_cp >> 12));
+            *_out++ = static_cast<char>(0x80 | ((_cp >> 6) & 0x3F));
+            *_out++ = static_cast<char>(0x80 | (_cp & 0x3F));
+        }
+        else
+        {
+            *_out++ = static_cast<char>(0xF0 | (_cp >> 18));
+            *_out++ = static_cast<char>(0x80 | ((_cp >> 12) & 0x3F));
+            *_out++ = static_cast<char>(0x80 | ((_cp >> 6) & 0x3F));
+            *_out++ = static_cast<char>(0x80 | (_cp & 0x3F));
+        }
+        return _out;
+    }
+
+    //decodes the entity starting at _begin ('&') into _out. Returns the end of the entity in the input
+    //or nullptr if it is unknown, in which case it's kept verbatim (like pugixml does).
+    static char * decodeEntity(char * _begin, char * _end, char *& _out)
+    {
+        char * semicolon = static_cast<char *>(std::memchr(_begin, ';', _end - _begin));
+        if (!semicolon)
+            return nullptr;
+
+        char * name = _begin + 1;
+        Size len = semicolon - name;
+        if (len && name[0] == '#')
+        {
+            UInt32 cp = 0;
+            bool bHex = len > 1 && (name[1] == 'x' || name[1] == 'X');
+            char * it = name + (bHex ? 2 : 1);
+            if (it == semicolon)
+                return nullptr;
+            for (; it != semicolon; ++it)
+            {
+                char c = *it;
+                UInt32 digit;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else if (bHex && c >= 'a' && c <= 'f')
+                    digit = c - 'a' + 10;
+                else if (bHex && c >= 'A' && c <= 'F')
+                    digit = c - 'A' + 10;
+                else
+                    return nullptr;
+                cp = cp * (bHex ? 16 : 10) + digit;
+                if (cp > 0x10FFFF)
+                    return nullptr;
+            }
+            _out = writeUTF8(_out, cp);
+            return semicolon + 1;
+        }
+
+        char c;
+        if (len == 2 && std::memcmp(name, "lt", 2) == 0)
+            c = '<';
+        else if (len == 2 && std::memcmp(name, "gt", 2) == 0)
+            c = '>';
+        else if (len == 3 && std::memcmp(name, "amp", 3) == 0)
+            c = '&';
+        else if (len == 4 && std::memcmp(name, "apos", 4) == 0)
+            c = '\'';
+        else if (len == 4 && std::memcmp(name, "quot", 4) == 0)
+            c = '"';
+        else
+            return nullptr;
+        *_out++ = c;
+        return semicolon + 1;
+    }
+
+    //decodes entities and line endings in place, the result is never longer than the input.
+    static char * decodeInPlace(char * _begin, char * _end, bool _bDecodeEntities, bool _bAttribute)
+    {
+        char * out = _begin;
+        char * it = _begin;
+        while (it != _end)
+        {
+            char c = *it;
+            if (c == '&' && _bDecodeEntities)
+            {
+                char * next = decodeEntity(it, _end, out);
+                if (next)
+                {
+                    it = next;
+                    continue;
+                }
+            }
+            else if (c == '\r')
+            {
+                if (it + 1 != _end && it[1] == '\n')
+                    ++it;
+                c = '\n';
+            }
+
+            if (_bAttribute && (c == '\n' || c == '\t'))
+                c = ' ';
+            *out++ = c;
+            ++it;
+        }
+        return out;
+    }
+
+    XMLHandler::~XMLHandler()
+    {
+
+    }
+
+    void XMLHandler::endText()
+    {
+
+    }
+
+    XMLReader::XMLReader(XMLHandler & _handler, Size _chunkSize, Allocator & _alloc) :
+        m_handler(&_handler),
+        m_chunkSize(_chunkSize ? _chunkSize : 1),
+        m_buffer(_alloc),
+        m_position(0),
+        m_end(0),
+        m_consumed(0),
+        m_openNames(_alloc),
+        m_openNameOffsets(_alloc),
+        m_depth(0),
+        m_attributes(_alloc),
+        m_bTextContinues(false),
+        m_bTextPending(false),
+        m_bFoundRoot(false)
+    {
+
+    }
+
+    Error XMLReader::error(const char * _message) const
+    {
+        return Error(ec::ParseFailed, String::concat("Failed to parse XML: ", _message, " at offset ", toString(m_consumed + m_position)), STICK_FILE, STICK_LINE);
+    }
+
+    void XMLReader::emitText(char * _begin, char * _end, bool _bFinal)
+    {
+        //whitespace only text between tags is dropped like parseXML does, unless it's part of a larger text
+        bool bSkip = !m_bTextContinues && _bFinal && isWhitespace(_begin, _end);
+        m_bTextContinues = !_bFinal;
+        if (bSkip)
+            return;
+        char * end = decodeInPlace(_begin, _end, true, false);
+        if (end != _begin)
+        {
+            m_handler->text(StringSpan(_begin, end - _begin));
+            m_bTextPending = true;
+        }
+    }
+
+    void XMLReader::compact()
+    {
+        //drop what was parsed already to make room for new data
+        if (m_position)
+        {
+            std::memmove(&m_buffer[0], &m_buffer[0] + m_position, m_end - m_position);
+            m_consumed += m_position;
+            m_end -= m_position;
+            m_position = 0;
+        }
+    }
+
+    Error XMLReader::feed(const char * _data, Size _byteCount)
+    {
+        if (m_error)
+            return m_error;
+
+        compact();
+
+        while (_byteCount)
+        {
+            Size count = _byteCount < m_chunkSize ? _byteCount : m_chunkSize;
+            if (m_buffer.count() < m_end + count)
+                m_buffer.resize(m_end + count);
+            std::memcpy(&m_buffer[0] + m_end, _data, count);
+            m_end += count;
+            _data += count;
+            _byteCount -= count;
+
+            m_error = parse(false);
+            if (m_error)
+                return m_error;
+
+            compact();
+        }
+        return Error();
+    }
+
+    Error XMLReader::read(int _fd)
+    {
+        while (!m_error)
+        {
+            compact();
+
+            //read straight into the buffer rather than going through feed
+            if (m_buffer.count() < m_end + m_chunkSize)
+                m_buffer.resize(m_end + m_chunkSize);
+            ssize_t bytesRead = ::read(_fd, &m_buffer[0] + m_end, m_chunkSize);
+            if (bytesRead < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                m_error = Error(ec::InvalidOperation, String::concat("Failed to read XML: ", std::strerror(errno)), STICK_FILE, STICK_LINE);
+                break;
+            }
+            if (bytesRead == 0)
+                return finish();
+
+            m_end += bytesRead;
+            m_error = parse(false);
+        }
+        return m_error;
+    }
+
+    Error XMLReader::finish()
+    {
+        if (m_error)
+            return m_error;
+
+        m_error = parse(true);
+        if (m_error)
+            return m_error;
+
+        if (m_depth)
+            m_error = error(String::concat("missing end tag of ", m_openNames.cString() + m_openNameOffsets[m_depth - 1]).cString());
+        else if (!m_bFoundRoot)
+            m_error = error("no root element");
+        return m_error;
+    }
+
+    Error XMLReader::parse(bool _bEndOfInput)
+    {
+        if (m_end == m_position)
+            return Error();
+
+        char * buf = &m_buffer[0];
+        //a UTF-8 byte order mark is skipped like parseXML does
+        if (!m_consumed && !m_position)
+        {
+            Size count = m_end < 3 ? m_end : 3;
+            if (std::memcmp(buf, "\xEF\xBB\xBF", count) == 0)
+            {
+                if (count < 3 && !_bEndOfInput)
+                    return Error();
+                if (count == 3)
+                    m_position = 3;
+            }
+        }
+
+        while (m_position != m_end)
+        {
+            char * begin = buf + m_position;
+            char * end = buf + m_end;
+
+            if (*begin != '<')
+            {
+                char * lt = static_cast<char *>(std::memchr(begin, '<', end - begin));
+                if (lt || _bEndOfInput)
+                {
+                    char * textEnd = lt ? lt : end;
+                    if (!m_depth && !isWhitespace(begin, textEnd))
+                        return error("text outside of the root element");
+                    if (m_depth)
+                        emitText(begin, textEnd, true);
+                    m_position = textEnd - buf;
+                    continue;
+                }
+
+                //hand out long texts in pieces to keep the buffer bounded. Don't split
+                //entities or \r\n pairs between pieces.
+                if (m_depth && Size(end - begin) >= m_chunkSize)
+                {
+                    char * cut = end;
+                    Size lookBack = end - begin < 12 ? end - begin : 12;
+                    for (Size i = 1; i <= lookBack; ++i)
+                    {
+                        if (end[-i] == ';')
+                            break;
+                        if (end[-i] == '&')
+                        {
+                            cut = end - i;
+                            break;
+                        }
+                    }
+                    if (cut == end && end[-1] == '\r')
+                        --cut;
+                    //whitespace is held back until it's clear whether the text is dropped
+                    if (cut != begin && (m_bTextContinues || !isWhitespace(begin, cut)))
+                    {
+                        emitText(begin, cut, false);
+                        m_position = cut - buf;
+                    }
+                }
+                break;
+            }
+
+            //any markup ends the text before it
+            if (m_bTextPending)
+            {
+                m_bTextPending = false;
+                m_handler->endText();
+            }
+
+            //need enough characters to tell the kinds of markup apart
+            if (!_bEndOfInput && end - begin < 9)
+                break;
+
+            Size remaining = end - begin;
+            if (remaining >= 2 && begin[1] == '?')
+            {
+                char * close = findSequence(begin + 2, end, "?>");
+                if (!close)
+                    break;
+                m_position = close + 2 - buf;
+            }
+            else if (remaining >= 4 && std::memcmp(begin, "<!--", 4) == 0)
+            {
+                char * close = findSequence(begin + 4, end, "-->");
+                if (!close)
+                    break;
+                m_position = close + 3 - buf;
+            }
+            else if (remaining >= 9 && std::memcmp(begin, "<![CDATA[", 9) == 0)
+            {
+                char * close = findSequence(begin + 9, end, "]]>");
+                if (!close)
+                    break;
+                if (!m_depth)
+                    return error("CDATA outside of the root element");
+                char * textEnd = decodeInPlace(begin + 9, close, false, false);
+                m_bTextContinues = false;
+                if (textEnd != begin + 9)
+                {
+                    m_handler->text(StringSpan(begin + 9, textEnd - (begin + 9)));
+                    m_handler->endText();
+                }
+                m_position = close + 3 - buf;
+            }
+            else if (remaining >= 2 && begin[1] == '!')
+            {
+                char * close = findDoctypeEnd(begin + 2, end);
+                if (!close)
+                    break;
+                m_position = close + 1 - buf;
+            }
+            else if (remaining >= 2 && begin[1] == '/')
+            {
+                char * close = static_cast<char *>(std::memchr(begin, '>', remaining));
+                if (!close)
+                    break;
+                char * nameEnd = begin + 2;
+                while (nameEnd != close && !isSpace(*nameEnd))
+                    ++nameEnd;
+                if (!isWhitespace(nameEnd, close))
+                    return error("invalid end tag");
+                if (!m_depth)
+                    return error("end tag without start tag");
+
+                Size offset = m_openNameOffsets[m_depth - 1];
+                Size len = m_openNames.length() - offset;
+                if (len != Size(nameEnd - (begin + 2)) || std::memcmp(m_openNames.cString() + offset, begin + 2, len) != 0)
+                    return error(String::concat("mismatched end tag, expected ", m_openNames.cString() + offset).cString());
+
+                m_bTextContinues = false;
+                m_handler->endElement(StringSpan(begin + 2, len));
+                m_openNames.resize(offset);
+                --m_depth;
+                m_position = close + 1 - buf;
+            }
+            else
+            {
+                char * close = findTagEnd(begin + 1, end);
+                if (!close)
+                {
+                    if (_bEndOfInput)
+                        return error("unterminated tag");
+                    break;
+                }
+                if (!m_depth && m_bFoundRoot)
+                    return error("multiple root elements");
+
+                char * it = begin + 1;
+                while (it != close && !isNameEnd(*it))
+                    ++it;
+                StringSpan name(begin + 1, it - (begin + 1));
+                if (!name.count())
+                    return error("missing element name");
+
+                m_attributes.clear();
+                bool bSelfClosing = false;
+                while (true)
+                {
+                    while (it != close && isSpace(*it))
+                        ++it;
+                    if (it == close)
+                        break;
+                    if (*it == '/' && it + 1 == close)
+                    {
+                        bSelfClosing = true;
+                        break;
+                    }
+
+                    char * attrName = it;
+                    while (it != close && !isNameEnd(*it))
+                        ++it;
+                    char * attrNameEnd = it;
+                    while (it != close && isSpace(*it))
+                        ++it;
+                    if (attrName == attrNameEnd || it == close || *it != '=')
+                        return error("invalid attribute");
+                    ++it;
+                    while (it != close && isSpace(*it))
+                        ++it;
+                    if (it == close || (*it != '"' && *it != '\''))
+                        return error("attribute value is not quoted");
+
+                    //findTagEnd guarantees the closing quote comes before close
+                    char * valueBegin = it + 1;
+                    char * valueEnd = static_cast<char *>(std::memchr(valueBegin, *it, close - valueBegin));
+                    char * decodedEnd = decodeInPlace(valueBegin, valueEnd, true, true);
+                    m_attributes.append({StringSpan(attrName, attrNameEnd - attrName), StringSpan(valueBegin, decodedEnd - valueBegin)});
+                    it = valueEnd + 1;
+                }
+
+                m_bFoundRoot = true;
+                m_bTextContinues = false;
+                m_handler->startElement(name, XMLAttributeSpans(m_attributes.count() ? &m_attributes[0] : nullptr, m_attributes.count()));
+                if (bSelfClosing)
+                {
+                    m_handler->endElement(name);
+                }
+                else
+                {
+                    if (m_openNameOffsets.count() <= m_depth)
+                        m_openNameOffsets.append(m_openNames.length());
+                    else
+                        m_openNameOffsets[m_depth] = m_openNames.length();
+                    m_openNames.append(name.ptr(), name.count());
+                    ++m_depth;
+                }
+                m_position = close + 1 - buf;
+            }
+        }
+
+        if (_bEndOfInput && m_position != m_end)
+            return error("unexpected end of input");
+
+        return Error();
+    }
+
+    XMLSubtreeHandler::XMLSubtreeHandler(const String & _path, char _separator, Allocator & _alloc) :
+        m_alloc(&_alloc),
+        m_path(path::segments(_path, _alloc, _separator)),
+        m_depth(0),
+        m_matchedDepth(0),
+        m_stack(_alloc),
+        m_stackDepth(0),
+        m_text(_alloc)
+    {
+
+    }
+
+    void XMLSubtreeHandler::flushText()
+    {
+        if (!m_text.length())
+            return;
+
+        //the first text of an element is its value, the rest become unnamed children (see parseXMLNode)
+        Shrub & top = m_stack[m_stackDepth - 1];
+        if (!top.valueString().length())
+            top.setValue(m_text);
+        else
+            top.append(Shrub(String(*m_alloc), m_text, ValueHint::None, *m_alloc));
+        m_text.clear();
+    }
+
+    void XMLSubtreeHandler::startElement(StringSpan _name, XMLAttributeSpans _attributes)
+    {
+        if (!m_stackDepth)
+        {
+            if (m_matchedDepth == m_depth && m_depth < m_path.count() && _name == m_path[m_depth])
+                ++m_matchedDepth;
+            ++m_depth;
+            if (m_matchedDepth != m_path.count() || m_matchedDepth != m_depth)
+                return;
+        }
+        else
+        {
+            flushText();
+            ++m_depth;
+        }
+
+        Shrub node(String(_name.begin(), _name.end(), *m_alloc), ValueHint::None, *m_alloc);
+        for (const XMLAttributeSpan & attr : _attributes)
+        {
+            node.append(Shrub(String(attr.name.begin(), attr.name.end(), *m_alloc),
+                              String(attr.value.begin(), attr.value.end(), *m_alloc),
+                              ValueHint::XMLAttribute, *m_alloc));
+        }
+
+        if (m_stackDepth < m_stack.count())
+            m_stack[m_stackDepth] = std::move(node);
+        else
+            m_stack.append(std::move(node));
+        ++m_stackDepth;
+    }
+
+    void XMLSubtreeHandler::text(StringSpan _text)
+    {
+        if (m_stackDepth)
+            m_text.append(_text.ptr(), _text.count());
+    }
+
+    void XMLSubtreeHandler::endText()
+    {
+        if (m_stackDepth)
+            flushText();
+    }
+
+    void XMLSubtreeHandler::endElement(StringSpan)
+    {
+        if (m_matchedDepth == m_depth)
+            --m_matchedDepth;
+        --m_depth;
+
+        if (!m_stackDepth)
+            return;
+
+        flushText();
+        --m_stackDepth;
+        if (m_stackDepth)
+        {
+            m_stack[m_stackDepth - 1].append(std::move(m_stack[m_stackDepth]));
+        }
+        else
+        {
+            subtree(m_stack[0]);
+            //don't hold on to the delivered subtree
+            m_stack[0] = Shrub(*m_alloc);
+        }
+    }
+
+    Error readXML(int _fd, XMLHandler & _handler, Size _chunkSize, Allocator & _alloc)
+    {
+        XMLReader reader(_handler, _chunkSize, _alloc);
+        return reader.read(_fd);
+    }
+
+    Error readXMLFile(const String & _path, XMLHandler & _handler, Size _chunkSize, Allocator & _alloc)
+    {
+        int fd = ::open(_path.cString(), O_RDONLY);
+        if (fd < 0)
+            return Error(ec::InvalidArgument, String::concat("Could not open file: ", _path), STICK_FILE, STICK_LINE);
+        Error err = readXML(fd, _handler, _chunkSize, _alloc);
+        ::close(fd);
+        return err;
+    }
+}
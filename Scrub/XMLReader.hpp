@@ -0,0 +1,124 @@
+#ifndef SCRUB_XMLREADER_HPP
+#define SCRUB_XMLREADER_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+#include <Stick/Error.hpp>
+
+namespace scrub
+{
+    struct STICK_API XMLAttributeSpan
+    {
+        StringSpan name;
+        StringSpan value;
+    };
+
+    typedef Span<const XMLAttributeSpan> XMLAttributeSpans;
+
+    //receives the events of an XMLReader. All spans point into the reader's buffer
+    //and are only valid for the duration of the call.
+    class STICK_API XMLHandler
+    {
+    public:
+
+        virtual ~XMLHandler();
+
+        virtual void startElement(StringSpan _name, XMLAttributeSpans _attributes) = 0;
+
+        //text larger than the chunk size is reported in several consecutive calls.
+        //CDATA sections are reported as text, too.
+        virtual void text(StringSpan _text) = 0;
+
+        virtual void endElement(StringSpan _name) = 0;
+
+        //called after the last piece of a text, before the markup that ends it. Comments, processing
+        //instructions and CDATA sections end a text, too, so every text is one text node of parseXML.
+        virtual void endText();
+    };
+
+    //event driven XML parser that works on bounded chunks of input, so documents of any size can be
+    //processed without holding them in memory. The buffer only grows beyond twice the chunk size if a
+    //single tag or run of whitespace is larger than that. Entities, line endings and attribute whitespace are converted like
+    //parseXML does, comments, processing instructions and the doctype are skipped.
+    class STICK_API XMLReader
+    {
+    public:
+
+        XMLReader(XMLHandler & _handler, stick::Size _chunkSize = 64 * 1024, stick::Allocator & _alloc = stick::defaultAllocator());
+
+        //parses as much of the data fed so far as possible.
+        stick::Error feed(const char * _data, stick::Size _byteCount);
+
+        //reads _fd in chunks until the end of the file and finishes the document.
+        stick::Error read(int _fd);
+
+        //call after the last feed, fails if the document is incomplete.
+        stick::Error finish();
+
+    private:
+
+        stick::Error parse(bool _bEndOfInput);
+
+        stick::Error error(const char * _message) const;
+
+        void compact();
+
+        void emitText(char * _begin, char * _end, bool _bFinal);
+
+        XMLHandler * m_handler;
+        stick::Size m_chunkSize;
+        stick::DynamicArray<char> m_buffer;
+        //unparsed bytes are [m_position, m_end) of m_buffer
+        stick::Size m_position;
+        stick::Size m_end;
+        //bytes of the input that were removed from the front of m_buffer
+        stick::Size m_consumed;
+        stick::String m_openNames;
+        stick::DynamicArray<stick::Size> m_openNameOffsets;
+        stick::Size m_depth;
+        stick::DynamicArray<XMLAttributeSpan> m_attributes;
+        bool m_bTextContinues;
+        //text was reported that endText wasn't called for yet
+        bool m_bTextPending;
+        bool m_bFoundRoot;
+        stick::Error m_error;
+    };
+
+    //builds a Shrub (with the same layout as parseXML) for every element at the end of _path and hands
+    //it to subtree(), everything else is skipped. I.e. "catalog.book" reports each book in a catalog.
+    class STICK_API XMLSubtreeHandler : public XMLHandler
+    {
+    public:
+
+        XMLSubtreeHandler(const stick::String & _path, char _separator = '.', stick::Allocator & _alloc = stick::defaultAllocator());
+
+        virtual void subtree(Shrub & _shrub) = 0;
+
+        void startElement(StringSpan _name, XMLAttributeSpans _attributes) override;
+
+        void text(StringSpan _text) override;
+
+        void endElement(StringSpan _name) override;
+
+        void endText() override;
+
+    private:
+
+        void flushText();
+
+        stick::Allocator * m_alloc;
+        stick::DynamicArray<stick::String> m_path;
+        //depth of the current element and the number of its ancestors that match m_path
+        stick::Size m_depth;
+        stick::Size m_matchedDepth;
+        //the subtree being built, entries past m_stackDepth are kept for reuse
+        stick::DynamicArray<Shrub> m_stack;
+        stick::Size m_stackDepth;
+        stick::String m_text;
+    };
+
+    STICK_API stick::Error readXML(int _fd, XMLHandler & _handler, stick::Size _chunkSize = 64 * 1024, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API stick::Error readXMLFile(const stick::String & _path, XMLHandler & _handler, stick::Size _chunkSize = 64 * 1024, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_XMLREADER_HPP
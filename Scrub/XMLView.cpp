@@ -0,0 +1,373 @@
+#include <Scrub/XMLView.hpp>
+#include <Scrub/XML/XMLSerializer.hpp>
+#include <Scrub/XML/pugixml.hpp>
+#include <Stick/FileUtilities.hpp>
+#include <atomic>
+#include <new> //for placement new
+
+namespace scrub
+{
+    using namespace stick;
+
+    namespace detail
+    {
+        struct XMLViewDocument
+        {
+            XMLViewDocument(Allocator & _alloc) :
+                buffer(_alloc),
+                referenceCount(0),
+                allocator(&_alloc)
+            {
+
+            }
+
+            //the text the document was parsed from in place, if the document owns it
+            String buffer;
+            pugi::xml_document document;
+            std::atomic<Size> referenceCount;
+            Allocator * allocator;
+        };
+
+        static void destroy(XMLViewDocument * _doc)
+        {
+            Allocator * alloc = _doc->allocator;
+            _doc->~XMLViewDocument();
+            alloc->deallocate({_doc, sizeof(XMLViewDocument)});
+        }
+
+        static void retain(XMLViewDocument * _doc)
+        {
+            if (_doc)
+                ++_doc->referenceCount;
+        }
+
+        static void release(XMLViewDocument * _doc)
+        {
+            if (_doc && --_doc->referenceCount == 0)
+                destroy(_doc);
+        }
+    }
+
+    static bool isText(pugi::xml_node _node)
+    {
+        return _node.type() == pugi::node_pcdata || _node.type() == pugi::node_cdata;
+    }
+
+    //the first text of an element becomes its value (see parseXMLNode)
+    static pugi::xml_node valueNode(pugi::xml_node _element)
+    {
+        for (pugi::xml_node child = _element.first_child(); child; child = child.next_sibling())
+        {
+            if (isText(child))
+                return child;
+        }
+        return pugi::xml_node();
+    }
+
+    //elements, all but the value text, and the comments and processing instructions that the parse
+    //options kept are children, starting at _node
+    static pugi::xml_node nextChildNode(pugi::xml_node _node, pugi::xml_node _valueNode)
+    {
+        for (; _node; _node = _node.next_sibling())
+        {
+            pugi::xml_node_type type = _node.type();
+            if (type == pugi::node_element || type == pugi::node_comment || type == pugi::node_pi || (isText(_node) && _node != _valueNode))
+                return _node;
+        }
+        return pugi::xml_node();
+    }
+
+    static bool isElement(pugi::xml_node_struct * _node, pugi::xml_attribute_struct * _attribute)
+    {
+        return !_attribute && pugi::xml_node(_node).type() == pugi::node_element;
+    }
+
+    XMLView::ChildIter::ChildIter(const XMLView & _parent, pugi::xml_node_struct * _node, pugi::xml_attribute_struct * _attribute,
+                                  pugi::xml_node_struct * _valueNode) :
+        m_parent(_parent),
+        m_node(_node),
+        m_attribute(_attribute),
+        m_valueNode(_valueNode)
+    {
+
+    }
+
+    XMLView XMLView::ChildIter::operator * () const
+    {
+        if (m_attribute)
+            return XMLView(m_parent.m_document, m_parent.m_node, m_attribute);
+        return XMLView(m_parent.m_document, m_node, nullptr);
+    }
+
+    XMLView::ChildIter & XMLView::ChildIter::operator ++ ()
+    {
+        if (m_attribute)
+        {
+            m_attribute = pugi::xml_attribute(m_attribute).next_attribute().internal_object();
+            if (!m_attribute)
+                m_node = nextChildNode(pugi::xml_node(m_parent.m_node).first_child(), pugi::xml_node(m_valueNode)).internal_object();
+        }
+        else if (m_node)
+        {
+            m_node = nextChildNode(pugi::xml_node(m_node).next_sibling(), pugi::xml_node(m_valueNode)).internal_object();
+        }
+        return *this;
+    }
+
+    bool XMLView::ChildIter::operator == (const ChildIter & _other) const
+    {
+        return m_node == _other.m_node && m_attribute == _other.m_attribute;
+    }
+
+    bool XMLView::ChildIter::operator != (const ChildIter & _other) const
+    {
+        return !(*this == _other);
+    }
+
+    XMLView::XMLView() :
+        m_document(nullptr),
+        m_node(nullptr),
+        m_attribute(nullptr)
+    {
+
+    }
+
+    XMLView::XMLView(detail::XMLViewDocument * _document, pugi::xml_node_struct * _node, pugi::xml_attribute_struct * _attribute) :
+        m_document(_document),
+        m_node(_node),
+        m_attribute(_attribute)
+    {
+        detail::retain(m_document);
+    }
+
+    XMLView::XMLView(const XMLView & _other) :
+        m_document(_other.m_document),
+        m_node(_other.m_node),
+        m_attribute(_other.m_attribute)
+    {
+        detail::retain(m_document);
+    }
+
+    XMLView::XMLView(XMLView && _other) :
+        m_document(_other.m_document),
+        m_node(_other.m_node),
+        m_attribute(_other.m_attribute)
+    {
+        _other.m_document = nullptr;
+    }
+
+    XMLView::~XMLView()
+    {
+        detail::release(m_document);
+    }
+
+    XMLView & XMLView::operator = (const XMLView & _other)
+    {
+        detail::retain(_other.m_document);
+        detail::release(m_document);
+        m_document = _other.m_document;
+        m_node = _other.m_node;
+        m_attribute = _other.m_attribute;
+        return *this;
+    }
+
+    XMLView & XMLView::operator = (XMLView && _other)
+    {
+        if (this != &_other)
+        {
+            detail::release(m_document);
+            m_document = _other.m_document;
+            m_node = _other.m_node;
+            m_attribute = _other.m_attribute;
+            _other.m_document = nullptr;
+        }
+        return *this;
+    }
+
+    static bool nameEquals(const char * _name, const char * _segment, Size _length)
+    {
+        return std::strncmp(_name, _segment, _length) == 0 && _name[_length] == '\0';
+    }
+
+    Maybe<XMLView> XMLView::child(const String & _path, char _separator) const
+    {
+        if (!m_document || !isElement(m_node, m_attribute))
+            return Maybe<XMLView>();
+
+        pugi::xml_node current(m_node);
+        const char * segment = _path.cString();
+        const char * pathEnd = segment + _path.length();
+        while (true)
+        {
+            const char * segmentEnd = segment;
+            while (segmentEnd != pathEnd && *segmentEnd != _separator) ++segmentEnd;
+            Size length = segmentEnd - segment;
+
+            //same lookup order as the children of a parsed Shrub, attributes first
+            pugi::xml_attribute attr = current.first_attribute();
+            for (; attr; attr = attr.next_attribute())
+            {
+                if (nameEquals(attr.name(), segment, length))
+                    break;
+            }
+
+            if (attr)
+            {
+                if (segmentEnd != pathEnd)
+                    return Maybe<XMLView>();
+                return XMLView(m_document, current.internal_object(), attr.internal_object());
+            }
+
+            pugi::xml_node val = valueNode(current);
+            pugi::xml_node node = nextChildNode(current.first_child(), val);
+            for (; node; node = nextChildNode(node.next_sibling(), val))
+            {
+                if (nameEquals(node.name(), segment, length))
+                    break;
+            }
+
+            if (!node)
+                return Maybe<XMLView>();
+
+            if (segmentEnd == pathEnd)
+                return XMLView(m_document, node.internal_object(), nullptr);
+
+            if (node.type() != pugi::node_element)
+                return Maybe<XMLView>();
+
+            current = node;
+            segment = segmentEnd + 1;
+        }
+    }
+
+    const char * XMLView::name() const
+    {
+        if (m_attribute)
+            return pugi::xml_attribute(m_attribute).name();
+        return pugi::xml_node(m_node).name();
+    }
+
+    const char * XMLView::valueCString() const
+    {
+        if (m_attribute)
+            return pugi::xml_attribute(m_attribute).value();
+
+        pugi::xml_node node(m_node);
+        if (node.type() != pugi::node_element)
+            return node.value();
+        return valueNode(node).value();
+    }
+
+    StringSpan XMLView::valueString() const
+    {
+        const char * str = valueCString();
+        return StringSpan(str, std::strlen(str));
+    }
+
+    ValueHint XMLView::valueHint() const
+    {
+        if (m_attribute)
+            return ValueHint::XMLAttribute;
+        switch (pugi::xml_node(m_node).type())
+        {
+        case pugi::node_comment:
+            return ValueHint::XMLComment;
+        case pugi::node_pi:
+            return ValueHint::XMLProcessingInstruction;
+        default:
+            return ValueHint::None;
+        }
+    }
+
+    bool XMLView::isValid() const
+    {
+        return m_document != nullptr;
+    }
+
+    XMLView::ChildIter XMLView::begin() const
+    {
+        if (!isElement(m_node, m_attribute))
+            return end();
+
+        pugi::xml_node node(m_node);
+        pugi::xml_node value = valueNode(node);
+        pugi::xml_attribute attr = node.first_attribute();
+        if (attr)
+            return ChildIter(*this, nullptr, attr.internal_object(), value.internal_object());
+        return ChildIter(*this, nextChildNode(node.first_child(), value).internal_object(), nullptr, value.internal_object());
+    }
+
+    XMLView::ChildIter XMLView::end() const
+    {
+        return ChildIter(*this, nullptr, nullptr, nullptr);
+    }
+
+    Size XMLView::count() const
+    {
+        Size ret = 0;
+        ChildIter last = end();
+        for (auto it = begin(); it != last; ++it)
+            ++ret;
+        return ret;
+    }
+
+    static detail::XMLViewDocument * createDocument(Allocator & _alloc)
+    {
+        auto block = _alloc.allocate(sizeof(detail::XMLViewDocument), alignof(detail::XMLViewDocument));
+        return new (block.ptr) detail::XMLViewDocument(_alloc);
+    }
+
+    static XMLViewResult toView(detail::XMLViewDocument * _doc, const pugi::xml_parse_result & _result)
+    {
+        if (!_result)
+        {
+            detail::destroy(_doc);
+            return Error(ec::ParseFailed, String::concat("Failed to parse XML: ", _result.description()), STICK_FILE, STICK_LINE);
+        }
+        return XMLView(_doc, _doc->document.document_element().internal_object(), nullptr);
+    }
+
+    XMLViewResult parseXMLView(const String & _xml, Allocator & _alloc)
+    {
+        return parseXMLView(_xml, XMLParseOptions(), _alloc);
+    }
+
+    XMLViewResult parseXMLView(const String & _xml, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        xml::ScopedPugiAllocator pugiAlloc(_alloc);
+        detail::XMLViewDocument * doc = createDocument(_alloc);
+        return toView(doc, doc->document.load(_xml.cString(), xml::pugiParseFlags(_options)));
+    }
+
+    XMLViewResult parseXMLViewInPlace(char * _buffer, Size _byteCount, Allocator & _alloc)
+    {
+        return parseXMLViewInPlace(_buffer, _byteCount, XMLParseOptions(), _alloc);
+    }
+
+    XMLViewResult parseXMLViewInPlace(char * _buffer, Size _byteCount, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        xml::ScopedPugiAllocator pugiAlloc(_alloc);
+        detail::XMLViewDocument * doc = createDocument(_alloc);
+        return toView(doc, doc->document.load_buffer_inplace(_buffer, _byteCount, xml::pugiParseFlags(_options)));
+    }
+
+    XMLViewResult loadXMLView(const String & _path, Allocator & _alloc)
+    {
+        return loadXMLView(_path, XMLParseOptions(), _alloc);
+    }
+
+    XMLViewResult loadXMLView(const String & _path, const XMLParseOptions & _options, Allocator & _alloc)
+    {
+        auto result = loadTextFile(_path, _alloc);
+        if (!result)
+            return result.error();
+
+        //keep the loaded text alive in the document and let pugi parse it in place
+        xml::ScopedPugiAllocator pugiAlloc(_alloc);
+        detail::XMLViewDocument * doc = createDocument(_alloc);
+        doc->buffer = std::move(result.get());
+        if (!doc->buffer.length())
+            return toView(doc, doc->document.load("", xml::pugiParseFlags(_options)));
+        return toView(doc, doc->document.load_buffer_inplace(&doc->buffer[0], doc->buffer.length(), xml::pugiParseFlags(_options)));
+    }
+}
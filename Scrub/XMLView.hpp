@@ -0,0 +1,203 @@
+#ifndef SCRUB_XMLVIEW_HPP
+#define SCRUB_XMLVIEW_HPP
+
+#include <Scrub/Shrub.hpp>
+#include <Scrub/Span.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace pugi
+{
+    struct xml_node_struct;
+    struct xml_attribute_struct;
+}
+
+namespace scrub
+{
+    namespace detail
+    {
+        //reference counted owner of a parsed pugi::xml_document
+        struct XMLViewDocument;
+
+        template<class T, bool IsArithmetic = std::is_arithmetic<T>::value>
+        struct XMLViewConverter;
+    }
+
+    //read only view of a parsed XML document. Uses the same layout as parseXML, i.e. attributes
+    //are the first children of an element followed by its child elements and the comments and
+    //processing instructions the parse options keep, and the first text (pcdata or CDATA) of an
+    //element is its value. Nothing is copied out of the pugixml DOM.
+    class STICK_API XMLView
+    {
+    public:
+
+        class ChildIter;
+
+
+        XMLView();
+
+        XMLView(detail::XMLViewDocument * _document, pugi::xml_node_struct * _node, pugi::xml_attribute_struct * _attribute);
+
+        XMLView(const XMLView & _other);
+
+        XMLView(XMLView && _other);
+
+        ~XMLView();
+
+        XMLView & operator = (const XMLView & _other);
+
+        XMLView & operator = (XMLView && _other);
+
+        stick::Maybe<XMLView> child(const stick::String & _path, char _separator = '.') const;
+
+        template<class T>
+        stick::Maybe<T> maybe(const stick::String & _path, char _separator = '.') const
+        {
+            auto desc = child(_path, _separator);
+            if (desc)
+                return (*desc).value<T>();
+            return stick::Maybe<T>();
+        }
+
+        template<class T>
+        T maybe(const stick::String & _path, T _orValue) const
+        {
+            auto m = maybe<T>(_path);
+            if (m)
+                return *m;
+            return _orValue;
+        }
+
+        template<class T>
+        T get(const stick::String & _path, char _separator = '.') const
+        {
+            return maybe<T>(_path, _separator).value();
+        }
+
+        //numbers are converted in place, only String allocates.
+        template<class T>
+        stick::Maybe<T> value() const
+        {
+            return detail::XMLViewConverter<T>::convert(valueCString());
+        }
+
+        const char * name() const;
+
+        //null terminated value inside of the pugixml document, empty if there is none.
+        const char * valueCString() const;
+
+        StringSpan valueString() const;
+
+        ValueHint valueHint() const;
+
+        bool isValid() const;
+
+        ChildIter begin() const;
+
+        ChildIter end() const;
+
+        //walks the children, linear in their number.
+        stick::Size count() const;
+
+    private:
+
+        detail::XMLViewDocument * m_document;
+        pugi::xml_node_struct * m_node;
+        pugi::xml_attribute_struct * m_attribute;
+    };
+
+    class STICK_API XMLView::ChildIter
+    {
+    public:
+
+        ChildIter(const XMLView & _parent, pugi::xml_node_struct * _node, pugi::xml_attribute_struct * _attribute,
+                  pugi::xml_node_struct * _valueNode);
+
+        XMLView operator * () const;
+
+        ChildIter & operator ++ ();
+
+        bool operator == (const ChildIter & _other) const;
+
+        bool operator != (const ChildIter & _other) const;
+
+    private:
+
+        XMLView m_parent;
+        pugi::xml_node_struct * m_node;
+        pugi::xml_attribute_struct * m_attribute;
+        //the text that is the value of the parent, found once so that stepping is constant time
+        pugi::xml_node_struct * m_valueNode;
+    };
+
+    namespace detail
+    {
+        template<class T>
+        struct XMLViewConverter<T, true>
+        {
+            static stick::Maybe<T> convert(const char * _str)
+            {
+                char * end;
+                T ret = std::is_floating_point<T>::value ? static_cast<T>(std::strtod(_str, &end)) : static_cast<T>(std::strtoll(_str, &end, 10));
+                if (end == _str)
+                    return stick::Maybe<T>();
+                return ret;
+            }
+        };
+
+        template<>
+        struct XMLViewConverter<bool, true>
+        {
+            static stick::Maybe<bool> convert(const char * _str)
+            {
+                if (std::strcmp(_str, "true") == 0 || std::strcmp(_str, "1") == 0)
+                    return true;
+                else if (std::strcmp(_str, "false") == 0 || std::strcmp(_str, "0") == 0)
+                    return false;
+                return stick::Maybe<bool>();
+            }
+        };
+
+        template<>
+        struct XMLViewConverter<const char *, false>
+        {
+            static stick::Maybe<const char *> convert(const char * _str)
+            {
+                return _str;
+            }
+        };
+
+        template<>
+        struct XMLViewConverter<StringSpan, false>
+        {
+            static stick::Maybe<StringSpan> convert(const char * _str)
+            {
+                return StringSpan(_str, std::strlen(_str));
+            }
+        };
+
+        template<>
+        struct XMLViewConverter<stick::String, false>
+        {
+            static stick::Maybe<stick::String> convert(const char * _str)
+            {
+                return stick::String(_str);
+            }
+        };
+    }
+
+    typedef stick::Result<XMLView> XMLViewResult;
+
+    //the returned view and all views derived from it keep the parsed document alive.
+    STICK_API XMLViewResult parseXMLView(const stick::String & _xml, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API XMLViewResult parseXMLView(const stick::String & _xml, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API XMLViewResult loadXMLView(const stick::String & _path, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API XMLViewResult loadXMLView(const stick::String & _path, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
+    //parses _buffer in place. Names and values of the returned views point into _buffer, so it
+    //has to outlive them. A private (copy on write) memory mapping of a file works, too.
+    STICK_API XMLViewResult parseXMLViewInPlace(char * _buffer, stick::Size _byteCount, stick::Allocator & _alloc = stick::defaultAllocator());
+    STICK_API XMLViewResult parseXMLViewInPlace(char * _buffer, stick::Size _byteCount, const XMLParseOptions & _options, stick::Allocator & _alloc = stick::defaultAllocator());
+}
+
+#endif //SCRUB_XMLVIEW_HPP
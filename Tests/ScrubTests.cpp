@@ -1,9 +1,102 @@
 #include <Stick/Test.hpp>
 #include <Scrub/Shrub.hpp>
+#include <Scrub/Arrow.hpp>
+#include <Scrub/Base64.hpp>
+#include <Scrub/CBORReader.hpp>
+#include <Scrub/ColumnTable.hpp>
+#include <Scrub/MappedView.hpp>
+#include <Scrub/MessageCodec.hpp>
+#include <Scrub/ShrubView.hpp>
+#include <Scrub/XMLView.hpp>
+#include <Scrub/XMLReader.hpp>
+#include <Scrub/Sink.hpp>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h> //for pipe
 
 using namespace scrub;
 using namespace stick;
 
+//forwards to the default allocator and keeps track of what is in use
+class CountingAllocator : public Allocator
+{
+public:
+
+    CountingAllocator() :
+        allocationCount(0),
+        bytesInUse(0)
+    {
+    }
+
+    mem::Block allocate(Size _byteCount, Size _alignment) override
+    {
+        ++allocationCount;
+        bytesInUse += _byteCount;
+        return defaultAllocator().allocate(_byteCount, _alignment);
+    }
+
+    void deallocate(const mem::Block & _block) override
+    {
+        bytesInUse -= _block.byteCount;
+        defaultAllocator().deallocate(_block);
+    }
+
+    Size allocationCount;
+    Size bytesInUse;
+};
+
+//writes the events of an XMLReader into a compact string
+class XMLEventRecorder : public XMLHandler
+{
+public:
+
+    void startElement(StringSpan _name, XMLAttributeSpans _attributes) override
+    {
+        events.append("<");
+        events.append(_name.ptr(), _name.count());
+        for (const XMLAttributeSpan & attr : _attributes)
+        {
+            events.append(" ");
+            events.append(attr.name.ptr(), attr.name.count());
+            events.append("=");
+            events.append(attr.value.ptr(), attr.value.count());
+        }
+        events.append(">");
+    }
+
+    void text(StringSpan _text) override
+    {
+        events.append(_text.ptr(), _text.count());
+    }
+
+    void endElement(StringSpan _name) override
+    {
+        events.append("</");
+        events.append(_name.ptr(), _name.count());
+        events.append(">");
+    }
+
+    String events;
+};
+
+class XMLSubtreeCollector : public XMLSubtreeHandler
+{
+public:
+
+    XMLSubtreeCollector(const String & _path) :
+        XMLSubtreeHandler(_path)
+    {
+    }
+
+    void subtree(Shrub & _shrub) override
+    {
+        subtrees.append(_shrub);
+    }
+
+    DynamicArray<Shrub> subtrees;
+};
+
 const Suite spec[] =
 {
     SUITE("Basic Tests")
@@ -84,6 +177,144 @@ const Suite spec[] =
         EXPECT(failTreeResult == false);
         EXPECT(failTreeResult.error() == ec::ParseFailed);
     },
+    SUITE("Lazy JSON Tests")
+    {
+        String testJSON =
+            "{ \n"
+            "   \"encoding\" : \"UTF-8\\n\\u00e4\", \n"
+            "   \"plug-ins\" : [ \n"
+            "           \"python\", \n"
+            "           \"c++\", \n"
+            "           \"ruby\" \n"
+            "           ], \n"
+            "   \"indent\" : { \"length\" : 3, \"use_space\": true, \"scale\" : -1.5e2, \"nested\" : [[1], {}] } \n"
+            "} ";
+
+        Shrub tree = parseJSONLazy(testJSON).ensure();
+        EXPECT(!tree.isExpanded());
+        EXPECT(tree.count() == 3);
+        EXPECT(tree.isExpanded());
+        EXPECT(!tree.child("indent").ensure().isExpanded());
+        EXPECT(!tree.child("plug-ins").ensure().isExpanded());
+        EXPECT(tree.child("encoding").ensure().valueString() == "UTF-8\n\xc3\xa4");
+        EXPECT(tree.maybe<Int32>("indent.length").ensure() == 3);
+        EXPECT(tree.child("indent").ensure().isExpanded());
+        EXPECT(!tree.child("indent.nested").ensure().isExpanded());
+        EXPECT(tree.maybe<bool>("indent.use_space").ensure() == true);
+        EXPECT(tree.maybe<Float64>("indent.scale").ensure() == -150.0);
+
+        //copies share the unexpanded source
+        Shrub copy = tree.child("plug-ins").ensure();
+        String expected[3] = {"python", "c++", "ruby"};
+        Size i = 0;
+        for (const auto & child : copy)
+        {
+            EXPECT(child.valueString() == expected[i]);
+            ++i;
+        }
+        EXPECT(!tree.child("plug-ins").ensure().isExpanded());
+
+        //lazy and eager parsing build the same tree
+        EXPECT(exportJSON(tree).ensure() == exportJSON(parseJSON(testJSON).ensure()).ensure());
+
+        EXPECT(parseJSONLazy("{").error() == ec::ParseFailed);
+        EXPECT(parseJSONLazy("{\"a\" : [1, 2,]}").error() == ec::ParseFailed);
+        EXPECT(parseJSONLazy("{\"a\" : \"\\x\"}").error() == ec::ParseFailed);
+        EXPECT(parseJSONLazy("{} {}").error() == ec::ParseFailed);
+
+        //both accept and reject the same documents and decode them the same way
+        const char * documents[] = {
+            "{\"a\" : \"\\u0000x\", \"b\\u0000\" : 1}",
+            "{\"a\" : \"\\uD83D\\uDE00\\u00e4\\/\"}",
+            "{\"a\" : [0.30000000000000004, 0.3, 1e-320, 123456789012345678901234, 2147483647, -2147483649, -0, 1E400, 5e-99999999999]}",
+            "{\"b\" : 1, \"a\" : 2, \"bb\" : 3, \"a\" : 4}",
+            "{\"a\" : \"\\uDC00\"}",
+            "{\"a\" : \"\\uD800\"}",
+            "{\"a\" : -}",
+            "{\"a\" : 1.}",
+            "{\"a\" : 1e+}",
+            "{\"a\" : }",
+            "{\"a\" : 1, \"b\" : }",
+            "[1, ]",
+            "[1, 2]",
+            "[]",
+            "[{\"a\" : [1]}, [], \"x\"]"
+        };
+        for (const char * json : documents)
+        {
+            auto eager = parseJSON(json);
+            auto lazy = parseJSONLazy(json);
+            EXPECT(static_cast<bool>(eager) == static_cast<bool>(lazy));
+            if (eager && lazy)
+                EXPECT(exportJSON(lazy.get()).ensure() == exportJSON(eager.get()).ensure());
+        }
+        Shrub zeros = parseJSON(documents[0]).ensure();
+        EXPECT(zeros.child("a").ensure().valueString() == String("\0x", 2));
+        EXPECT(parseJSONLazy(documents[0]).ensure().child("a").ensure().valueString() == String("\0x", 2));
+        EXPECT(parseJSON(documents[4]).error() == ec::ParseFailed);
+        EXPECT(parseJSON(documents[9]).error() == ec::ParseFailed);
+        Shrub arrayRoot = parseJSON(documents[12]).ensure();
+        EXPECT(arrayRoot.valueHint() == ValueHint::JSONArray && arrayRoot.count() == 2);
+        EXPECT(exportJSON(parseJSON(documents[13]).ensure()).ensure() == "[]");
+        JSONParseOptions packed;
+        packed.bPackNumberArrays = true;
+        EXPECT(parseJSON(documents[12], packed).ensure().arrayType() == ArrayType::Int32);
+    },
+    SUITE("JSON View Tests")
+    {
+        String testJSON =
+            "{ \n"
+            "   \"encoding\" : \"UTF-8\", \n"
+            "   \"plug-ins\" : [ \n"
+            "           \"python\", \n"
+            "           \"c++\", \n"
+            "           \"ruby\" \n"
+            "           ], \n"
+            "   \"indent\" : { \"length\" : 3, \"use_space\": true, \"scale\" : 0.5 } \n"
+            "} ";
+
+        ShrubView view = parseJSONView(testJSON).ensure();
+        EXPECT(view.count() == 3);
+        EXPECT(view.valueHint() == ValueHint::JSONObject);
+        EXPECT(view.child("encoding").ensure().stringValue() == "UTF-8");
+        EXPECT(view.child("encoding").ensure().name() == "encoding");
+        EXPECT(view.maybe<String>("encoding").ensure() == "UTF-8");
+        EXPECT(view.child("plug-ins").ensure().valueHint() == ValueHint::JSONArray);
+        String expected[3] = {"python", "c++", "ruby"};
+        Size i = 0;
+        ShrubView plugins = view.child("plug-ins").ensure();
+        for (auto child : plugins)
+        {
+            EXPECT(child.stringValue() == expected[i]);
+            ++i;
+        }
+        EXPECT(i == 3);
+        EXPECT(view.maybe<Int32>("indent.length").ensure() == 3);
+        EXPECT(view.child("indent.length").ensure().valueHint() == ValueHint::JSONInt);
+        EXPECT(view.maybe<bool>("indent.use_space").ensure() == true);
+        EXPECT(view.maybe<Float32>("indent.scale").ensure() == 0.5f);
+        EXPECT(!view.child("indent.missing"));
+        EXPECT(!view.child("encoding.foo"));
+        EXPECT(view.maybe<Int32>("nope", 5) == 5);
+
+        //child views keep the document alive
+        ShrubView indent = view.child("indent").ensure();
+        view = ShrubView();
+        EXPECT(indent.get<Int32>("length") == 3);
+
+        EXPECT(parseJSONView("{").error() == ec::ParseFailed);
+
+        //the text and the structure come from the allocator
+        CountingAllocator alloc;
+        {
+            ShrubView counted = parseJSONView(testJSON, alloc).ensure();
+            EXPECT(alloc.bytesInUse >= testJSON.length() * (1 + sizeof(Size)));
+            EXPECT(counted.get<Int32>("indent.length") == 3);
+        }
+        EXPECT(alloc.bytesInUse == 0);
+        EXPECT(parseJSONView("{", alloc).error() == ec::ParseFailed);
+        EXPECT(alloc.bytesInUse == 0);
+    },
     SUITE("Parse XML Tests")
     {
         String testXML =
@@ -117,6 +348,1567 @@ const Suite spec[] =
         auto broken = parseXML(invalidXML);
         EXPECT(broken == false);
         EXPECT(broken.error() == ec::ParseFailed);
+
+        //parse options
+        String optionsXML =
+            "<?xml version='1.0'?>\n"
+            "<!-- leading comment -->\n"
+            "<root attr='a\tb'>\n"
+            "<!-- note -->\n"
+            "<?tool run?>\n"
+            "<text>a &amp; b</text>\n"
+            "</root>\n";
+
+        Shrub defaults = parseXML(optionsXML).ensure();
+        EXPECT(defaults.name() == "root");
+        EXPECT(defaults.count() == 2);
+        EXPECT(defaults.maybe<const String &>("text").ensure() == "a & b");
+        EXPECT(defaults.maybe<const String &>("attr").ensure() == "a b");
+
+        Shrub minimal = parseXML(optionsXML, XMLParseOptions::minimal()).ensure();
+        EXPECT(minimal.maybe<const String &>("text").ensure() == "a &amp; b");
+        EXPECT(minimal.maybe<const String &>("attr").ensure() == "a\tb");
+        EXPECT(parseXML(optionsXML, XMLParseOptions::fast()).ensure().maybe<const String &>("text").ensure() == "a & b");
+
+        XMLParseOptions keepAll;
+        keepAll.bKeepComments = true;
+        keepAll.bKeepProcessingInstructions = true;
+        Shrub full = parseXML(optionsXML, keepAll).ensure();
+        EXPECT(full.name() == "root");
+        EXPECT(full.count() == 4);
+        auto comment = full.find([](const Shrub & _s) { return _s.valueHint() == ValueHint::XMLComment; });
+        EXPECT(comment);
+        EXPECT((*comment).valueString() == " note ");
+        EXPECT(full.child("tool").ensure().valueHint() == ValueHint::XMLProcessingInstruction);
+        EXPECT(full.maybe<const String &>("tool").ensure() == "run");
+        EXPECT(exportXML(full).ensure() == exportXML(parseXML(exportXML(full).ensure(), keepAll).ensure()).ensure());
+
+        //CDATA sections are text, unless they aren't kept
+        String cdataXML = "<root><a><![CDATA[x < y]]></a><b>1<![CDATA[2]]></b></root>";
+        Shrub cdata = parseXML(cdataXML).ensure();
+        EXPECT(cdata.maybe<const String &>("a").ensure() == "x < y");
+        EXPECT(cdata.child("b").ensure().valueString() == "1");
+        EXPECT(cdata.child("b").ensure().count() == 1);
+        EXPECT((*cdata.child("b").ensure().begin()).valueString() == "2");
+        XMLParseOptions dropCDATA;
+        dropCDATA.bKeepCDATA = false;
+        EXPECT(parseXML(cdataXML, dropCDATA).ensure().maybe<const String &>("a").ensure() == "");
+    },
+    SUITE("XML View Tests")
+    {
+        String testXML =
+            "<debug version = '1.3'>\n"
+            "<filename>debug.log</filename>\n"
+            "<modules count='3'>\n"
+            "<module>Finance</module>\n"
+            "<module>Admin</module>\n"
+            "<module>HR</module>\n"
+            "</modules>\n"
+            "<level>2</level>\n"
+            "</debug>\n";
+
+        XMLView view = parseXMLView(testXML).ensure();
+        Shrub tree = parseXML(testXML).ensure();
+        EXPECT(view.count() == tree.count());
+        EXPECT(view.count() == 4);
+        EXPECT(String(view.name()) == "debug");
+        EXPECT(view.maybe<Float32>("version").ensure() == 1.3f);
+        EXPECT(view.child("version").ensure().valueHint() == ValueHint::XMLAttribute);
+        EXPECT(view.child("filename").ensure().valueString() == "debug.log");
+        EXPECT(view.maybe<String>("filename").ensure() == "debug.log");
+        EXPECT(view.child("filename").ensure().count() == 0);
+        EXPECT(view.get<Int32>("modules.count") == 3);
+        EXPECT(view.get<Int32>("level") == 2);
+        EXPECT(!view.child("modules.missing"));
+
+        //same children in the same order as the parsed Shrub
+        XMLView modules = view.child("modules").ensure();
+        auto it = tree.child("modules").ensure().begin();
+        Size i = 0;
+        for (auto child : modules)
+        {
+            EXPECT(child.valueString() == (*it).valueString());
+            EXPECT(String(child.name()) == (*it).name());
+            ++it;
+            ++i;
+        }
+        EXPECT(i == 4);
+
+        EXPECT(parseXMLView("<start>").error() == ec::ParseFailed);
+
+        //comments, processing instructions and CDATA follow the parse options like they do for parseXML
+        String optionsXML = "<root a='1'><!-- note --><?tool run?><b><![CDATA[x < y]]></b>tail</root>";
+        XMLParseOptions keepAll;
+        keepAll.bKeepComments = true;
+        keepAll.bKeepProcessingInstructions = true;
+        for (const XMLParseOptions & options : {XMLParseOptions(), keepAll, XMLParseOptions::minimal()})
+        {
+            XMLView optionsView = parseXMLView(optionsXML, options).ensure();
+            Shrub optionsTree = parseXML(optionsXML, options).ensure();
+            EXPECT(optionsView.count() == optionsTree.count());
+            auto treeIt = optionsTree.begin();
+            for (auto child : optionsView)
+            {
+                EXPECT(String(child.name()) == (*treeIt).name());
+                EXPECT(child.valueString() == (*treeIt).valueString());
+                EXPECT(child.valueHint() == (*treeIt).valueHint());
+                ++treeIt;
+            }
+            EXPECT(optionsView.child("b").ensure().valueString() == optionsTree.child("b").ensure().valueString());
+        }
+        EXPECT(parseXMLView(optionsXML, keepAll).ensure().count() == 4);
+        EXPECT(parseXMLView(optionsXML, keepAll).ensure().child("tool").ensure().valueHint() == ValueHint::XMLProcessingInstruction);
+        EXPECT(parseXMLView(optionsXML).ensure().child("b").ensure().valueString() == "x < y");
+
+        //the value text is found once per iteration rather than once per step, so elements with
+        //many children iterate in linear time
+        String manyXML = "<root>";
+        for (Size i = 0; i < 40000; ++i)
+            manyXML.append(i == 20000 ? "<e/>text" : "<e/>");
+        manyXML.append("more</root>");
+        XMLView many = parseXMLView(manyXML).ensure();
+        EXPECT(many.count() == 40001);
+        EXPECT(many.valueString() == "text");
+        Size lastText = 0;
+        for (auto child : many)
+            lastText = child.valueString() == "more" ? lastText + 1 : lastText;
+        EXPECT(lastText == 1);
+
+        //in place parsing references the caller's buffer
+        char buffer[] = "<root a='1'><b>text</b></root>";
+        XMLView inPlace = parseXMLViewInPlace(buffer, sizeof(buffer) - 1).ensure();
+        EXPECT(inPlace.child("b").ensure().valueCString() >= buffer);
+        EXPECT(inPlace.child("b").ensure().valueCString() < buffer + sizeof(buffer));
+        EXPECT(inPlace.get<Int32>("a") == 1);
+
+        char buffer2[] = "<root a='1'><b>text</b></root>";
+        Shrub inPlaceTree = parseXMLInPlace(buffer2, sizeof(buffer2) - 1).ensure();
+        EXPECT(inPlaceTree.maybe<const String &>("b").ensure() == "text");
+        EXPECT(inPlaceTree.get<Int32>("a") == 1);
+    },
+    SUITE("XML Allocator Tests")
+    {
+        String xml = "<config level='2'><filename>debug.log</filename><!-- note --><modules count='3'><module>Finance</module></modules></config>";
+
+        CountingAllocator alloc;
+        {
+            Shrub tree = parseXML(xml, alloc).ensure();
+            EXPECT(alloc.allocationCount > 0);
+            EXPECT(&tree.allocator() == &alloc);
+            EXPECT(&tree.child("filename").ensure().allocator() == &alloc);
+            EXPECT(tree.get<Int32>("level") == 2);
+
+            //pugi's document is gone, only the Shrub is left
+            Size treeBytes = alloc.bytesInUse;
+            {
+                auto exported = exportXML(tree);
+            }
+            EXPECT(alloc.bytesInUse == treeBytes);
+        }
+        EXPECT(alloc.bytesInUse == 0);
+
+        CountingAllocator viewAlloc;
+        {
+            XMLView view = parseXMLView(xml, viewAlloc).ensure();
+            EXPECT(viewAlloc.allocationCount > 0);
+            EXPECT(view.get<Int32>("modules.count") == 3);
+
+            //parsing with another allocator in between must not mix up the blocks
+            CountingAllocator other;
+            Shrub tree = parseXML(xml, other).ensure();
+            EXPECT(tree.get<Int32>("level") == 2);
+        }
+        EXPECT(viewAlloc.bytesInUse == 0);
+    },
+    SUITE("XML Reader Tests")
+    {
+        String xml =
+            "<?xml version='1.0'?>\n"
+            "<!DOCTYPE catalog [ <!ENTITY x 'y'> ]>\n"
+            "<catalog name='My &amp; Books'>\n"
+            "    <!-- the <books> -->\n"
+            "    <book id=\"1\"><title>Dune</title><price>9.5</price></book>\n"
+            "    <book id='2'><title>A &lt;B&gt; &#67;&#x44;</title><![CDATA[<raw>]]></book>\n"
+            "    <empty/>\n"
+            "</catalog>\n";
+        String expected = "<catalog name=My & Books><book id=1><title>Dune</title><price>9.5</price></book>"
+                          "<book id=2><title>A <B> CD</title><raw></book><empty></empty></catalog>";
+
+        //the events don't depend on how the input is split up
+        for (Size chunkSize : {Size(1), Size(3), Size(16), Size(4096)})
+        {
+            XMLEventRecorder recorder;
+            XMLReader reader(recorder, chunkSize);
+            for (Size i = 0; i < xml.length(); i += 5)
+            {
+                Size count = xml.length() - i < 5 ? xml.length() - i : 5;
+                EXPECT(!reader.feed(xml.cString() + i, count));
+            }
+            EXPECT(!reader.finish());
+            EXPECT(recorder.events == expected);
+        }
+
+        //long text is reported in pieces without splitting entities
+        {
+            String longXML = "<a>";
+            for (Size i = 0; i < 100; ++i)
+                longXML.append("x&amp;\r\n");
+            longXML.append("</a>");
+            XMLEventRecorder recorder;
+            XMLReader reader(recorder, 8);
+            EXPECT(!reader.feed(longXML.cString(), longXML.length()));
+            EXPECT(!reader.finish());
+            String expectedText = "<a>";
+            for (Size i = 0; i < 100; ++i)
+                expectedText.append("x&\n");
+            expectedText.append("</a>");
+            EXPECT(recorder.events == expectedText);
+        }
+
+        //subtrees match what parseXML produces for them
+        {
+            XMLSubtreeCollector collector("catalog.book");
+            XMLReader reader(collector, 7);
+            EXPECT(!reader.feed(xml.cString(), xml.length()));
+            EXPECT(!reader.finish());
+            EXPECT(collector.subtrees.count() == 2);
+            Shrub tree = parseXML(xml).ensure();
+            EXPECT(exportXML(collector.subtrees[0]).ensure() == exportXML(tree.child("book").ensure()).ensure());
+            EXPECT(collector.subtrees[0].get<Int32>("id") == 1);
+            EXPECT(collector.subtrees[0].get<Float32>("price") == 9.5f);
+            EXPECT(collector.subtrees[1].maybe<const String &>("title").ensure() == "A <B> CD");
+            EXPECT(collector.subtrees[1].valueString() == "<raw>");
+        }
+
+        //comments, processing instructions and CDATA end a text like they do for parseXML, and a
+        //byte order mark is skipped
+        for (const char * doc : {"<a>foo<!--c-->bar</a>", "<a>foo<![CDATA[x]]>bar<b>y</b>z</a>", "<a>foo<?pi x?>bar</a>",
+                                 "<a><![CDATA[x]]><![CDATA[y]]></a>", "<a>foo <!--c--> <b/> </a>", "\xEF\xBB\xBF<a x='1'>bom</a>"})
+        {
+            String docXML(doc);
+            Shrub tree = parseXML(docXML).ensure();
+            for (Size chunkSize : {Size(1), Size(4), Size(4096)})
+            {
+                XMLSubtreeCollector collector("a");
+                XMLReader reader(collector, chunkSize);
+                for (Size i = 0; i < docXML.length(); ++i)
+                    EXPECT(!reader.feed(docXML.cString() + i, 1));
+                EXPECT(!reader.finish());
+                EXPECT(collector.subtrees.count() == 1);
+                EXPECT(exportJSON(collector.subtrees[0]).ensure() == exportJSON(tree).ensure());
+            }
+        }
+
+        //reading from a file descriptor
+        {
+            int fds[2];
+            EXPECT(pipe(fds) == 0);
+            EXPECT(write(fds[1], xml.cString(), xml.length()) == (ssize_t)xml.length());
+            close(fds[1]);
+            XMLSubtreeCollector collector("catalog");
+            EXPECT(!readXML(fds[0], collector, 16));
+            close(fds[0]);
+            EXPECT(collector.subtrees.count() == 1);
+            EXPECT(collector.subtrees[0].get<const String &>("book.title") == "Dune");
+        }
+
+        auto parseError = [](const char * _xml)
+        {
+            XMLEventRecorder recorder;
+            XMLReader reader(recorder);
+            Error err = reader.feed(_xml, std::strlen(_xml));
+            if (!err)
+                err = reader.finish();
+            return err;
+        };
+        EXPECT(parseError("<a><b></a>") == ec::ParseFailed);
+        EXPECT(parseError("<a>") == ec::ParseFailed);
+        EXPECT(parseError("<a x=1></a>") == ec::ParseFailed);
+        EXPECT(parseError("text<a></a>") == ec::ParseFailed);
+        EXPECT(parseError("<a></a><b></b>") == ec::ParseFailed);
+        EXPECT(parseError("") == ec::ParseFailed);
+        EXPECT(!parseError("<a x='>'/>"));
+    },
+    SUITE("XML Export Tests")
+    {
+        Shrub tree;
+        tree.setName("config");
+        tree.append(Shrub("version", "1 \"beta\"", ValueHint::XMLAttribute));
+        tree.set("filename", String("debug.log"));
+        tree.set("note", String("a < b & c"));
+        tree.append(Shrub("", "generated", ValueHint::XMLComment));
+        Shrub items("items");
+        items.append(Shrub("", "1"));
+        items.append(Shrub("", "2"));
+        tree.append(items);
+        tree.append(Shrub("empty"));
+
+        String compact = exportXML(tree).ensure();
+        EXPECT(compact == "<?xml version=\"1.0\"?><config version=\"1 &quot;beta&quot;\"><filename>debug.log</filename>"
+                          "<note>a &lt; b &amp; c</note><!--generated--><items><itemsChild>1</itemsChild><itemsChild>2</itemsChild>"
+                          "</items><empty /></config>");
+
+        String pretty = exportXML(tree, true).ensure();
+        EXPECT(pretty == "<?xml version=\"1.0\"?>\n"
+                         "<config version=\"1 &quot;beta&quot;\">\n"
+                         "    <filename>debug.log</filename>\n"
+                         "    <note>a &lt; b &amp; c</note>\n"
+                         "    <!--generated-->\n"
+                         "    <items>\n"
+                         "        <itemsChild>1</itemsChild>\n"
+                         "        <itemsChild>2</itemsChild>\n"
+                         "    </items>\n"
+                         "    <empty />\n"
+                         "</config>\n");
+
+        //both parse back to the same tree
+        Shrub parsed = parseXML(pretty).ensure();
+        EXPECT(parsed.maybe<const String &>("version").ensure() == "1 \"beta\"");
+        EXPECT(parsed.maybe<const String &>("note").ensure() == "a < b & c");
+        XMLParseOptions keepComments;
+        keepComments.bKeepComments = true;
+        EXPECT(exportXML(parseXML(compact, keepComments).ensure()).ensure() == compact);
+
+        //sequences that would end a comment or processing instruction early are split
+        Shrub unsafe("unsafe");
+        unsafe.append(Shrub("", "a--b-", ValueHint::XMLComment));
+        unsafe.append(Shrub("tool", "x?>y", ValueHint::XMLProcessingInstruction));
+        String unsafeXML = exportXML(unsafe).ensure();
+        EXPECT(unsafeXML == "<?xml version=\"1.0\"?><unsafe><!--a- -b- --><?tool x? >y?></unsafe>");
+        XMLParseOptions keepAll;
+        keepAll.bKeepComments = true;
+        keepAll.bKeepProcessingInstructions = true;
+        Shrub unsafeParsed = parseXML(unsafeXML, keepAll).ensure();
+        EXPECT(unsafeParsed.count() == 2);
+        EXPECT((*unsafeParsed.begin()).valueString() == "a- -b- ");
+        EXPECT(unsafeParsed.child("tool").ensure().valueString() == "x? >y");
+
+        //streaming into a callback
+        String collected;
+        Size callCount = 0;
+        struct Collector
+        {
+            String * text;
+            Size * calls;
+        } collector = {&collected, &callCount};
+        CallbackSink callbackSink([](const char * _data, Size _byteCount, void * _userData)
+        {
+            Collector * c = static_cast<Collector *>(_userData);
+            c->text->append(_data, _byteCount);
+            ++*c->calls;
+            return Error();
+        }, &collector);
+        EXPECT(!exportXML(tree, callbackSink, true));
+        EXPECT(collected == pretty);
+        //small documents fit into the export buffer
+        EXPECT(callCount == 1);
+
+        //errors of the sink are reported
+        CallbackSink failingSink([](const char *, Size, void *)
+        {
+            return Error(ec::InvalidOperation, "full", STICK_FILE, STICK_LINE);
+        });
+        EXPECT(exportXML(tree, failingSink) == ec::InvalidOperation);
+
+        int fds[2];
+        EXPECT(pipe(fds) == 0);
+        FileDescriptorSink fdSink(fds[1]);
+        EXPECT(!exportXML(tree, fdSink));
+        close(fds[1]);
+        char buffer[1024];
+        ssize_t bytesRead = read(fds[0], buffer, sizeof(buffer));
+        close(fds[0]);
+        EXPECT(String(buffer, bytesRead) == compact);
+
+        //unnamed elements are named after their parent, an unnamed root is Child
+        Shrub unnamed;
+        unnamed.append(Shrub("", "1"));
+        EXPECT(exportXML(unnamed).ensure() == "<?xml version=\"1.0\"?><Child><ChildChild>1</ChildChild></Child>");
+
+        //the children of elements with text aren't indented, so that the text parses back the same
+        Shrub mixed("p");
+        mixed.setValue("some ");
+        mixed.append(Shrub("b", "bold"));
+        Shrub & outer = mixed.append(Shrub("span"));
+        outer.append(Shrub("i", "nested"));
+        String mixedPretty = exportXML(mixed, true).ensure();
+        EXPECT(mixedPretty == "<?xml version=\"1.0\"?>\n<p>some <b>bold</b><span><i>nested</i></span></p>\n");
+        Shrub mixedParsed = parseXML(mixedPretty).ensure();
+        EXPECT(mixedParsed.valueString() == "some ");
+        EXPECT(exportXML(mixedParsed, true).ensure() == mixedPretty);
+        EXPECT(exportXML(mixedParsed).ensure() == exportXML(mixed).ensure());
+    },
+    SUITE("JSON Sink Tests")
+    {
+        Shrub tree;
+        tree.set("name", String("sink"));
+        tree.set("count", 3);
+        tree.append("values", 1);
+        tree.append("values", 2);
+        //larger than the export buffer, goes out in a vectored write
+        String big;
+        big.resize(100000);
+        for (Size i = 0; i < big.length(); ++i)
+            big[i] = 'a' + i % 26;
+        tree.set("big", big);
+
+        for (bool bPrettify : {false, true})
+        {
+            String expected = exportJSON(tree, bPrettify).ensure();
+            EXPECT(parseJSON(expected).ensure().get<const String &>("big") == big);
+
+            String collected;
+            StringSink stringSink(collected);
+            EXPECT(!exportJSON(tree, stringSink, bPrettify));
+            EXPECT(collected == expected);
+
+            char path[] = "/tmp/ScrubTestsXXXXXX";
+            int fd = mkstemp(path);
+            EXPECT(fd >= 0);
+            FileDescriptorSink fdSink(fd);
+            EXPECT(!exportJSON(tree, fdSink, bPrettify));
+            EXPECT(lseek(fd, 0, SEEK_SET) == 0);
+            String written;
+            written.resize(expected.length() + 1);
+            ssize_t bytesRead = 0, r;
+            while ((r = read(fd, &written[0] + bytesRead, written.length() - bytesRead)) > 0)
+                bytesRead += r;
+            close(fd);
+            unlink(path);
+            EXPECT(bytesRead == (ssize_t)expected.length());
+            written.resize(bytesRead);
+            EXPECT(written == expected);
+        }
+    },
+    SUITE("JSON Measure Tests")
+    {
+        Shrub tree = parseJSON("{\"name\" : \"measure\", \"values\" : [1, 2.5, true, {\"a\" : \"b\"}], \"empty\" : \"\"}").ensure();
+
+        for (bool bPrettify : {false, true})
+        {
+            String expected = exportJSON(tree, bPrettify).ensure();
+            Size byteCount = measureJSON(tree, bPrettify);
+            EXPECT(byteCount == expected.length());
+
+            //too small, reports the size that is needed without writing past the end
+            char small[16];
+            std::memset(small, 'x', sizeof(small));
+            EXPECT(exportJSONInto(tree, small, 8, bPrettify) == byteCount);
+            EXPECT(small[8] == 'x');
+
+            char buffer[512];
+            EXPECT(exportJSONInto(tree, buffer, sizeof(buffer), bPrettify) == byteCount);
+            EXPECT(String(buffer, byteCount) == expected);
+        }
+    },
+    SUITE("JSON Escape Tests")
+    {
+        Shrub tree;
+        //in the key order of the parser
+        tree.set("plain", String("nothing to see here, but long enough for a full vector"));
+        tree.set("quote\"key", String("say \"hi\"\\ \n\ttab \x01 and a long clean tail without anything special"));
+        EXPECT(!tree.child("plain").ensure().isValueKnownClean());
+
+        String json = exportJSON(tree).ensure();
+        EXPECT(json == "{\"plain\" : \"nothing to see here, but long enough for a full vector\","
+                       "\"quote\\\"key\" : \"say \\\"hi\\\"\\\\ \\n\\ttab \\u0001 and a long clean tail without anything special\"}");
+        EXPECT(measureJSON(tree) == json.length());
+
+        //the parser marks what it found clean and the round trip restores the original strings
+        Shrub parsed = parseJSON(json).ensure();
+        const Shrub & quoted = parsed.child("quote\"key").ensure();
+        EXPECT(quoted.valueString() == tree.child("quote\"key").ensure().valueString());
+        EXPECT(!quoted.isNameKnownClean());
+        EXPECT(!quoted.isValueKnownClean());
+        EXPECT(parsed.child("plain").ensure().isNameKnownClean());
+        EXPECT(parsed.child("plain").ensure().isValueKnownClean());
+        EXPECT(exportJSON(parsed).ensure() == json);
+
+        Shrub lazy = parseJSONLazy(json).ensure();
+        EXPECT(lazy.child("plain").ensure().isValueKnownClean());
+        EXPECT(!lazy.child("quote\"key").ensure().isValueKnownClean());
+        EXPECT(exportJSON(lazy).ensure() == json);
+
+        //changing a value drops the mark
+        parsed.child("plain").ensure().setValue("\"");
+        EXPECT(!parsed.child("plain").ensure().isValueKnownClean());
+        EXPECT(parseJSON(exportJSON(parsed).ensure()).ensure().get<const String &>("plain") == "\"");
+
+        //non JSON hints are strings, too
+        Shrub attributes;
+        attributes.append(Shrub("id", "a\"b", ValueHint::XMLAttribute));
+        EXPECT(exportJSON(attributes).ensure() == "{\"id\" : \"a\\\"b\"}");
+    },
+    SUITE("JSON Exporter Structure Tests")
+    {
+        //empty containers keep their kind
+        Shrub empty = parseJSON("{\"a\" : {}, \"b\" : [], \"c\" : [[], {}]}").ensure();
+        EXPECT(exportJSON(empty).ensure() == "{\"a\" : {},\"b\" : [],\"c\" : [[],{}]}");
+        EXPECT(exportJSON(empty, true).ensure() == "{\n    \"a\" : {},\n    \"b\" : [],\n    \"c\" : [\n        [],\n        {}\n    ]\n}\n");
+
+        //named children make an object even without a hint
+        Shrub mixed;
+        Shrub & list = mixed.append(Shrub("list"));
+        list.append(Shrub("", "1", ValueHint::JSONInt));
+        list.append(Shrub("", "2", ValueHint::JSONInt));
+        Shrub & object = mixed.append(Shrub("object"));
+        object.append(Shrub("", "1", ValueHint::JSONInt));
+        object.append(Shrub("x", "2", ValueHint::JSONInt));
+        EXPECT(exportJSON(mixed).ensure() == "{\"list\" : [1,2],\"object\" : {\"\" : 1,\"x\" : 2}}");
+
+        //nesting far deeper than the inline export stack
+        Shrub deep;
+        Shrub * current = &deep;
+        Size depth = 1000;
+        for (Size i = 0; i < depth; ++i)
+            current = &current->append(Shrub("", ValueHint::JSONArray));
+        current->append(Shrub("", "1", ValueHint::JSONInt));
+
+        String expected;
+        for (Size i = 0; i < depth + 1; ++i)
+            expected.append('[');
+        expected.append('1');
+        for (Size i = 0; i < depth + 1; ++i)
+            expected.append(']');
+        EXPECT(exportJSON(deep).ensure() == expected);
+        EXPECT(measureJSON(deep, true) == exportJSON(deep, true).ensure().length());
+    },
+    SUITE("Parallel Export Tests")
+    {
+        //the large array is nested, with siblings before and after it
+        String json = "{\"name\" : \"assets\", \"items\" : [";
+        for (Size i = 0; i < 1000; ++i)
+        {
+            String idx = toString(static_cast<UInt64>(i));
+            json.append(AppendVariadicFlag(), i ? "," : "", "{\"id\" : ", idx, ", \"tags\" : [\"a\", \"b\\n\"], \"empty\" : {}}");
+        }
+        json.append("], \"count\" : 1000}");
+        Shrub tree = parseJSON(json).ensure();
+        Shrub lazy = parseJSONLazy(json).ensure();
+
+        for (Size threads : {2, 3, 8})
+        {
+            for (bool bPretty : {false, true})
+            {
+                String expected = exportJSON(tree, bPretty).ensure();
+                EXPECT(exportJSONParallel(tree, bPretty, threads).ensure() == expected);
+                EXPECT(exportJSONParallel(lazy, bPretty, threads).ensure() == expected);
+
+                String streamed;
+                StringSink sink(streamed);
+                EXPECT(!exportJSONParallel(tree, sink, bPretty, threads));
+                EXPECT(streamed == expected);
+            }
+        }
+
+        //too small to split
+        Shrub small = parseJSON("{\"a\" : [1, 2]}").ensure();
+        EXPECT(exportJSONParallel(small, false, 4).ensure() == "{\"a\" : [1,2]}");
+
+        Shrub doc("catalog");
+        doc.append(Shrub("version", "2", ValueHint::XMLAttribute));
+        Shrub & books = doc.append(Shrub("books"));
+        books.append(Shrub("shelf", "a<b", ValueHint::XMLAttribute));
+        for (Size i = 0; i < 500; ++i)
+        {
+            Shrub & book = books.append(Shrub());
+            book.append(Shrub("id", toString(static_cast<UInt64>(i)), ValueHint::XMLAttribute));
+            book.append(Shrub("title", "Tom & Jerry"));
+            if (i % 7 == 0)
+                books.append(Shrub("", "note", ValueHint::XMLComment));
+        }
+        doc.append(Shrub("footer", "end"));
+
+        for (Size threads : {2, 5})
+        {
+            for (bool bPretty : {false, true})
+            {
+                String expected = exportXML(doc, bPretty).ensure();
+                EXPECT(exportXMLParallel(doc, bPretty, threads).ensure() == expected);
+
+                String streamed;
+                StringSink sink(streamed);
+                EXPECT(!exportXMLParallel(doc, sink, bPretty, threads));
+                EXPECT(streamed == expected);
+            }
+        }
+
+        //the children of a split element with text aren't indented
+        doc.child("books").ensure().setValue("shelved");
+        EXPECT(exportXMLParallel(doc, true, 4).ensure() == exportXML(doc, true).ensure());
+
+        //caching nodes inside of the chunks neither read nor fill their caches
+        Shrub cached = tree;
+        Shrub & items = cached.child("items").ensure();
+        for (Shrub & item : items)
+            item.setExportCaching(true);
+        Shrub cachedDoc("shelf");
+        for (Size i = 0; i < 40; ++i)
+        {
+            Shrub & book = cachedDoc.append(Shrub("book"));
+            book.append(Shrub("id", toString(static_cast<UInt64>(i)), ValueHint::XMLAttribute));
+            book.append(Shrub("title", "Tom & Jerry"));
+            book.setExportCaching(true);
+        }
+        for (bool bPretty : {false, true})
+        {
+            scrub::detail::ExportCacheKey jsonKey = {bPretty ? scrub::detail::ExportFormat::JSONPretty : scrub::detail::ExportFormat::JSON, bPretty ? 2u : 0u};
+            EXPECT(exportJSONParallel(cached, bPretty, 4).ensure() == exportJSON(tree, bPretty).ensure());
+            EXPECT(!items.begin()->cachedExport(jsonKey));
+            EXPECT(!items.rbegin()->cachedExport(jsonKey));
+
+            scrub::detail::ExportCacheKey xmlKey = {bPretty ? scrub::detail::ExportFormat::XMLPretty : scrub::detail::ExportFormat::XML, bPretty ? 1u : 0u};
+            Shrub plain = cachedDoc;
+            for (Shrub & book : plain)
+                book.setExportCaching(false);
+            EXPECT(exportXMLParallel(cachedDoc, bPretty, 4).ensure() == exportXML(plain, bPretty).ensure());
+            EXPECT(!cachedDoc.begin()->cachedExport(xmlKey));
+            EXPECT(!cachedDoc.rbegin()->cachedExport(xmlKey));
+            //the sequential export fills them
+            EXPECT(exportXML(cachedDoc, bPretty).ensure() == exportXML(plain, bPretty).ensure());
+            EXPECT(cachedDoc.begin()->cachedExport(xmlKey));
+            cachedDoc.begin()->setExportCaching(false);
+            cachedDoc.begin()->setExportCaching(true);
+        }
+    },
+    SUITE("Export Cache Tests")
+    {
+        Shrub tree = parseJSON("{\"a\" : {\"x\" : 1, \"y\" : [1, 2, {\"z\" : \"deep\"}]}, \"b\" : {\"w\" : \"untouched\"}}").ensure();
+        tree.setExportCaching(true);
+
+        //the same output as without the cache, on the first and on every later export
+        auto expectSame = [](const Shrub & _tree)
+        {
+            Shrub plain = _tree;
+            plain.setExportCaching(false);
+            bool ret = true;
+            for (bool bPretty : {false, true})
+            {
+                String expected = exportJSON(plain, bPretty).ensure();
+                ret = ret && exportJSON(_tree, bPretty).ensure() == expected && exportJSON(_tree, bPretty).ensure() == expected &&
+                      exportXML(_tree, bPretty).ensure() == exportXML(plain, bPretty).ensure();
+            }
+            return ret;
+        };
+        EXPECT(expectSame(tree));
+
+        scrub::detail::ExportCacheKey key = {scrub::detail::ExportFormat::JSON, 0};
+        EXPECT(exportJSON(tree).ensure().length());
+        EXPECT(tree.cachedExport(key));
+        EXPECT(tree.child("b").ensure().cachedExport(key));
+
+        //a change outdates the path to the root but not the rest
+        tree.child("a.y").ensure().begin()[2].child("z").ensure().setValue("changed");
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(!tree.child("a").ensure().cachedExport(key));
+        EXPECT(!tree.child("a.y").ensure().cachedExport(key));
+        EXPECT(tree.child("b").ensure().cachedExport(key));
+        EXPECT(expectSame(tree));
+        //a node keeps the output of the format it was last exported in
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(exportJSON(tree).ensure().length());
+        EXPECT(tree.cachedExport(key));
+
+        tree.set("a.x", 5);
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(expectSame(tree));
+
+        tree.child("b.w").ensure().setName("renamed");
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(expectSame(tree));
+
+        tree.child("a").ensure().sort();
+        EXPECT(expectSame(tree));
+
+        //growing moves the children, changes below them still reach the root
+        Shrub & list = tree.child("a.y").ensure();
+        for (Size i = 0; i < 100; ++i)
+            list.append(Shrub("", toString(static_cast<UInt64>(i)), ValueHint::JSONInt));
+        EXPECT(expectSame(tree));
+        list.begin()[2].child("z").ensure().setValue("again");
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(expectSame(tree));
+
+        tree.append(Shrub("c", "new", ValueHint::JSONString));
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(expectSame(tree));
+
+        //assigning replaces the subtree in place
+        Shrub replacement = parseJSON("{\"v\" : true}").ensure();
+        replacement.setName("b");
+        tree.child("b").ensure() = replacement;
+        EXPECT(expectSame(tree));
+
+        tree.setExportCaching(false);
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(!tree.child("b").ensure().cachedExport(key));
+
+        //a caching subtree appended to a caching tree outdates the tree when it changes
+        tree.setExportCaching(true);
+        Shrub nested = parseJSON("{\"n\" : {\"m\" : 1}}").ensure();
+        nested.setName("d");
+        nested.setExportCaching(true);
+        Shrub & appended = tree.append(std::move(nested));
+        EXPECT(exportJSON(tree).ensure().length());
+        EXPECT(appended.cachedExport(key));
+        appended.child("n.m").ensure().setValue("2");
+        EXPECT(!tree.cachedExport(key));
+        EXPECT(expectSame(tree));
+
+        //disabling the outer cache keeps the nested one
+        tree.setExportCaching(false);
+        Shrub & kept = tree.child("d").ensure();
+        EXPECT(kept.isExportCaching());
+        EXPECT(exportJSON(kept).ensure().length());
+        EXPECT(kept.cachedExport(key));
+        kept.child("n.m").ensure().setValue("3");
+        EXPECT(!kept.cachedExport(key));
+        EXPECT(exportJSON(kept).ensure() == "{\"n\" : {\"m\" : 3}}");
+        EXPECT(expectSame(tree));
+
+        //a subtree moved out of a caching tree no longer points into it
+        Shrub cached = parseJSON("{\"p\" : {\"q\" : [1, 2]}}").ensure();
+        cached.setExportCaching(true);
+        EXPECT(exportJSON(cached).ensure().length());
+        Shrub moved = std::move(cached.child("p").ensure());
+        Shrub holder;
+        holder.append(std::move(moved)).child("q").ensure().append(Shrub("", "3", ValueHint::JSONInt));
+        EXPECT(exportJSON(holder).ensure() == "{\"p\" : {\"q\" : [1,2,3]}}");
+    },
+    SUITE("Canonical JSON Tests")
+    {
+        //the insertion order doesn't matter and the trees stay as they are
+        Shrub a = parseJSON("{\"b\" : 1, \"a\" : {\"y\" : [3, 1, 2], \"x\" : \"s\\n\"}, \"ab\" : true}").ensure();
+        Shrub b;
+        b.append(Shrub("ab", "true", ValueHint::JSONBool));
+        Shrub & inner = b.append(Shrub("a", ValueHint::JSONObject));
+        Shrub & y = inner.append(Shrub("y", ValueHint::JSONArray));
+        y.append(Shrub("", "3", ValueHint::JSONInt));
+        y.append(Shrub("", "1", ValueHint::JSONInt));
+        y.append(Shrub("", "2", ValueHint::JSONInt));
+        inner.append(Shrub("x", "s\n", ValueHint::JSONString));
+        b.append(Shrub("b", "1", ValueHint::JSONInt));
+
+        String expected = "{\"a\":{\"x\":\"s\\n\",\"y\":[3,1,2]},\"ab\":true,\"b\":1}";
+        EXPECT(exportJSONCanonical(a).ensure() == expected);
+        EXPECT(exportJSONCanonical(b).ensure() == expected);
+        EXPECT(b.begin()->name() == "ab");
+        EXPECT(b.child("a").ensure().begin()->name() == "y");
+
+        String streamed;
+        StringSink sink(streamed);
+        EXPECT(!exportJSONCanonical(b, sink));
+        EXPECT(streamed == expected);
+
+        //one spelling per number
+        Shrub numbers;
+        const char * ints[][2] = {{"007", "7"}, {"-0", "0"}, {"+5", "5"}, {"-12", "-12"}, {"1.0", "1"}};
+        const char * doubles[][2] = {{"1.50", "1.5"}, {"1e+06", "1000000"}, {"0.1", "0.1"}, {"1e300", "1e300"}, {"-0.0", "0"},
+                                     {"2.0", "2"}, {"1.5e-7", "1.5e-7"}, {"0.30000000000000004", "0.30000000000000004"}, {"nan", "null"},
+                                     {"1e15", "1e15"}, {"123456789012345.6", "123456789012345.6"}, {"0.0001", "0.0001"},
+                                     {"-2.5e-5", "-2.5e-5"}, {"12.5e-1", "1.25"}, {"1.7976931348623157e308", "1.7976931348623157e308"},
+                                     //subnormals have fewer significant digits than 15
+                                     {"5e-324", "5e-324"}, {"1e-310", "1e-310"}, {"-4.9406564584124654e-324", "-5e-324"},
+                                     {"2.2250738585072014e-308", "2.2250738585072014e-308"}, {"1.5e-315", "1.5e-315"}};
+        for (auto & pair : ints)
+        {
+            numbers.set("n", String(pair[0]), ValueHint::JSONInt);
+            EXPECT(exportJSONCanonical(numbers).ensure() == String::concat("{\"n\":", pair[1], "}"));
+        }
+        for (auto & pair : doubles)
+        {
+            numbers.set("n", String(pair[0]), ValueHint::JSONDouble);
+            EXPECT(exportJSONCanonical(numbers).ensure() == String::concat("{\"n\":", pair[1], "}"));
+        }
+
+        //the output is its own canonical form
+        Shrub reparsed = parseJSON(expected).ensure();
+        EXPECT(exportJSONCanonical(reparsed).ensure() == expected);
+    },
+    SUITE("Save Tests")
+    {
+        char dir[] = "/tmp/ScrubSaveTestsXXXXXX";
+        EXPECT(mkdtemp(dir));
+        auto fileCount = [&]()
+        {
+            Size ret = 0;
+            DIR * d = opendir(dir);
+            while (dirent * entry = readdir(d))
+                ret += entry->d_name[0] != '.';
+            closedir(d);
+            return ret;
+        };
+
+        Shrub tree = parseJSON("{\"name\" : \"save\", \"values\" : [1, 2.5, {\"a\" : \"b\"}]}").ensure();
+        String jsonPath = String::concat(dir, "/tree.json");
+        EXPECT(!saveJSON(tree, jsonPath));
+        EXPECT(exportJSON(loadJSON(jsonPath).ensure()).ensure() == exportJSON(tree).ensure());
+        EXPECT(fileCount() == 1);
+
+        //replacing keeps the mode of the old file
+        EXPECT(chmod(jsonPath.cString(), 0640) == 0);
+        SaveOptions options;
+        options.bPrettify = true;
+        options.sync = FileSync::FileAndDirectory;
+        options.bufferSize = 16;
+        tree.set("name", String("saved again"));
+        EXPECT(!saveJSON(tree, jsonPath, options));
+        EXPECT(loadJSON(jsonPath).ensure().get<const String &>("name") == "saved again");
+        struct stat st;
+        EXPECT(stat(jsonPath.cString(), &st) == 0 && (st.st_mode & 0777) == 0640);
+        EXPECT(fileCount() == 1);
+
+        //new files get 0666 minus the umask, like without a temporary file
+        mode_t previousMask = umask(027);
+        String newPath = String::concat(dir, "/new.json");
+        EXPECT(!saveJSON(tree, newPath));
+        umask(previousMask);
+        EXPECT(stat(newPath.cString(), &st) == 0 && (st.st_mode & 0777) == 0640);
+        unlink(newPath.cString());
+
+        String xmlPath = String::concat(dir, "/tree.xml");
+        Shrub doc = parseXML("<root a=\"1\"><child>text</child></root>").ensure();
+        options.bAtomic = false;
+        options.sync = FileSync::None;
+        EXPECT(!saveXML(doc, xmlPath, options));
+        EXPECT(exportXML(loadXML(xmlPath).ensure()).ensure() == exportXML(doc).ensure());
+        EXPECT(fileCount() == 2);
+
+        //nothing is left behind when saving fails or isn't committed
+        EXPECT(saveJSON(tree, String::concat(dir, "/missing/tree.json")));
+        {
+            FileSink sink;
+            EXPECT(!sink.open(String::concat(dir, "/uncommitted.json")));
+            EXPECT(!sink.write("{}", 2));
+        }
+        EXPECT(fileCount() == 2);
+        {
+            //the file written in place stays
+            FileSink sink(FileSync::None, false);
+            EXPECT(!sink.open(xmlPath));
+            EXPECT(!sink.write("<a/>", 4));
+        }
+        EXPECT(fileCount() == 2);
+        EXPECT(exportXML(loadXML(xmlPath).ensure()).ensure() == exportXML(parseXML("<a/>").ensure()).ensure());
+
+        unlink(jsonPath.cString());
+        unlink(xmlPath.cString());
+        rmdir(dir);
+    },
+    SUITE("Binary Tests")
+    {
+        Shrub tree = parseJSON("{\"name\" : \"bin\", \"values\" : [1, 2.5, true, {\"name\" : \"nested\"}], \"empty\" : {}}").ensure();
+        Shrub & doc = tree.append(Shrub("doc"));
+        doc.append(Shrub("id", "7", ValueHint::XMLAttribute));
+        doc.append(Shrub("", " comment ", ValueHint::XMLComment));
+        doc.append(Shrub("raw", String("a\0b\xff", 4), ValueHint::None));
+
+        String bytes = exportBinary(tree).ensure();
+        Shrub loaded = parseBinary(bytes).ensure();
+        EXPECT(exportBinary(loaded).ensure() == bytes);
+        EXPECT(exportJSON(loaded).ensure() == exportJSON(tree).ensure());
+        EXPECT(loaded.child("values").ensure().valueHint() == ValueHint::JSONArray);
+        EXPECT(loaded.child("doc.id").ensure().valueHint() == ValueHint::XMLAttribute);
+        EXPECT(loaded.child("doc.raw").ensure().valueString() == String("a\0b\xff", 4));
+        EXPECT(loaded.child("name").ensure().isValueKnownClean());
+        EXPECT(!loaded.child("doc.raw").ensure().isValueKnownClean());
+
+        String streamed;
+        StringSink sink(streamed);
+        EXPECT(!exportBinary(tree, sink));
+        EXPECT(streamed == bytes);
+
+        //deep trees don't recurse
+        Shrub deep;
+        Shrub * current = &deep;
+        for (Size i = 0; i < 1000; ++i)
+            current = &current->append(Shrub("level", ValueHint::JSONObject));
+        current->append(Shrub("leaf", "1", ValueHint::JSONInt));
+        EXPECT(exportJSON(parseBinary(exportBinary(deep).ensure()).ensure()).ensure() == exportJSON(deep).ensure());
+
+        //damaged data fails cleanly
+        for (Size i = 0; i < bytes.length(); ++i)
+            EXPECT(parseBinary(bytes.cString(), i).error() == ec::ParseFailed);
+        String trailing = bytes;
+        trailing.append('x');
+        EXPECT(parseBinary(trailing).error() == ec::ParseFailed);
+        EXPECT(parseBinary(String("SHRX")).error() == ec::ParseFailed);
+
+        //nested nodes that each claim as many children as the rest of the data could hold don't
+        //reserve memory for them
+        const Size nestedCount = 10000;
+        String nested("SHRB\x01\x01\x00", 7);
+        for (Size i = 0; i < nestedCount; ++i)
+        {
+            //a padded three byte varint keeps every node the same size
+            Size claimed = (nestedCount - 1 - i) * 6 / 4;
+            char node[6] = {0, 0, 0, static_cast<char>((claimed & 0x7F) | 0x80), static_cast<char>(((claimed >> 7) & 0x7F) | 0x80),
+                            static_cast<char>(claimed >> 14)};
+            nested.append(node, 6);
+        }
+        EXPECT(parseBinary(nested).error() == ec::ParseFailed);
+        MessageDecoder nestedDecoder;
+        EXPECT(nestedDecoder.decode(nested.cString() + 5, nested.length() - 5).error() == ec::ParseFailed);
+
+        char path[] = "/tmp/ScrubBinaryXXXXXX";
+        int fd = mkstemp(path);
+        EXPECT(fd >= 0);
+        close(fd);
+        EXPECT(!saveBinary(tree, path));
+        EXPECT(exportBinary(loadBinary(path).ensure()).ensure() == bytes);
+        unlink(path);
+    },
+
+    SUITE("Mapped Binary Tests")
+    {
+        Shrub tree = parseJSON("{\"name\" : \"mapped\", \"count\" : 42, \"ratio\" : 0.5, \"values\" : [1, 2, 3], \"nested\" : {\"deep\" : {\"flag\" : true}}}").ensure();
+        Shrub & dupes = tree.append(Shrub("dupes"));
+        dupes.append(Shrub("z", "first"));
+        dupes.append(Shrub("a", "1"));
+        dupes.append(Shrub("z", "second"));
+        dupes.append(Shrub("ab", "2"));
+        dupes.append(Shrub("raw", String("a\0b", 3), ValueHint::XMLAttribute));
+
+        String bytes = exportMappedBinary(tree).ensure();
+        MappedView root = parseMappedView(bytes).ensure();
+        EXPECT(root.isValid());
+        EXPECT(root.count() == tree.count());
+        EXPECT(root.get<String>("name") == "mapped");
+        EXPECT(root.get<Int32>("count") == 42);
+        EXPECT(root.get<Float64>("ratio") == 0.5);
+        EXPECT(root.get<bool>("nested.deep.flag"));
+        EXPECT(!root.maybe<Int32>("nested/deep/missing", '/'));
+        EXPECT(root.get<bool>("nested/deep/flag", '/'));
+        EXPECT(root.maybe<Int32>("missing", 7) == 7);
+        EXPECT(root.child("values").ensure().valueHint() == ValueHint::JSONArray);
+        EXPECT(*root.child("values").ensure()[1].value<Int32>() == 2);
+        EXPECT(!root.child("values").ensure()[3].isValid());
+
+        //children keep their order, lookups find the first of equal names
+        MappedView dupesView = root.child("dupes").ensure();
+        EXPECT(dupesView.get<String>("z") == "first");
+        EXPECT(dupesView.get<String>("ab") == "2");
+        EXPECT(!dupesView.child("b"));
+        const char * names[] = {"z", "a", "z", "ab", "raw"};
+        Size i = 0;
+        for (MappedView child : dupesView)
+            EXPECT(std::strcmp(child.name(), names[i++]) == 0);
+        EXPECT(i == 5);
+        EXPECT(dupesView.child("raw").ensure().valueString().count() == 3);
+        EXPECT(dupesView.child("raw").ensure().valueHint() == ValueHint::XMLAttribute);
+
+        //the root keeps the data alive
+        MappedView deep = root.child("nested.deep").ensure();
+        root = MappedView();
+        EXPECT(deep.get<bool>("flag"));
+
+        String streamed;
+        StringSink sink(streamed);
+        EXPECT(!exportMappedBinary(tree, sink));
+        EXPECT(streamed == bytes);
+
+        //truncated or foreign data is rejected, damaged offsets only hide nodes
+        for (Size i = 0; i < bytes.length(); i += 7)
+            EXPECT(parseMappedView(String(bytes.cString(), i)).error() == ec::ParseFailed);
+        EXPECT(parseMappedView(exportBinary(tree).ensure()).error() == ec::ParseFailed);
+        String damaged = bytes;
+        for (Size i = sizeof(UInt64) * 4; i < damaged.length(); i += 3)
+            damaged[i] = static_cast<char>(0xFF);
+        MappedView damagedRoot = parseMappedView(damaged).ensure();
+        for (MappedView child : damagedRoot)
+            child.child("deep.flag");
+        damagedRoot.child("nested.deep.flag");
+
+        char path[] = "/tmp/ScrubMappedXXXXXX";
+        int fd = mkstemp(path);
+        EXPECT(fd >= 0);
+        close(fd);
+        EXPECT(!saveMappedBinary(tree, path));
+        MappedView mapped = loadMappedView(path).ensure();
+        EXPECT(mapped.get<String>("dupes.ab") == "2");
+        unlink(path);
+        EXPECT(mapped.get<Int32>("count") == 42);
+        EXPECT(loadMappedView(path).error() == ec::InvalidOperation);
+    },
+
+    SUITE("MsgPack Tests")
+    {
+        Shrub tree = parseJSON("{\"name\" : \"msgpack\", \"small\" : 5, \"negative\" : -200, \"ratio\" : 0.1, "
+                               "\"values\" : [true, false, null, \"text\"], \"empty\" : {}, \"none\" : []}").ensure();
+
+        String bytes = exportMsgPack(tree).ensure();
+        Shrub loaded = parseMsgPack(bytes).ensure();
+        EXPECT(exportMsgPack(loaded).ensure() == bytes);
+        EXPECT(loaded.get<String>("name") == "msgpack");
+        EXPECT(loaded.get<Int32>("negative") == -200);
+        EXPECT(loaded.child("negative").ensure().valueHint() == ValueHint::JSONInt);
+        EXPECT(loaded.child("ratio").ensure().valueHint() == ValueHint::JSONDouble);
+        EXPECT(loaded.get<Float64>("ratio") == 0.1);
+        EXPECT(loaded.child("empty").ensure().valueHint() == ValueHint::JSONObject);
+        EXPECT(loaded.child("none").ensure().valueHint() == ValueHint::JSONArray);
+
+        String streamed;
+        StringSink sink(streamed);
+        EXPECT(!exportMsgPack(tree, sink));
+        EXPECT(streamed == bytes);
+
+        //the smallest encodings
+        Shrub small;
+        small.append(Shrub("a", "1", ValueHint::JSONInt));
+        small.append(Shrub("b", "-1", ValueHint::JSONInt));
+        small.append(Shrub("c", "true", ValueHint::JSONBool));
+        small.append(Shrub("d", "", ValueHint::None));
+        small.append(Shrub("e", "x", ValueHint::XMLAttribute));
+        small.append(Shrub("f", "18446744073709551615", ValueHint::JSONInt));
+        EXPECT(exportMsgPack(small).ensure() == String("\x86\xA1" "a\x01\xA1" "b\xFF\xA1" "c\xC3\xA1" "d\xC0\xA1" "e\xA1x"
+                                                       "\xA1" "f\xCF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 28));
+        EXPECT(parseMsgPack(exportMsgPack(small).ensure()).ensure().get<String>("f") == "18446744073709551615");
+
+        //types without a JSON equivalent and non string keys
+        const char other[] = "\x83\x01\xCA\x3F\xC0\x00\x00\xC4\x02\x00\x01\xD4\x05\x07\xD1\xFF\x38\xC0";
+        Shrub parsed = parseMsgPack(other, sizeof(other) - 1).ensure();
+        EXPECT(parsed.count() == 3);
+        EXPECT(parsed.get<Float64>("1") == 1.5);
+        Shrub & bin = parsed.begin()[1];
+        EXPECT(bin.name() == String("\0\x01", 2));
+        EXPECT(bin.valueString() == "\x07");
+        EXPECT(bin.valueHint() == ValueHint::None);
+        EXPECT(parsed.child("1").ensure().valueHint() == ValueHint::JSONDouble);
+        Shrub blob;
+        blob.append(Shrub("blob", String("\0\xFF", 2), ValueHint::Binary));
+        EXPECT(exportMsgPack(blob).ensure() == String("\x81\xA4" "blob\xC4\x02\0\xFF", 10));
+        EXPECT(parseMsgPack(exportMsgPack(blob).ensure()).ensure().child("blob").ensure().valueHint() == ValueHint::Binary);
+        EXPECT(parsed.child("-200").ensure().valueString() == "");
+        //containers under non string keys don't keep the key as their value
+        Shrub keyed = parseMsgPack(String("\x81\x01\x91\x02")).ensure();
+        EXPECT(keyed.child("1").ensure().valueString() == "");
+        EXPECT(keyed.child("1").ensure().valueHint() == ValueHint::JSONArray);
+        EXPECT(exportJSON(keyed).ensure() == "{\"1\" : [2]}");
+
+        //deep trees don't recurse
+        Shrub deep;
+        Shrub * current = &deep;
+        for (Size i = 0; i < 1000; ++i)
+            current = &current->append(Shrub("level", ValueHint::JSONArray));
+        EXPECT(exportJSON(parseMsgPack(exportMsgPack(deep).ensure()).ensure()).ensure() == exportJSON(deep).ensure());
+
+        //damaged data fails cleanly
+        for (Size i = 0; i < bytes.length(); ++i)
+            EXPECT(parseMsgPack(bytes.cString(), i).error() == ec::ParseFailed);
+        EXPECT(parseMsgPack(String("\xC1")).error() == ec::ParseFailed);
+        EXPECT(parseMsgPack(String("\x81\x90\x01")).error() == ec::ParseFailed);
+        EXPECT(parseMsgPack(String("\xDD\xFF\xFF\xFF\xFF")).error() == ec::ParseFailed);
+
+        //nested array32 headers that each claim the rest of the data don't reserve memory for it
+        const Size nestedCount = 4000;
+        String nested;
+        for (Size i = 0; i < nestedCount; ++i)
+        {
+            UInt32 claimed = static_cast<UInt32>((nestedCount - 1 - i) * 5);
+            char header[5] = {static_cast<char>(0xDD), static_cast<char>(claimed >> 24), static_cast<char>(claimed >> 16),
+                              static_cast<char>(claimed >> 8), static_cast<char>(claimed)};
+            nested.append(header, 5);
+        }
+        EXPECT(parseMsgPack(nested).error() == ec::ParseFailed);
+    },
+
+    SUITE("CBOR Tests")
+    {
+        Shrub tree = parseJSON("{\"name\" : \"cbor\", \"small\" : 5, \"negative\" : -1000, \"ratio\" : 0.1, \"half\" : 1.5, "
+                               "\"values\" : [true, false, null, \"text\"], \"empty\" : {}, \"none\" : []}").ensure();
+        tree.append(Shrub("blob", String("\0\xFF", 2), ValueHint::Binary));
+
+        String bytes = exportCBOR(tree).ensure();
+        Shrub loaded = parseCBOR(bytes).ensure();
+        EXPECT(exportCBOR(loaded).ensure() == bytes);
+        EXPECT(loaded.get<Int32>("negative") == -1000);
+        EXPECT(loaded.get<Float64>("ratio") == 0.1);
+        EXPECT(loaded.get<String>("half") == "1.5");
+        EXPECT(loaded.child("values").ensure().count() == 4);
+        EXPECT(loaded.child("blob").ensure().valueHint() == ValueHint::Binary);
+        EXPECT(loaded.child("empty").ensure().valueHint() == ValueHint::JSONObject);
+
+        String streamed;
+        StringSink sink(streamed);
+        EXPECT(!exportCBOR(tree, sink));
+        EXPECT(streamed == bytes);
+
+        //examples from RFC 8949
+        Shrub small("", ValueHint::JSONArray);
+        small.append(Shrub("", "0", ValueHint::JSONInt));
+        small.append(Shrub("", "24", ValueHint::JSONInt));
+        small.append(Shrub("", "1000000", ValueHint::JSONInt));
+        small.append(Shrub("", "-1000", ValueHint::JSONInt));
+        small.append(Shrub("", "1.5", ValueHint::JSONDouble));
+        EXPECT(exportCBOR(small).ensure() == String("\x85\x00\x18\x18\x1A\x00\x0F\x42\x40\x39\x03\xE7\xFA\x3F\xC0\x00\x00", 17));
+
+        //indefinite lengths
+        Shrub nested = parseCBOR(String("\x9F\x01\x82\x02\x03\x9F\x04\x05\xFF\xFF", 10)).ensure();
+        EXPECT(exportJSON(nested).ensure() == "[1,[2,3],[4,5]]");
+        Shrub map = parseCBOR(String("\xBF\x61" "a\x01\x61" "b\x9F\x02\x03\xFF\xFF", 11)).ensure();
+        EXPECT(exportJSONCanonical(map).ensure() == "{\"a\":1,\"b\":[2,3]}");
+        Shrub chunked = parseCBOR(String("\xA1\x01\x7F\x65strea\x64ming\xFF", 15)).ensure();
+        EXPECT(chunked.get<String>("1") == "streaming");
+        EXPECT(parseCBOR(String("\xF9\x7C\x00", 3)).ensure().valueString() == "inf");
+
+        //typed arrays, little endian Float32 and big endian Int16
+        Shrub floats = parseCBOR(String("\xD8\x55\x48\x00\x00\xC0\x3F\x00\x00\x20\xC0", 11)).ensure();
+        EXPECT(exportJSON(floats).ensure() == "[1.5,-2.5]");
+        Shrub ints = parseCBOR(String("\xD8\x49\x44\xFF\xFE\x01\x00", 7)).ensure();
+        EXPECT(exportJSON(ints).ensure() == "[-2,256]");
+        //little endian float16 (84), 128 bit floats (83 and 87) are rejected
+        Shrub halves = parseCBOR(String("\xD8\x54\x44\x00\x3E\x00\xC1", 7)).ensure();
+        EXPECT(exportJSON(halves).ensure() == "[1.5,-2.5]");
+        String quad("\xD8\x53\x50\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 19);
+        EXPECT(parseCBOR(quad).error() == ec::ParseFailed);
+        quad[1] = '\x57';
+        EXPECT(parseCBOR(quad).error() == ec::ParseFailed);
+
+        //strings are read in place
+        struct Collector : public CBORHandler
+        {
+            void beginMap() override { events.append("{"); }
+            void beginArray() override { events.append("["); }
+            void endContainer() override { events.append("]"); }
+            void key(StringSpan _key) override { events.append(AppendVariadicFlag(), String(_key.ptr(), _key.count()), ":"); }
+            void value(StringSpan _value, ValueHint _hint) override
+            {
+                events.append(AppendVariadicFlag(), String(_value.ptr(), _value.count()), ",");
+                if (_hint == ValueHint::JSONString)
+                    strings.append(_value);
+            }
+
+            String events;
+            DynamicArray<StringSpan> strings;
+        };
+        Collector collector;
+        EXPECT(!readCBOR(bytes.cString(), bytes.length(), collector));
+        EXPECT(collector.strings.count() == 2);
+        for (StringSpan str : collector.strings)
+            EXPECT(str.ptr() > bytes.cString() && str.ptr() < bytes.cString() + bytes.length());
+        Collector nestedCollector;
+        EXPECT(!readCBOR("\x9F\x01\x82\x02\x03\xFF", 6, nestedCollector));
+        EXPECT(nestedCollector.events == "[1,[2,3,]]");
+
+        //deep trees don't recurse
+        Shrub deep;
+        Shrub * current = &deep;
+        for (Size i = 0; i < 1000; ++i)
+            current = &current->append(Shrub("level", ValueHint::JSONObject));
+        EXPECT(exportJSON(parseCBOR(exportCBOR(deep).ensure()).ensure()).ensure() == exportJSON(deep).ensure());
+
+        //damaged data fails cleanly
+        for (Size i = 0; i < bytes.length(); ++i)
+            EXPECT(parseCBOR(bytes.cString(), i).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\xFF")).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\x1C")).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\xA1\x80\x01", 3)).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\x9B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 9)).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\x7F\x41" "a\xFF", 4)).error() == ec::ParseFailed);
+        EXPECT(parseCBOR(String("\xD8\x55\x43\x00\x00\x00", 6)).error() == ec::ParseFailed);
+    },
+
+    SUITE("Message Codec Tests")
+    {
+        auto message = [](Size _i)
+        {
+            Shrub ret = parseJSON("{\"id\" : 0, \"topic\" : \"prices\", \"quote\" : {\"bid\" : 1.5, \"ask\" : 1.75, \"tags\" : [\"a\", \"b\"]}}").ensure();
+            ret.set("id", static_cast<Int64>(_i));
+            return ret;
+        };
+
+        //a stream round trips and only the first message carries the keys
+        MessageEncoder encoder;
+        MessageDecoder decoder;
+        String first, stream;
+        for (Size i = 0; i < 10; ++i)
+        {
+            Shrub msg = message(i);
+            String bytes = encoder.encode(msg).ensure();
+            if (i == 0)
+                first = bytes;
+            else
+                EXPECT(bytes.length() < first.length());
+            EXPECT(exportJSON(decoder.decode(bytes).ensure()).ensure() == exportJSON(msg).ensure());
+            encoder.encode(msg, stream);
+        }
+        EXPECT(encoder.dictionary().count() == 7);
+        EXPECT(*encoder.dictionary().find("bid") == 4);
+        EXPECT(!encoder.dictionary().find("missing"));
+
+        //a new key in the middle of the stream
+        Shrub extended = message(10);
+        extended.append(Shrub("extra", "x", ValueHint::JSONString));
+        String extendedBytes = encoder.encode(extended).ensure();
+        EXPECT(exportJSON(decoder.decode(extendedBytes).ensure()).ensure() == exportJSON(extended).ensure());
+        EXPECT(encoder.dictionary().count() == 8);
+
+        //a trained dictionary, loaded on both ends, leaves no keys to send
+        Shrub samples[] = {message(0), message(1), extended};
+        KeyDictionary trained = trainKeyDictionary(samples, 3);
+        EXPECT(trained.count() == 8);
+        EXPECT(trained.key(trained.count() - 1) == "extra");
+        KeyDictionary loaded = parseKeyDictionary(exportKeyDictionary(trained).ensure()).ensure();
+        EXPECT(loaded.count() == trained.count());
+        EXPECT(*loaded.find("extra") == trained.count() - 1);
+        MessageEncoder trainedEncoder(trained);
+        MessageDecoder trainedDecoder(loaded);
+        String trainedBytes = trainedEncoder.encode(message(3)).ensure();
+        EXPECT(trainedBytes[0] == 0);
+        EXPECT(exportJSON(trainedDecoder.decode(trainedBytes).ensure()).ensure() == exportJSON(message(3)).ensure());
+        EXPECT(trainKeyDictionary(samples, 3, 2).count() == 2);
+
+        //a message that fails to decode leaves the stream intact
+        MessageEncoder rollbackEncoder;
+        MessageDecoder rollbackDecoder;
+        String rollbackBytes = rollbackEncoder.encode(message(0)).ensure();
+        for (Size i = 0; i < rollbackBytes.length(); ++i)
+            EXPECT(rollbackDecoder.decode(rollbackBytes.cString(), i).error() == ec::ParseFailed);
+        String trailing = rollbackBytes;
+        trailing.append('x');
+        EXPECT(rollbackDecoder.decode(trailing).error() == ec::ParseFailed);
+        EXPECT(exportJSON(rollbackDecoder.decode(rollbackBytes).ensure()).ensure() == exportJSON(message(0)).ensure());
+
+        //out of order messages refer to keys the decoder doesn't have
+        MessageDecoder late;
+        EXPECT(late.decode(encoder.encode(message(11)).ensure()).error() == ec::ParseFailed);
+
+        EXPECT(parseKeyDictionary(String("SHRK\x02\x01" "a\x01" "a", 8)).error() == ec::ParseFailed);
+        EXPECT(parseKeyDictionary(String("SHRX")).error() == ec::ParseFailed);
+    },
+
+    SUITE("Typed Array Tests")
+    {
+        //packed from a pointer, written like the children they replace
+        Float32 positions[] = {0.5f, -1.25f, 0.1f, 3.0f};
+        Shrub tree;
+        Shrub & mesh = tree.append(Shrub("mesh", ValueHint::JSONObject));
+        mesh.append(Shrub("positions")).setTypedArray(positions, 4);
+        Int64 big[] = {-9223372036854775807LL - 1, 0, 9223372036854775807LL};
+        mesh.append(Shrub("big")).setTypedArray(big, 3);
+        const Shrub & packed = mesh.child("positions").ensure();
+        EXPECT(packed.arrayType() == ArrayType::Float32);
+        EXPECT(packed.valueHint() == ValueHint::JSONArray);
+        EXPECT(packed.count() == 4);
+        EXPECT(packed.typedArray<Float32>().count() == 4);
+        EXPECT(packed.typedArray<Float32>()[1] == -1.25f);
+        EXPECT(packed.typedArray<Float64>().count() == 0);
+
+        String json = exportJSON(tree).ensure();
+        String prettyJSON = exportJSON(tree, true).ensure();
+        String xml = exportXML(tree).ensure();
+        String prettyXML = exportXML(tree, true).ensure();
+        String canonical = exportJSONCanonical(tree).ensure();
+        EXPECT(exportJSON(mesh.child("big").ensure()).ensure() == "[-9223372036854775808,0,9223372036854775807]");
+        EXPECT(measureJSON(tree) == json.length());
+        EXPECT(packed.arrayType() == ArrayType::Float32);
+
+        //unpacking produces the same output
+        Shrub unpacked = tree;
+        EXPECT(unpacked.child("mesh.positions").ensure().arrayType() == ArrayType::Float32);
+        Size count = 0;
+        for (const Shrub & child : unpacked.child("mesh.positions").ensure())
+        {
+            EXPECT(child.valueHint() == ValueHint::JSONDouble);
+            ++count;
+        }
+        EXPECT(count == 4);
+        EXPECT(unpacked.child("mesh.positions").ensure().arrayType() == ArrayType::None);
+        EXPECT(unpacked.child("mesh.big").ensure().count() == 3);
+        EXPECT(exportJSON(unpacked).ensure() == json);
+        EXPECT(exportJSON(unpacked, true).ensure() == prettyJSON);
+        EXPECT(exportXML(unpacked).ensure() == xml);
+        EXPECT(exportXML(unpacked, true).ensure() == prettyXML);
+        EXPECT(exportJSONCanonical(unpacked).ensure() == canonical);
+        EXPECT(json == "{\"mesh\" : {\"positions\" : [0.5,-1.25,0.1,3],\"big\" : [-9223372036854775808,0,9223372036854775807]}}");
+
+        //CBOR keeps them packed, the other binary formats write the children they unpack into
+        Shrub cbor = parseCBOR(exportCBOR(tree).ensure()).ensure();
+        EXPECT(cbor.child("mesh.positions").ensure().arrayType() == ArrayType::Float32);
+        EXPECT(cbor.child("mesh.big").ensure().typedArray<Int64>()[0] == big[0]);
+        EXPECT(exportJSON(cbor).ensure() == json);
+        const Shrub & constTree = tree;
+        EXPECT(exportBinary(constTree).ensure() == exportBinary(unpacked).ensure());
+        EXPECT(exportMappedBinary(constTree).ensure() == exportMappedBinary(unpacked).ensure());
+        EXPECT(exportJSON(parseBinary(exportBinary(constTree).ensure()).ensure()).ensure() == json);
+        EXPECT(exportJSON(parseMsgPack(exportMsgPack(constTree).ensure()).ensure()).ensure() == json);
+        MappedView mapped = parseMappedView(exportMappedBinary(constTree).ensure()).ensure();
+        EXPECT(mapped.child("mesh.big").ensure().count() == 3);
+        EXPECT(std::strcmp(mapped.child("mesh.big").ensure()[2].valueCString(), "9223372036854775807") == 0);
+        MessageEncoder encoder;
+        MessageDecoder decoder;
+        EXPECT(exportJSON(decoder.decode(encoder.encode(constTree).ensure()).ensure()).ensure() == json);
+        //exporting never unpacks
+        EXPECT(tree.child("mesh.positions").ensure().arrayType() == ArrayType::Float32);
+        EXPECT(tree.child("mesh.big").ensure().arrayType() == ArrayType::Int64);
+
+        //changing the children unpacks them, the elements can be changed in place
+        Shrub appended = tree;
+        Shrub & positionsCopy = appended.child("mesh.positions").ensure();
+        positionsCopy.typedArray<Float32>()[0] = 2.0f;
+        EXPECT(positions[0] == 0.5f);
+        positionsCopy.append(Shrub("", "7", ValueHint::JSONInt));
+        EXPECT(positionsCopy.arrayType() == ArrayType::None);
+        EXPECT(exportJSON(positionsCopy).ensure() == "[2,-1.25,0.1,3,7]");
+        Int32 none[] = {1};
+        positionsCopy.setTypedArray(none, 0);
+        EXPECT(positionsCopy.arrayType() == ArrayType::None);
+        EXPECT(exportJSON(positionsCopy).ensure() == "[]");
+
+        //parsing packs arrays that only contain numbers if asked to
+        String source = "{\"ints\" : [1, -2, 3], \"doubles\" : [0.5, 1, -2.25], \"mixed\" : [1, \"a\"], \"nested\" : [[1, 2], [3.5]], \"empty\" : []}";
+        JSONParseOptions options;
+        options.bPackNumberArrays = true;
+        Shrub parsed = parseJSON(source, options).ensure();
+        EXPECT(parsed.child("ints").ensure().arrayType() == ArrayType::Int32);
+        EXPECT(parsed.child("ints").ensure().typedArray<Int32>()[1] == -2);
+        EXPECT(parsed.child("doubles").ensure().arrayType() == ArrayType::Float64);
+        EXPECT(parsed.child("doubles").ensure().typedArray<Float64>()[2] == -2.25);
+        EXPECT(parsed.child("mixed").ensure().arrayType() == ArrayType::None);
+        EXPECT(parsed.child("nested").ensure().arrayType() == ArrayType::None);
+        EXPECT(parsed.child("empty").ensure().arrayType() == ArrayType::None);
+        EXPECT(exportJSON(parsed).ensure() == "{\"ints\" : [1,-2,3],\"empty\" : [],\"mixed\" : [1,\"a\"],\"nested\" : [[1,2],[3.5]],\"doubles\" : [0.5,1,-2.25]}");
+        EXPECT(parseJSON(source).ensure().child("ints").ensure().arrayType() == ArrayType::None);
+        //doubles come back as they were written
+        String decimals = "[53.063,-19.9269,0.1,1234.5678,0.0731]";
+        EXPECT(exportJSON(parseJSON(String::concat("{\"a\" : ", decimals, "}"), options).ensure().child("a").ensure()).ensure() == decimals);
+        //and distinct doubles stay distinct
+        Shrub close = parseJSON("{\"a\" : [0.30000000000000004, 0.3, 1e-320, 123456789012345678]}", options).ensure();
+        Span<Float64> closeValues = close.child("a").ensure().typedArray<Float64>();
+        EXPECT(closeValues[0] == 0.30000000000000004 && closeValues[1] == 0.3 && closeValues[2] == 1e-320 && closeValues[3] == 123456789012345678.0);
+        EXPECT(exportJSON(close.child("a").ensure()).ensure() == "[0.30000000000000004,0.3,9.99988867182683e-321,1.2345678901234568e+17]");
+    },
+
+    SUITE("Blob Tests")
+    {
+        //examples from RFC 4648
+        EXPECT(encodeBase64("", 0).ensure() == "");
+        EXPECT(encodeBase64("f", 1).ensure() == "Zg==");
+        EXPECT(encodeBase64("fo", 2).ensure() == "Zm8=");
+        EXPECT(encodeBase64("foobar", 6).ensure() == "Zm9vYmFy");
+        EXPECT(decodeBase64("Zm9vYg==", 8).ensure() == "foob");
+        EXPECT(decodeBase64("Zm9vYg", 6).ensure() == "foob");
+        EXPECT(decodeBase64("Zm9v\n YmE=", 10).ensure() == "fooba");
+
+        //every length and byte, long enough for the vectorized loops and their tails
+        String bytes;
+        for (Size i = 0; i < 300; ++i)
+            bytes.append(static_cast<char>(i * 7 + 3));
+        String encoded = encodeBase64(bytes.cString(), bytes.length()).ensure();
+        for (Size i = 0; i <= bytes.length(); ++i)
+        {
+            String text = encodeBase64(bytes.cString(), i).ensure();
+            EXPECT(text.length() == base64EncodedLength(i));
+            EXPECT(std::memcmp(text.cString(), encoded.cString(), i / 3 * 4) == 0);
+            String decoded = decodeBase64(text.cString(), text.length()).ensure();
+            EXPECT(decoded.length() == i && std::memcmp(decoded.cString(), bytes.cString(), i) == 0);
+        }
+
+        //a character outside the alphabet fails wherever it is
+        for (Size i = 0; i < 64; ++i)
+        {
+            String text(encoded.cString(), 64);
+            text[i] = '*';
+            EXPECT(decodeBase64(text.cString(), text.length()).error() == ec::ParseFailed);
+        }
+        EXPECT(decodeBase64("Zm9vY", 5).error() == ec::ParseFailed);
+        EXPECT(decodeBase64("Zm=v", 4).error() == ec::ParseFailed);
+        EXPECT(decodeBase64("Zm8==", 5).error() == ec::ParseFailed);
+
+        Shrub tree("", ValueHint::JSONObject);
+        tree.append(Shrub("payload"));
+        Shrub & payload = tree.child("payload").ensure();
+        payload.setBlob(bytes.cString(), 5);
+        EXPECT(payload.valueHint() == ValueHint::Binary);
+        EXPECT(payload.blob().count() == 5 && payload.blob()[1] == static_cast<UInt8>(10));
+        EXPECT(tree.child("payload").ensure().blob().count() == 5);
+        EXPECT(Shrub("text", "abc").blob().count() == 0);
+
+        //the text formats write base64 that decodes back into the bytes
+        payload.setBlob(bytes.cString(), bytes.length());
+        String json = exportJSON(tree).ensure();
+        EXPECT(json == String::concat("{\"payload\" : \"", encoded, "\"}"));
+        EXPECT(exportJSON(tree, true).ensure() == String::concat("{\n    \"payload\" : \"", encoded, "\"\n}\n"));
+        Shrub parsed = parseJSON(json).ensure();
+        Shrub & parsedPayload = parsed.child("payload").ensure();
+        EXPECT(parsedPayload.valueHint() == ValueHint::JSONString);
+        EXPECT(!parsedPayload.decodeBlob());
+        EXPECT(parsedPayload.valueString() == bytes);
+        EXPECT(parsedPayload.blob().count() == bytes.length());
+        EXPECT(exportJSON(parsed).ensure() == json);
+        EXPECT(exportJSONCanonical(tree).ensure() == String::concat("{\"payload\":\"", encoded, "\"}"));
+
+        String xml = exportXML(tree).ensure();
+        Shrub parsedXML = parseXML(xml).ensure();
+        Shrub & xmlPayload = parsedXML.child("payload").ensure();
+        EXPECT(xmlPayload.valueString() == encoded);
+        EXPECT(!xmlPayload.decodeBlob());
+        EXPECT(xmlPayload.valueString() == bytes);
+
+        //the binary formats keep the raw bytes
+        EXPECT(parseCBOR(exportCBOR(tree).ensure()).ensure().child("payload").ensure().blob().count() == bytes.length());
+
+        Shrub invalid("blob", "not base64!");
+        EXPECT(invalid.decodeBlob() == ec::ParseFailed);
+        EXPECT(invalid.valueString() == "not base64!");
+    },
+
+    SUITE("Column Table Tests")
+    {
+        Shrub tree = parseJSON("{\"items\" : ["
+                               "{\"price\" : 1.5, \"qty\" : 2, \"name\" : \"a\", \"ok\" : true},"
+                               "{\"price\" : 3, \"qty\" : null, \"name\" : \"bc\", \"ok\" : false},"
+                               "{\"qty\" : 7, \"price\" : 0.25, \"extra\" : {\"x\" : 1}, \"tag\" : \"new\"},"
+                               "5,"
+                               "{\"price\" : -1, \"qty\" : 1, \"name\" : \"d\", \"ok\" : true, \"qty\" : 9}]}").ensure();
+        ColumnTable table = extractColumns(tree.child("items").ensure()).ensure();
+        EXPECT(table.rowCount() == 5);
+        EXPECT(table.columnCount() == 6);
+        EXPECT(!table.findColumn("missing"));
+
+        //the integer rows of a column with doubles are converted
+        const Column & price = *table.findColumn("price");
+        EXPECT(price.type() == ColumnType::Float64);
+        EXPECT(price.count() == 5 && price.nullCount() == 1);
+        Span<const Float64> prices = price.float64Values();
+        EXPECT(prices.count() == 5);
+        EXPECT(prices[0] == 1.5 && prices[1] == 3.0 && prices[2] == 0.25 && prices[4] == -1.0);
+        EXPECT(price.isNull(3) && !price.isNull(4));
+        EXPECT(price.validity()[0] == 0x17);
+
+        //keys out of order, nulls and the first of duplicates
+        const Column & qty = *table.findColumn("qty");
+        EXPECT(qty.type() == ColumnType::Int64);
+        EXPECT(qty.nullCount() == 2);
+        EXPECT(qty.int64Values()[0] == 2 && qty.int64Values()[2] == 7 && qty.int64Values()[4] == 1);
+        EXPECT(qty.isNull(1) && qty.isNull(3));
+        EXPECT(qty.float64Values().count() == 0);
+
+        const Column & name = *table.findColumn("name");
+        EXPECT(name.type() == ColumnType::String);
+        EXPECT(name.stringValue(1) == "bc");
+        EXPECT(name.stringValue(2).count() == 0 && name.isNull(2));
+        EXPECT(name.offsets().count() == 6 && name.offsets()[5] == 4);
+        EXPECT(name.characters() == "abcd");
+
+        const Column & ok = *table.findColumn("ok");
+        EXPECT(ok.type() == ColumnType::Bool);
+        EXPECT(ok.boolValue(0) && !ok.boolValue(1) && ok.boolValue(4));
+        EXPECT(ok.boolBits()[0] == 0x11);
+
+        //containers are null, keys that show up late are null before
+        EXPECT(table.findColumn("extra")->type() == ColumnType::Null);
+        EXPECT(table.findColumn("extra")->nullCount() == 5);
+        const Column & tag = *table.findColumn("tag");
+        EXPECT(tag.isNull(0) && tag.isNull(1) && !tag.isNull(2) && tag.isNull(4));
+        EXPECT(tag.stringValue(2) == "new");
+
+        //mixed types become strings with the values as they are exported
+        Shrub mixed = parseJSON("{\"a\" : [{\"v\" : 1}, {\"v\" : null}, {\"v\" : 2.5}, {\"v\" : true}, {\"v\" : \"x\"}]}").ensure();
+        ColumnTable mixedTable = extractColumns(mixed.child("a").ensure()).ensure();
+        const Column & v = mixedTable.column(0);
+        EXPECT(v.type() == ColumnType::String);
+        EXPECT(v.characters() == "12.5truex");
+        EXPECT(v.isNull(1) && v.stringValue(1).count() == 0);
+        EXPECT(v.stringValue(3) == "true");
+
+        Shrub blobs("", ValueHint::JSONArray);
+        blobs.append(Shrub("", ValueHint::JSONObject)).append(Shrub("data", "text", ValueHint::JSONString));
+        blobs.append(Shrub("", ValueHint::JSONObject)).append(Shrub("data")).setBlob("\0\1", 2);
+        ColumnTable blobTable = extractColumns(blobs).ensure();
+        const Column & data = blobTable.column(0);
+        EXPECT(data.type() == ColumnType::Binary);
+        EXPECT(data.stringValue(1) == StringSpan("\0\1", 2));
+
+        EXPECT(extractColumns(Shrub("", ValueHint::JSONArray)).ensure().rowCount() == 0);
+        EXPECT(extractColumns(tree).error() == ec::InvalidArgument);
+
+        //packed arrays are rows without columns, and neither they nor packed elements get unpacked
+        const Int32 ints[3] = {1, 2, 3};
+        Shrub packed("", ValueHint::JSONArray);
+        packed.setTypedArray(ints, 3);
+        EXPECT(extractColumns(packed).ensure().rowCount() == 3);
+        EXPECT(packed.arrayType() == ArrayType::Int32);
+        Shrub nested("", ValueHint::JSONArray);
+        nested.append(Shrub("", ValueHint::JSONArray)).setTypedArray(ints, 3);
+        ColumnTable nestedTable = extractColumns(nested).ensure();
+        EXPECT(nestedTable.rowCount() == 1 && nestedTable.columnCount() == 0);
+        EXPECT((*nested.begin()).arrayType() == ArrayType::Int32);
+    },
+
+    SUITE("Arrow Tests")
+    {
+        Shrub tree = parseJSON("{\"rows\" : [{\"id\" : 1, \"score\" : 0.5, \"label\" : \"a\", \"ok\" : true},"
+                               "{\"id\" : 2, \"score\" : null, \"label\" : \"bcd\", \"ok\" : false},"
+                               "{\"id\" : 3, \"score\" : 2, \"ok\" : true, \"none\" : null}]}").ensure();
+        CountingAllocator alloc;
+        {
+            ArrowSchema schema;
+            ArrowArray array;
+            EXPECT(!exportArrow(tree.child("rows").ensure(), &schema, &array, alloc));
+            EXPECT(std::strcmp(schema.format, "+s") == 0);
+            EXPECT(schema.n_children == 5 && array.n_children == 5);
+            EXPECT(array.length == 3 && array.null_count == 0 && array.n_buffers == 1);
+
+            //the children in the order of the schema
+            auto child = [&](const char * _name) -> Size
+            {
+                for (Size i = 0; i < static_cast<Size>(schema.n_children); ++i)
+                {
+                    if (std::strcmp(schema.children[i]->name, _name) == 0)
+                        return i;
+                }
+                return 0;
+            };
+
+            ArrowArray * id = array.children[child("id")];
+            EXPECT(std::strcmp(schema.children[child("id")]->format, "l") == 0);
+            EXPECT(schema.children[child("id")]->flags == ARROW_FLAG_NULLABLE);
+            EXPECT(id->length == 3 && id->null_count == 0 && id->n_buffers == 2 && !id->buffers[0]);
+            EXPECT(static_cast<const Int64 *>(id->buffers[1])[2] == 3);
+
+            ArrowArray * score = array.children[child("score")];
+            EXPECT(std::strcmp(schema.children[child("score")]->format, "g") == 0);
+            EXPECT(score->null_count == 1);
+            EXPECT(static_cast<const UInt8 *>(score->buffers[0])[0] == 0x5);
+            EXPECT(static_cast<const Float64 *>(score->buffers[1])[2] == 2.0);
+
+            ArrowArray * label = array.children[child("label")];
+            EXPECT(std::strcmp(schema.children[child("label")]->format, "U") == 0);
+            EXPECT(label->n_buffers == 3 && label->null_count == 1);
+            const Int64 * offsets = static_cast<const Int64 *>(label->buffers[1]);
+            EXPECT(offsets[0] == 0 && offsets[1] == 1 && offsets[2] == 4 && offsets[3] == 4);
+            EXPECT(std::memcmp(static_cast<const char *>(label->buffers[2]) + offsets[1], "bcd", 3) == 0);
+
+            ArrowArray * ok = array.children[child("ok")];
+            EXPECT(std::strcmp(schema.children[child("ok")]->format, "b") == 0);
+            EXPECT(static_cast<const UInt8 *>(ok->buffers[1])[0] == 0x5);
+
+            ArrowArray * none = array.children[child("none")];
+            EXPECT(std::strcmp(schema.children[child("none")]->format, "n") == 0);
+            EXPECT(none->n_buffers == 0 && none->null_count == 3);
+
+            //a child moved out stays valid after its parents are released
+            ArrowArray moved = *id;
+            id->release = nullptr;
+            schema.release(&schema);
+            EXPECT(!schema.release);
+            array.release(&array);
+            EXPECT(!array.release);
+            EXPECT(alloc.bytesInUse > 0);
+            EXPECT(static_cast<const Int64 *>(moved.buffers[1])[1] == 2);
+            moved.release(&moved);
+            EXPECT(!moved.release);
+        }
+        EXPECT(alloc.bytesInUse == 0);
+
+        ArrowSchema schema;
+        ArrowArray array;
+        EXPECT(exportArrow(tree, &schema, &array) == ec::InvalidArgument);
+        EXPECT(!exportArrow(Shrub("", ValueHint::JSONArray), &schema, &array));
+        EXPECT(array.length == 0 && schema.n_children == 0);
+        array.release(&array);
+        schema.release(&schema);
     }
 };
 